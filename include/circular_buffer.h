@@ -7,54 +7,258 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 
 #include "commandStructure.h"
 
-// The definition of our circular buffer structure
-struct circular_buf_t {
-    commandStreamStructure_t *buffer;
-    size_t head;
-    size_t tail;
-    size_t max; // of the buffer
-};
-
-// Circular buffer structure
+// Opaque circular buffer structure
 typedef struct circular_buf_t circular_buf_t;
 
 // Handle type, the way users interact with the API
 typedef circular_buf_t *cbuf_handle_t;
 
-// Pass in a buffer size, returns a circular buffer handle
+typedef enum {
+    // Every call holds a mutex lock. Any number of threads can put and get.
+    CircularBufMode_Mutex = 1,
+    // Lock-free with the atomic head and tail. Only a single producer thread
+    // can put and a single consumer thread can get at the same time. When the
+    // buffer is full, the put drops the oldest data by moving the tail and
+    // overwrites its slots, which the get might be copying at that time. Like
+    // a seqlock, the get validates the copy by the exchange of tail and
+    // retries if the data was dropped, so the torn copy is never returned.
+    // The copy itself is a data race by the C memory model, which
+    // ThreadSanitizer reports in the overwrite.
+    CircularBufMode_Spsc = 2,
+    // Lock-free with the sequence number of each slot. Any number of threads
+    // can put and get, such as several servers feeding one command stream. The
+    // batch functions handle one element at a time, and the zero-copy
+    // functions are not supported.
+    CircularBufMode_Mpmc = 3,
+} CircularBufMode;
+
+// Statistics of the buffer
+typedef struct {
+    // Number of data deleted to make room or dropped because there was no room
+    uint64_t numOverwrite;
+    // Number of data retrieved with the latency recorded
+    uint64_t numLatency;
+    // Latency between the put (or receive time) and get in nanosecond. The
+    // percentiles are the upper bounds of the histogram bins, which are within
+    // 25% of the real values.
+    uint64_t latencyP50;
+    uint64_t latencyP99;
+    uint64_t latencyMax;
+} circular_buf_stats_t;
+
+// The memory of buffer is allocated by rtMemory_alloc() in the policy set by
+// rtMemory_setPolicy(), so set RtMemoryPolicy_Locked before the buffer is
+// created to avoid the page faults in the real-time loop.
+
+// Pass in a buffer size, returns a circular buffer handle in the mutex mode
 // Requires: buffer size > 0
 // Ensures: cbuf has been created and is returned in an empty state
 // Return NULL if the size < 1 or memory allocation fails
 cbuf_handle_t circular_buf_init(size_t size);
 
+// Pass in a buffer size and mode (enum: 'CircularBufMode'), returns a circular
+// buffer handle. The other functions keep the same behavior in all modes.
+// Requires: buffer size > 0
+// Ensures: cbuf has been created and is returned in an empty state
+// Return NULL if the size < 1, mode is unknown, or memory allocation fails
+cbuf_handle_t circular_buf_init_mode(size_t size, CircularBufMode mode);
+
+// Pass in a buffer size, element size in bytes, and mode (enum:
+// 'CircularBufMode'), returns a circular buffer handle of the generic element.
+// Use the *_element() functions to put and get the data, such as the telemetry
+// frame or command status (commandStatusStructure_t).
+// Requires: buffer size > 0 and element size > 0
+// Ensures: cbuf has been created and is returned in an empty state
+// Return NULL if the sizes < 1, mode is unknown, or memory allocation fails
+cbuf_handle_t circular_buf_init_element(size_t size, size_t sizeElement,
+                                        CircularBufMode mode);
+
+// Same as circular_buf_init_element() but in the aligned layout for the hot
+// path between two cores. The number of slots (capacity + 1, or the capacity
+// in the MPMC mode) is rounded up to a power of 2, so the slot index is a mask
+// instead of a modulo, and the storage is aligned to the cache line. The
+// capacity might be bigger than "size".
+// Requires: buffer size > 0 and element size > 0
+// Ensures: cbuf has been created and is returned in an empty state
+// Return NULL if the sizes < 1, mode is unknown, or memory allocation fails
+cbuf_handle_t circular_buf_init_aligned(size_t size, size_t sizeElement,
+                                        CircularBufMode mode);
+
+// Set the high-priority lane with the buffer size for the commands listed in
+// "pCmds" (such as the stop command). These commands are put to the lane, which
+// is drained first by the get and peek functions and can never be overwritten
+// by the other commands. Call this before the buffer is in use.
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+// Return 0 if success. Otherwise, -1.
+int circular_buf_set_priority_lane(cbuf_handle_t cbuf, size_t size,
+                                   const unsigned int *pCmds, size_t numCmd);
+
+// Enable the latency statistics. Each put stamps the data with the time of
+// CLOCK_MONOTONIC, and each get records the time since then in a lock-free
+// histogram. The overwrite count is always recorded. Call this before the
+// buffer is in use.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// Return 0 if success. Otherwise, -1.
+int circular_buf_enable_stats(cbuf_handle_t cbuf);
+
+// Is the latency statistics enabled or not. The caller can skip taking the
+// receive time for circular_buf_put_stamped() if it is not.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// Return true if it is enabled.
+bool circular_buf_is_stats_enabled(cbuf_handle_t cbuf);
+
+// Get the statistics of the buffer, including the high-priority lane. The
+// latency is zero if the statistics is not enabled.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// This is a thread-safe function
+void circular_buf_get_stats(cbuf_handle_t cbuf, circular_buf_stats_t *pStats);
+
 // Free a circular buffer structure
 // Requires: cbuf is valid and created by circular_buf_init()
 void circular_buf_free(cbuf_handle_t cbuf);
 
 // Add data to the buffer. Delete old data to make room, if necessary.
 // Return true if old data was deleted, else false.
-// Requires: cbuf is valid and created by circular_buf_init()
-// This is a thread-safe function
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+// This is a thread-safe function (single producer in the SPSC mode)
 bool circular_buf_put(cbuf_handle_t cbuf, commandStreamStructure_t data);
 
+// Same as circular_buf_put() but the data is stamped with "pTimeRecv" of
+// CLOCK_MONOTONIC, such as the time the command was received from the network,
+// so the latency covers the time before the put.
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+bool circular_buf_put_stamped(cbuf_handle_t cbuf, commandStreamStructure_t data,
+                              const struct timespec *pTimeRecv);
+
+// Add the element pointed to by "pData" to the buffer. The size of data should
+// be the same as the element size. Delete old data to make room, if necessary.
+// Return true if old data was deleted, else false.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// This is a thread-safe function (single producer in the SPSC mode)
+bool circular_buf_put_element(cbuf_handle_t cbuf, const void *pData);
+
 // Retrieve the data from the buffer.
 // Pop and return the oldest data from the buffer.
 // Return true if the buffer was empty (no data returned), false otherwise.
-// Requires: cbuf is valid and created by circular_buf_init()
-// This is a thread-safe function
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+// This is a thread-safe function (single consumer in the SPSC mode)
 bool circular_buf_get(cbuf_handle_t cbuf, commandStreamStructure_t *data);
 
+// Retrieve the oldest element from the buffer to the memory pointed to by
+// "pData", which should have the size of element at least.
+// Return true if the buffer was empty (no data returned), false otherwise.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// This is a thread-safe function (single consumer in the SPSC mode)
+bool circular_buf_get_element(cbuf_handle_t cbuf, void *pData);
+
+// Retrieve the oldest data from the buffer. If the buffer is empty, sleep
+// until the data arrives or the absolute deadline of CLOCK_MONOTONIC passes.
+// Put NULL to "pDeadline" to wait forever. The producer only makes the system
+// call to wake up when there is the waiting consumer.
+// Return true if the buffer was still empty at the deadline (no data
+// returned), false otherwise.
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+// This is a thread-safe function (single consumer in the SPSC mode)
+bool circular_buf_get_timed(cbuf_handle_t cbuf, commandStreamStructure_t *data,
+                            const struct timespec *pDeadline);
+
+// Same as circular_buf_get_timed() but for the generic element.
+// Requires: cbuf is valid and created by circular_buf_init*()
+bool circular_buf_get_timed_element(cbuf_handle_t cbuf, void *pData,
+                                    const struct timespec *pDeadline);
+
+// Add "num" commands in "pData" to the buffer with a single lock or atomic
+// update. Delete old data to make room, if necessary. If "num" is bigger than
+// the capacity, only the newest ones are kept.
+// Return the number of data deleted (old data and the skipped new data).
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+// This is a thread-safe function (single producer in the SPSC mode)
+size_t circular_buf_put_n(cbuf_handle_t cbuf,
+                          const commandStreamStructure_t *pData, size_t num);
+
+// Same as circular_buf_put_n() but for the generic element.
+// Requires: cbuf is valid and created by circular_buf_init*()
+size_t circular_buf_put_n_element(cbuf_handle_t cbuf, const void *pData,
+                                  size_t num);
+
+// Retrieve at most "num" oldest commands from the buffer to "pData" with a
+// single lock or atomic update.
+// Return the number of data retrieved. 0 means the buffer was empty.
+// Requires: cbuf is valid and created by circular_buf_init() or
+// circular_buf_init_mode()
+// This is a thread-safe function (single consumer in the SPSC mode)
+size_t circular_buf_get_n(cbuf_handle_t cbuf, commandStreamStructure_t *pData,
+                          size_t num);
+
+// Same as circular_buf_get_n() but for the generic element.
+// Requires: cbuf is valid and created by circular_buf_init*()
+size_t circular_buf_get_n_element(cbuf_handle_t cbuf, void *pData, size_t num);
+
+// Reserve the slot of the next element, so the producer can write the data in
+// place (such as recv() into it) without the copy. Call circular_buf_commit()
+// to add it to the buffer. Only one slot can be reserved at a time.
+// In the mutex mode, the lock is held until circular_buf_commit(), so keep the
+// reservation short. In the SPSC mode, there is no slot to reserve if the
+// buffer is full and the consumer holds a slot by circular_buf_peek().
+// Return the pointer to the slot, or NULL if there is no slot to reserve or
+// in the MPMC mode.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// This is a thread-safe function (single producer in the SPSC mode)
+void *circular_buf_reserve(cbuf_handle_t cbuf);
+
+// Add the reserved element to the buffer. Delete old data to make room, if
+// necessary. In the SPSC mode, the reserved element is deleted instead if the
+// consumer holds a slot by circular_buf_peek() at that time.
+// Return true if data was deleted, else false.
+// Requires: the slot is reserved by circular_buf_reserve()
+bool circular_buf_commit(cbuf_handle_t cbuf);
+
+// Peek the oldest element in the buffer, so the consumer can decode the data
+// in place without the copy. Call circular_buf_release() to remove it from the
+// buffer. Do not get or peek other data before the release.
+// In the mutex mode, the lock is held until circular_buf_release(), so keep it
+// short. In the SPSC mode, the producer drops the new data instead of the old
+// one if the buffer is full before the release.
+// Return the pointer to the oldest element, or NULL if the buffer is empty or
+// in the MPMC mode.
+// Requires: cbuf is valid and created by circular_buf_init*()
+// This is a thread-safe function (single consumer in the SPSC mode)
+void *circular_buf_peek(cbuf_handle_t cbuf);
+
+// Remove the element held by circular_buf_peek() from the buffer. The pointer
+// should not be used after this call.
+// Requires: the element is held by circular_buf_peek()
+void circular_buf_release(cbuf_handle_t cbuf);
+
+// Get the mode of the buffer
+// Requires: cbuf is valid and created by circular_buf_init()
+// Returns the mode (enum: 'CircularBufMode')
+CircularBufMode circular_buf_mode(cbuf_handle_t cbuf);
+
+// Get the size of element in bytes
+// Requires: cbuf is valid and created by circular_buf_init*()
+// Returns the size of element
+size_t circular_buf_element_size(cbuf_handle_t cbuf);
+
 // Get the capacity of the buffer
 // Requires: cbuf is valid and created by circular_buf_init()
-// Returns the maximum capacity of the buffer
+// Returns the maximum capacity of the buffer, including the high-priority lane
 size_t circular_buf_capacity(cbuf_handle_t cbuf);
 
 // Get the number of elements stored in the buffer
 // Requires: cbuf is valid and created by circular_buf_init()
-// Returns the current number of elements in the buffer
+// Returns the current number of elements in the buffer, including the
+// high-priority lane
 // This is a thread-safe function
 size_t circular_buf_size(cbuf_handle_t cbuf);
 
@@ -3,22 +3,223 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "logTlmCodec.h"
+#include "logTlmRetention.h"
+
+// Backend to write the telemetry file
+typedef enum {
+    // Buffered writing with fwrite(). The page cache decides when the data
+    // goes to the disk.
+    LogTlmBackend_Stream = 1,
+    // Block-aligned pwrite() with O_DIRECT, which bypasses the page cache so
+    // the writeback does not interfere with the real-time process. The page
+    // cache is used if the file system does not support O_DIRECT. The buffers
+    // are aligned to the block and written without the copy when the file
+    // offset is aligned as well, such as the raw format with the buffer size
+    // of multiple of 4096 bytes. Only the unaligned data is staged. With the
+    // flush thread, the writes are queued to a direct I/O thread, so the
+    // flush does not wait for the last write.
+    LogTlmBackend_Direct = 2,
+    // The file is preallocated to "recordPerFile" records and mapped, and
+    // logTlm_write() copies the record into the mapping directly without the
+    // buffers and flush thread. logTlm_flush() schedules the writeback of new
+    // records. The readers can map the file and tail it while it is written.
+    // The file is truncated to the written records when it is closed. The
+    // element size still comes from the creation of buffers. The next file is
+    // mapped ahead, so the rotation in logTlm_write() only swaps the mapping.
+    // The old file is closed and renamed, and the next one is prepared, by the
+    // housekeeping thread, or by logTlm_flush() without the thread. If the next
+    // file is not ready, the record is dropped as the buffers are full.
+    LogTlmBackend_Mmap = 3,
+} LogTlmBackend;
+
+// Durability policy of the telemetry file. The data is synchronized to the
+// disk in two steps: the flush starts the writeback of new data by
+// sync_file_range() without waiting, and fdatasync() waits for it in the
+// housekeeping thread. Without the housekeeping thread, fdatasync() is called
+// in the flush. Except LogTlmDurability_None, the file is synchronized when it
+// is closed or rotated as well.
+typedef enum {
+    // The page cache decides when the data goes to the disk.
+    LogTlmDurability_None = 1,
+    // Synchronize when "threshold" bytes are written since the last one.
+    LogTlmDurability_Bytes = 2,
+    // Synchronize when "threshold" ms passed since the last one. This is
+    // checked in each flush.
+    LogTlmDurability_Time = 3,
+    // Synchronize when the file is closed or rotated only.
+    LogTlmDurability_Rotation = 4,
+} LogTlmDurability;
+
+// Decimation of the records when the full-rate capture is not triggered
+typedef enum {
+    // Write all the records.
+    LogTlmDecimation_None = 1,
+    // Write one of "factor" records.
+    LogTlmDecimation_Sample = 2,
+    // Write the minimum, maximum, and mean of each window of "factor" records
+    // as 3 records in this order.
+    LogTlmDecimation_MinMaxMean = 3,
+} LogTlmDecimation;
+
+// Predicate to trigger the full-rate capture, such as the fault bit of
+// ds402_status_word. The "pData" is the data given to logTlm_write() and the
+// "pUser" is the pointer given to logTlmHandle_setTrigger(). This is called
+// in logTlm_write() and should be fast.
+// Return true to trigger.
+typedef bool (*logTlmTrigger_t)(void *pUser, const void *pData);
+
+// Format of the telemetry file
+typedef enum {
+    // Concatenation of the records without any header.
+    LogTlmFormat_Raw = 1,
+    // Versioned container. The file starts with logTlmFileHeader_t. Each
+    // flushed buffer is a block of logTlmBlockHeader_t followed by the
+    // records. The file ends with the index of blocks (logTlmIndexEntry_t)
+    // and logTlmFileFooter_t, so a reader can locate the time range with the
+    // binary search. The container is not supported by LogTlmBackend_Mmap.
+    LogTlmFormat_Container = 2,
+} LogTlmFormat;
+
+// Magic words and version of the container format
+#define LOGTLM_FILE_MAGIC "LSSTTLM"
+#define LOGTLM_INDEX_MAGIC "TLMINDX"
+#define LOGTLM_FILE_VERSION 4
+
+// Flags in the header of container file
+// Each record starts with logTlmRecordHeader_t. The times in the file and
+// block headers are TAI as well.
+#define LOGTLM_FLAG_RECORD_HEADER 0x1
+
+// Bit of the sequence number to mark the gap of dropped records
+#define LOGTLM_SEQUENCE_GAP (1ULL << 63)
+
+// Header of each record enabled by logTlmHandle_setRecordHeader(). The record
+// data follows it. If the records are dropped because all the buffers are
+// full (or the next file of mmap backend is not ready), a gap marker is
+// written before the next record. The gap marker has the sequence number of
+// the first dropped record with LOGTLM_SEQUENCE_GAP and its data is zero, so
+// the number of dropped records is the difference of the sequence numbers of
+// the next record and the gap marker.
+typedef struct {
+    // Sequence number of the record, which is increased by each writing,
+    // including the dropped records
+    uint64_t sequence;
+    // TAI time of the writing in nanoseconds since the epoch
+    int64_t timeNs;
+} logTlmRecordHeader_t;
+
+// Header at the beginning of the container file
+typedef struct {
+    // LOGTLM_FILE_MAGIC with the null terminator
+    char magic[8];
+    // LOGTLM_FILE_VERSION
+    uint32_t version;
+    // Size of each record in bytes, including the record header
+    uint32_t sizeElement;
+    // ID of the record layout defined by the user
+    uint32_t schemaId;
+    // Maximum number of records in a block
+    uint32_t recordPerBlock;
+    // Codec of the blocks in LogTlmCodec
+    uint32_t codec;
+    // Number of the fields in the columnar layout. If it is not 0, the header
+    // is followed by "numField" logTlmField_t. Otherwise, the row layout is
+    // used.
+    uint32_t numField;
+    // Flags of LOGTLM_FLAG_*
+    uint32_t flags;
+    uint32_t reserved;
+    // Creation time of the file in nanoseconds since the epoch
+    int64_t timeStartNs;
+} logTlmFileHeader_t;
+
+// Field of the record in the columnar layout
+typedef struct {
+    // Offset of the field in the record in bytes
+    uint32_t offset;
+    // Size of the field in bytes
+    uint32_t size;
+} logTlmField_t;
+
+// Header of each block, which is followed by "sizeData" bytes of the records.
+// In the row layout, if "sizeData" is less than the size of "numRecord"
+// records, the data is encoded by the codec in the file header. Otherwise, the
+// records are stored as they are. In the columnar layout, the data starts with
+// the size of each column (uint32_t) and is followed by the columns. The
+// column is encoded in the same way and has "numRecord" values of the field.
+typedef struct {
+    uint32_t numRecord;
+    uint32_t sizeData;
+    // Time range of the records written in nanoseconds since the epoch
+    int64_t timeMinNs;
+    int64_t timeMaxNs;
+} logTlmBlockHeader_t;
+
+// Entry of the index of blocks
+typedef struct {
+    // Offset of the block header in the file
+    int64_t offset;
+    int64_t timeMinNs;
+    int64_t timeMaxNs;
+    uint32_t numRecord;
+    uint32_t reserved;
+} logTlmIndexEntry_t;
+
+// Footer at the end of the container file. The index is at "offsetIndex" and
+// has "numBlock" entries.
+typedef struct {
+    // LOGTLM_INDEX_MAGIC with the null terminator
+    char magic[8];
+    uint64_t numBlock;
+    uint64_t offsetIndex;
+} logTlmFileFooter_t;
+
+// Statistics of the buffers
+typedef struct {
+    // Number of records dropped because all the buffers were full
+    long numRecordDropped;
+    // Number of full buffers waiting for the flush (in flight)
+    int numBufferFull;
+    // High-water mark of the full buffers
+    int numBufferFullMax;
+    // Number of fdatasync() calls by the durability policy
+    long numSync;
+    // Number of failed fdatasync() calls
+    long numSyncFailed;
+    // Total and maximum latency of fdatasync() in nanoseconds
+    int64_t timeSyncTotalNs;
+    int64_t timeSyncMaxNs;
+    // Number of the triggered full-rate captures
+    long numTrigger;
+    // Account of the rotated files by the retention
+    logTlmRetentionAccount_t accountRetention;
+} logTlmStats_t;
 
 // Get the filename.
 char *logTlm_getFilename(void);
 
-// Get the buffer with the specific id, which equals 1 or 2. Put 0 if you want
-// to get the current buffer in use.
+// Get the buffer with the specific id, which is from 1 to the number of
+// buffers. Put 0 if you want to get the current buffer in use.
 // Return the specific buffer. Otherwise, NULL if no specific buffer found.
 void *logTlm_getBuffer(int id);
 
 // Free the buffer and set to NULL.
 void logTlm_freeBuffer(void);
 
-// Create the buffers.
+// Create the two buffers (double buffering).
 // Return 0 if success. Otherwise, -1.
 int logTlm_createBuffer(int sizeBuffer, size_t sizeElement);
 
+// Create the pool of "num" buffers. When a buffer is full, the flush thread
+// writes it to the file and the writer moves to a free buffer, so more
+// buffers absorb the longer disk stalls without dropping the data. The buffers
+// are allocated by rtMemory_alloc() in the policy set by rtMemory_setPolicy().
+// Return 0 if success. Otherwise, -1.
+int logTlm_createBufferPool(int num, int sizeBuffer, size_t sizeElement);
+
 // Close the file. This function is safe to call even though there is no file.
 // Return 0 if success. Otherwise, fail.
 int logTlm_close(void);
@@ -47,13 +248,154 @@ int logTlm_flush(void);
 // Return true if yes. Otherwise, false.
 bool logTlm_isFlushing(void);
 
+// Get the statistics of the buffers. The counters are reset by
+// logTlm_createBuffer() and logTlm_createBufferPool() only.
+// Requires: the buffers are created
+void logTlm_getStats(logTlmStats_t *pStats);
+
 // Close the running thread. This is used in the shutdown process.
 void logTlm_closeThread(void);
 
-// Run the flush job in a new thread with the checking time in ms. If you put
-// the "isImmediate" to be false in the logTlm_flush(), the flush will happen in
-// this new thread.
+// Run the flush job in a new thread. The thread sleeps until logTlm_write()
+// fills a buffer and then flushes it immediately, so it takes no CPU time when
+// idle. The checking time in ms (> 0) is kept for the compatibility.
 // Return 0 if success, otherwise, return -1.
 int logTlm_runFlushInNewThread(int *pTimeInMs);
 
+// Handle of the telemetry logger. Each handle owns its buffers, file rotation,
+// and flush thread, so a process can log several telemetry streams, such as
+// the high-rate drive telemetry and low-rate housekeeping telemetry. The
+// logTlm_*() functions without the handle use the default logger.
+typedef struct logTlm_t *logTlm_handle_t;
+
+// Create the handle of a new telemetry logger.
+// Return the handle. Otherwise, NULL if failed.
+logTlm_handle_t logTlmHandle_init(void);
+
+// Close the thread and file, and free the buffers and handle of the logger.
+// Requires: pLog is created by logTlmHandle_init()
+void logTlmHandle_free(logTlm_handle_t pLog);
+
+// Get the handle of the default logger used by the logTlm_*() functions.
+logTlm_handle_t logTlm_getDefaultHandle(void);
+
+// Set the backend to write the file. The default is LogTlmBackend_Stream.
+// Return 0 if success. Otherwise, -1 if the backend is unknown, the file is
+// opened, or the format is LogTlmFormat_Container for the mmap backend.
+int logTlmHandle_setBackend(logTlm_handle_t pLog, LogTlmBackend backend);
+
+// Set the format of the file with the ID of record layout. The default is
+// LogTlmFormat_Raw.
+// Return 0 if success. Otherwise, -1 if the format is unknown, the file is
+// opened, or the backend is LogTlmBackend_Mmap for the container.
+int logTlmHandle_setFormat(logTlm_handle_t pLog, LogTlmFormat format,
+                           uint32_t schemaId);
+
+// Set the codec of the blocks in the container format. The default is
+// LogTlmCodec_None. The encoding is done in the flush and logTlm_write() is not
+// affected. A block is stored without the encoding if it does not become
+// smaller.
+// Return 0 if success. Otherwise, -1 if the codec is unknown, the file is
+// opened, or the format is not LogTlmFormat_Container.
+int logTlmHandle_setCodec(logTlm_handle_t pLog, LogTlmCodec codec);
+
+// Set the columnar layout of the blocks in the container format. Each block
+// stores the field of all the records together in the order of "pFields", so
+// a reader can read a field without touching the others. The bytes that are
+// not in any field, such as the padding, are not stored. The fields should
+// not overlap. Put "numField" to be 0 to use the row layout, which is the
+// default.
+// Return 0 if success. Otherwise, -1 if the file is opened, the format is not
+// LogTlmFormat_Container, or the memory allocation fails.
+int logTlmHandle_setColumns(logTlm_handle_t pLog, const logTlmField_t *pFields,
+                            int numField);
+
+// Set the durability policy. The "threshold" is the bytes for
+// LogTlmDurability_Bytes or milliseconds for LogTlmDurability_Time, and
+// ignored by others. The default is LogTlmDurability_None. The latency of
+// synchronization is in logTlmStats_t. With the direct backend, the tail that
+// does not fill a block is synchronized when the file is closed.
+// Return 0 if success. Otherwise, -1 if the policy is unknown or the
+// threshold is <= 0.
+int logTlmHandle_setDurability(logTlm_handle_t pLog,
+                               LogTlmDurability durability, long threshold);
+
+// Enable the header of each record (logTlmRecordHeader_t), which has the
+// sequence number and TAI time. The header is before the data in the buffer
+// and file, so the offsets of columns in logTlmHandle_setColumns() include
+// it. The TAI time is from the monotonic clock and the offset between them is
+// updated in the flush, so logTlm_write() does not make the system call. The
+// default is disabled. This should be called before the creation of buffers.
+// Return 0 if success. Otherwise, -1 if the buffers are created.
+int logTlmHandle_setRecordHeader(logTlm_handle_t pLog, bool isEnabled);
+
+// Set the decimation of the records. For LogTlmDecimation_MinMaxMean, each
+// field in "pFields" is an array of double and the other bytes of the 3
+// records, including the record header, are from the last record of window.
+// The offsets of fields include the record header as
+// logTlmHandle_setColumns(). The "pFields" is ignored by others. The default
+// is LogTlmDecimation_None. The setting is cleared when the buffers are
+// created or freed.
+// Requires: the buffers are created
+// Return 0 if success. Otherwise, -1 if the decimation is unknown, the factor
+// is <= 0, the field is not an array of double in the record, the file is
+// opened, or the memory allocation fails.
+int logTlmHandle_setDecimation(logTlm_handle_t pLog,
+                               LogTlmDecimation decimation, int factor,
+                               const logTlmField_t *pFields, int numField);
+
+// Set the trigger of the full-rate capture. The last "numPreTrigger" records
+// are kept in the ring in memory before the decimation. When "trigger" fires,
+// the ring is written at the full rate, followed by the next "numPostTrigger"
+// records. The trigger is checked again in the full-rate capture and extends
+// it. Put "trigger" to be NULL to disable it, which is the default. The
+// setting is cleared when the buffers are created or freed.
+// Requires: the buffers are created
+// Return 0 if success. Otherwise, -1 if the number of records is < 0, the file
+// is opened, or the memory allocation fails.
+int logTlmHandle_setTrigger(logTlm_handle_t pLog, logTlmTrigger_t trigger,
+                            void *pUser, int numPreTrigger,
+                            int numPostTrigger);
+
+// Period to check the age of rotated files by the retention in seconds
+#define LOGTLM_RETENTION_PERIOD 60
+
+// Set the retention of the rotated files ("file.0", "file.1", ...) of the
+// current file name. The retention thread applies it after each rotation and
+// every LOGTLM_RETENTION_PERIOD seconds for the age, and the account of disk
+// usage is in logTlmStats_t. The rotation only wakes up the thread, so the
+// writing and flush never wait for the deletion or compression. Put
+// "pRetention" to be NULL or the budgets to be 0 to stop the thread, which is
+// the default. The thread is not stopped by logTlm_closeThread() but by
+// logTlmHandle_free().
+// Return 0 if success. Otherwise, -1 if the budget is < 0 or the thread can
+// not be created.
+int logTlmHandle_setRetention(logTlm_handle_t pLog,
+                              const logTlmRetention_t *pRetention);
+
+// Write the records in the pre-trigger ring and the partial window of
+// decimation. They are kept in memory otherwise, so call this before
+// logTlm_flush() at the end of logging.
+// Return the same as logTlm_write().
+int logTlmHandle_flushCapture(logTlm_handle_t pLog);
+
+// The following functions are the same as the logTlm_*() ones but for the
+// logger of "pLog".
+char *logTlmHandle_getFilename(logTlm_handle_t pLog);
+void *logTlmHandle_getBuffer(logTlm_handle_t pLog, int id);
+void logTlmHandle_freeBuffer(logTlm_handle_t pLog);
+int logTlmHandle_createBuffer(logTlm_handle_t pLog, int sizeBuffer,
+                              size_t sizeElement);
+int logTlmHandle_createBufferPool(logTlm_handle_t pLog, int num,
+                                  int sizeBuffer, size_t sizeElement);
+int logTlmHandle_close(logTlm_handle_t pLog);
+int logTlmHandle_open(logTlm_handle_t pLog, char *pathDir,
+                      char *formatFilename, int recordPerFile);
+int logTlmHandle_write(logTlm_handle_t pLog, void *pData);
+int logTlmHandle_flush(logTlm_handle_t pLog);
+bool logTlmHandle_isFlushing(logTlm_handle_t pLog);
+void logTlmHandle_getStats(logTlm_handle_t pLog, logTlmStats_t *pStats);
+void logTlmHandle_closeThread(logTlm_handle_t pLog);
+int logTlmHandle_runFlushInNewThread(logTlm_handle_t pLog, int *pTimeInMs);
+
 #endif // LOGTLM_H
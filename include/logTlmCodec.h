@@ -0,0 +1,31 @@
+#ifndef LOGTLMCODEC_H
+#define LOGTLMCODEC_H
+
+#include <stddef.h>
+
+// Codec of the blocks in the container format of telemetry file
+typedef enum {
+    // The records are stored as they are.
+    LogTlmCodec_None = 1,
+    // Each byte is XORed with the same byte of the previous record, the bytes
+    // are shuffled so the same byte of all the records are together, and the
+    // runs of zero are encoded. The slowly changing fields become the long
+    // runs of zero.
+    LogTlmCodec_XorShuffle = 2,
+} LogTlmCodec;
+
+// Encode the "numRecord" records of "sizeElement" bytes in "pSrc" to "pDst"
+// that has "sizeDstMax" bytes.
+// Return the number of encoded bytes. Otherwise, -1 if the codec is unknown or
+// the encoded data does not fit in "pDst".
+long logTlmCodec_encode(LogTlmCodec codec, void *pSrc, int numRecord,
+                        size_t sizeElement, void *pDst, size_t sizeDstMax);
+
+// Decode the "sizeSrc" bytes in "pSrc" to the "numRecord" records of
+// "sizeElement" bytes in "pDst".
+// Return 0 if success. Otherwise, -1 if the codec is unknown or the data is
+// corrupted.
+int logTlmCodec_decode(LogTlmCodec codec, void *pSrc, size_t sizeSrc,
+                       int numRecord, size_t sizeElement, void *pDst);
+
+#endif // LOGTLMCODEC_H
@@ -0,0 +1,101 @@
+#ifndef LOGTLMREADER_H
+#define LOGTLMREADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "logTlm.h"
+
+// Handle of the reader of telemetry files written by logTlm. The reader maps
+// the rotated set of a telemetry file ("file.0", "file.1", ..., "file") in
+// the order of writing and iterates the records.
+typedef struct logTlmReader_t *logTlmReader_handle_t;
+
+// Callback to receive a record in logTlmReader_replay(). The "pUser" is the
+// pointer given to logTlmReader_replay().
+// Return 0 if success. Otherwise, -1 to stop the replay.
+typedef int (*logTlmReaderSink_t)(void *pUser, const void *pRecord,
+                                  size_t sizeRecord);
+
+// Open the rotated set of the telemetry file. The files in the container format
+// are detected by the header. The "sizeElement" is the size of record in the
+// raw format and is ignored for the container format. Put 0 if all the files
+// are in the container format. A container file without the index, which is
+// still written or not closed properly, is read by scanning the blocks. The
+// oldest rotated files deleted by the retention of logTlm are skipped.
+// Return the handle. Otherwise, NULL if no file is found, the file is
+// corrupted, or the element size is unknown or different between the files.
+logTlmReader_handle_t logTlmReader_open(const char *filename,
+                                        size_t sizeElement);
+
+// Unmap the files and free the handle.
+void logTlmReader_close(logTlmReader_handle_t pReader);
+
+// Get the size of record in bytes without the record header.
+size_t logTlmReader_getSizeElement(logTlmReader_handle_t pReader);
+
+// Get the number of files in the rotated set.
+int logTlmReader_getNumFile(logTlmReader_handle_t pReader);
+
+// Get the total number of records in the files, including the gap markers.
+long logTlmReader_getNumRecord(logTlmReader_handle_t pReader);
+
+// Set the time range in nanoseconds since the epoch. Only the records in
+// [timeStartNs, timeEndNs] are read. The blocks out of the range are skipped
+// by the binary search of the index. The time of record is interpolated in the
+// time range of its block if the records have no header. The records in the
+// raw format have no time and are not filtered. This rewinds the reader.
+void logTlmReader_setTimeRange(logTlmReader_handle_t pReader,
+                               int64_t timeStartNs, int64_t timeEndNs);
+
+// Set the decimation. Only one of "decimation" records is read. The default
+// is 1. This rewinds the reader.
+void logTlmReader_setDecimation(logTlmReader_handle_t pReader, int decimation);
+
+// Move to the first record.
+void logTlmReader_rewind(logTlmReader_handle_t pReader);
+
+// Get the next record. The record points to the mapped file if the block is
+// stored as it is (zero copy). Otherwise, the block is decoded to the internal
+// buffer. The record is valid until the next call or logTlmReader_close(). If
+// the records have the header (logTlmRecordHeader_t), the record points to the
+// data after the header, the time is from the header, and the gap markers are
+// skipped.
+// The "pTimeNs" can be NULL. It is 0 for the raw format.
+// Return 1 if there is a record, 0 at the end, or -1 if the block is corrupted.
+int logTlmReader_next(logTlmReader_handle_t pReader, const void **ppRecord,
+                      int64_t *pTimeNs);
+
+// Get the record header of the current record.
+// Return 0 if success. Otherwise, -1 if the record has no header.
+int logTlmReader_getRecordHeader(logTlmReader_handle_t pReader,
+                                 logTlmRecordHeader_t *pHeader);
+
+// Get the number of the dropped records marked by the gap markers in the
+// files since the last rewind.
+long logTlmReader_getNumDropped(logTlmReader_handle_t pReader);
+
+// Export the records to "pFile" as CSV from the current position. The first
+// column is the time in nanoseconds, which is followed by the sequence number
+// if the records have the header. The "pTypes" describes the record from
+// the beginning and is the comma-separated list of i8, u8, i16, u16, i32, u32,
+// i64, u64, f32, f64, or padN (N bytes skipped). The type can be followed by
+// "xN" for N values, such as "f64x6". The remaining bytes of record are
+// ignored. Put NULL to export each record as the hexadecimal bytes.
+// Return the number of exported records. Otherwise, -1 if "pTypes" is invalid
+// or longer than the record, or the block is corrupted.
+long logTlmReader_exportCsv(logTlmReader_handle_t pReader, FILE *pFile,
+                            const char *pTypes);
+
+// Replay the records from the current position into "sink". The records are
+// paced by their time divided by "speed", so 1 is the original speed and 10 is
+// 10 times faster. Put "speed" <= 0 to replay as fast as possible. The records
+// in the raw format have no time and are paced by "periodInNs" instead.
+// Return the number of replayed records. Otherwise, -1 if the sink fails or the
+// block is corrupted.
+long logTlmReader_replay(logTlmReader_handle_t pReader, double speed,
+                         long periodInNs, logTlmReaderSink_t sink,
+                         void *pUser);
+
+#endif // LOGTLMREADER_H
@@ -0,0 +1,48 @@
+#ifndef LOGTLMRETENTION_H
+#define LOGTLMRETENTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Retention of the rotated telemetry files ("file.0", "file.1", ...). The
+// current file is never touched.
+typedef struct {
+    // Maximum total size of the rotated files in bytes. 0 means no limit.
+    int64_t sizeMax;
+    // Maximum age of the rotated files in seconds since the last
+    // modification. 0 means no limit.
+    int64_t ageMaxInSec;
+    // Compress the oldest files in the container format by
+    // LogTlmCodec_XorShuffle before deleting them to meet "sizeMax".
+    bool isCompressed;
+} logTlmRetention_t;
+
+// Account of the disk usage of the rotated files
+typedef struct {
+    // Number and total size in bytes of the rotated files on the disk
+    int numFile;
+    int64_t size;
+    // Number of the deleted and compressed files
+    long numFileDeleted;
+    long numFileCompressed;
+} logTlmRetentionAccount_t;
+
+// Compress the blocks of the container file by LogTlmCodec_XorShuffle. The
+// compressed file is written to "path.tmp" and renamed to "path", so a reader
+// that has mapped the file is not affected. The time of modification is kept.
+// Return 0 if success, 1 if the file is not a closed container file with
+// LogTlmCodec_None, or -1 if failed.
+int logTlmRetention_compressFile(const char *path);
+
+// Apply the retention to the rotated files from "filename.idOldest" to
+// "filename.idNewest". The files older than "ageMaxInSec" are deleted first.
+// Then the oldest files are compressed and deleted in this order until the
+// total size is in "sizeMax". The "pAccount" has the files and size left,
+// and the numbers of deleted and compressed files are added to it.
+// Return the ID of the oldest file left. Otherwise, "idNewest" + 1 if no file
+// is left.
+int logTlmRetention_apply(const char *filename, int idOldest, int idNewest,
+                          const logTlmRetention_t *pRetention,
+                          logTlmRetentionAccount_t *pAccount);
+
+#endif // LOGTLMRETENTION_H
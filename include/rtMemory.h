@@ -0,0 +1,77 @@
+#ifndef RTMEMORY_H
+#define RTMEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocator of the buffers used in the real-time loop, such as the circular
+// buffers and telemetry buffers. The first touch of a page allocated by
+// malloc() page-faults, which may happen inside the loop. In the locked policy,
+// the memory is placed on the NUMA node of the calling thread, pre-faulted,
+// and locked by mlock() at the allocation, so allocate the buffers from the
+// thread running on (or near) the real-time core.
+
+// Size of the huge page in bytes
+#define RTMEMORY_SIZE_HUGEPAGE (2 * 1024 * 1024)
+
+// Alignment of the allocated memory in bytes, which is the cache line
+#define RTMEMORY_ALIGNMENT 64
+
+typedef enum {
+    // Allocate from the heap by calloc(). The pages are faulted on the first
+    // touch.
+    RtMemoryPolicy_Default = 1,
+    // Map the pre-faulted and locked memory. The allocation of 2 MB or more
+    // uses the huge pages if they are reserved in
+    // /proc/sys/vm/nr_hugepages. Otherwise, the transparent huge pages are
+    // advised. The small allocations that fit in the half of a page share
+    // the locked pages. The locked memory is limited by the RLIMIT_MEMLOCK,
+    // which is 64 KB by default, so raise it ("ulimit -l" or "LimitMEMLOCK="
+    // of systemd) to the buffers in use or give the CAP_IPC_LOCK. Otherwise,
+    // the memory is only pre-faulted and might be swapped out, which is
+    // counted in rtMemoryStats_t.numLockFailed.
+    RtMemoryPolicy_Locked = 2,
+} RtMemoryPolicy;
+
+// Statistics of the allocator
+typedef struct {
+    // Size of the allocated memory locked in bytes
+    int64_t sizeLocked;
+    // Size of the allocated memory on the huge pages in bytes
+    int64_t sizeHugepage;
+    // Number of the allocations that failed to be locked, which are still
+    // pre-faulted. Check the RLIMIT_MEMLOCK or CAP_IPC_LOCK if it is not 0.
+    long numLockFailed;
+} rtMemoryStats_t;
+
+// Set the allocation policy (enum: 'RtMemoryPolicy') of the process. It
+// applies to the memory allocated after this call. The memory allocated
+// before is freed in the way it was allocated.
+// Return 0 if success. Otherwise, -1.
+int rtMemory_setPolicy(RtMemoryPolicy policy);
+
+// Get the allocation policy (enum: 'RtMemoryPolicy').
+RtMemoryPolicy rtMemory_getPolicy(void);
+
+// Allocate the zeroed memory of "size" bytes aligned to RTMEMORY_ALIGNMENT.
+// Return the pointer to the memory. Otherwise, NULL.
+// This is a thread-safe function
+void *rtMemory_alloc(size_t size);
+
+// Allocate the zeroed memory of "size" bytes aligned to "alignment", which is
+// a power of 2 and >= RTMEMORY_ALIGNMENT, such as the block size of direct
+// I/O.
+// Return the pointer to the memory. Otherwise, NULL.
+// This is a thread-safe function
+void *rtMemory_allocAligned(size_t size, size_t alignment);
+
+// Free the memory allocated by rtMemory_alloc(). Nothing happens if "pMemory"
+// is NULL.
+// This is a thread-safe function
+void rtMemory_free(void *pMemory);
+
+// Get the statistics of the allocator.
+// This is a thread-safe function
+void rtMemory_getStats(rtMemoryStats_t *pStats);
+
+#endif // RTMEMORY_H
@@ -2,68 +2,128 @@
 // "examples/c/circular_buffer/circular_buffer_no_modulo_threadsafe.c" under:
 // https://github.com/embeddedartistry/embedded-resources
 
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <syslog.h>
+#include <unistd.h>
 
 #include "circular_buffer.h"
+#include "rtMemory.h"
 
-static commandStreamStructure_t *buffer;
-static pthread_mutex_t lock;
+// Size of the cache line in bytes
+#define CACHE_LINE_SIZE 64
 
-// Checks if the buffer is full
-// Requires: cbuf is valid and created by circular_buf_init()
-// Returns true if the buffer is full
-static bool circular_buf_full(circular_buf_t *cbuf) {
-    // We need to handle the wraparound case
-    size_t head = cbuf->head + 1;
-    if (head == cbuf->max) {
-        head = 0;
-    }
+// Number of bits of the sub-bins in each power of 2 of the latency histogram
+#define NUM_BIT_SUB_BIN 2
 
-    return head == cbuf->tail;
-}
+// Number of bins of the latency histogram, which covers all the uint64_t
+#define NUM_BIN_LATENCY (64 << NUM_BIT_SUB_BIN)
 
-// Checks if the buffer is empty
-// Requires: cbuf is valid and created by circular_buf_init()
-// Returns true if the buffer is empty
-static bool circular_buf_empty(cbuf_handle_t cbuf) {
-    return cbuf->head == cbuf->tail;
-}
+// Latency histogram of the data between the put and get in nanosecond. It is
+// updated by the consumer and read by any thread without the lock.
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t max;
+    _Atomic uint64_t bins[NUM_BIN_LATENCY];
+} circular_buf_latency_t;
 
-static void advance_pointer(cbuf_handle_t cbuf) {
+// The definition of our circular buffer structure is hidden from the user.
+// The head and tail are the running counts of the put and get operations, and
+// the slot in use is the count modulo the max. Because the counts never wrap
+// in practice, a consumer in the lock-free mode can always detect that the
+// producer has dropped the data it was reading.
+// In the MPMC mode, each slot has a sequence number as the bounded queue of
+// Dmitry Vyukov. The slot is free for the put with the running count "pos" if
+// the sequence is "pos", and holds the data for the get if it is "pos + 1".
+// The head and tail are only claimed by the compare-and-swap, and the slot is
+// published by its sequence after the copy. There is no wasted slot.
+// The fields written by the producer and consumer are on their own cache
+// lines, so the two cores do not invalidate each other's read-only fields.
+struct circular_buf_t {
+    uint8_t *buffer;
+    size_t sizeElement; // in bytes
+    size_t max;         // of the buffer
+    // Maximum number of data in the ring
+    size_t capacity;
+    // max - 1 if the max is a power of 2 (aligned layout), so the slot index is
+    // the count masked by it. Otherwise, 0 and the modulo is used.
+    size_t mask;
+    CircularBufMode mode;
 
-    if (circular_buf_full(cbuf)) {
-        if (++(cbuf->tail) == cbuf->max) {
-            cbuf->tail = 0;
-        }
-    }
+    // Written by the producer
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    // Futex word to wake up the consumers in circular_buf_get_timed(). It
+    // changes only when there is the waiting consumer.
+    atomic_uint futex;
+    // Number of data deleted to make room or dropped because there was no room
+    atomic_size_t numOverwrite;
 
-    if (++(cbuf->head) == cbuf->max) {
-        cbuf->head = 0;
-    }
+    // Written by the consumer (and the producer when it drops the data)
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    // Running count + 1 of the slot held by the consumer with
+    // circular_buf_peek() in the SPSC mode. 0 if there is none.
+    atomic_size_t peek;
+    // Number of the waiting consumers
+    atomic_uint numWaiter;
+
+    // Mutex lock of this buffer, used in the mutex mode only
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+    // High-priority lane of the commands, which is drained first. NULL if
+    // there is none.
+    circular_buf_t *lane;
+    // Commands that go to the high-priority lane
+    unsigned int *pCmdPriority;
+    size_t numCmdPriority;
+    // Lane that holds the data of circular_buf_peek()
+    circular_buf_t *lanePeek;
+    // Time stamps of the slots in nanosecond of CLOCK_MONOTONIC. NULL if the
+    // statistics is disabled.
+    uint64_t *pTimeStamp;
+    // Time stamps copied by the consumer before claiming the slots in the SPSC
+    // mode, because the producer can overwrite them right after the claim
+    uint64_t *pTimeStampGet;
+    // Latency histogram. NULL if the statistics is disabled.
+    circular_buf_latency_t *pLatency;
+    // Sequence numbers of the slots in the MPMC mode. NULL in the other modes.
+    atomic_size_t *pSeq;
+};
+
+// Get the capacity of the ring itself, without the high-priority lane
+static inline size_t circular_buf_capacity_ring(cbuf_handle_t cbuf) {
+    return cbuf->capacity;
 }
 
-static void retreat_pointer(cbuf_handle_t cbuf) {
-    if (++(cbuf->tail) == cbuf->max) {
-        cbuf->tail = 0;
-    }
+// Get the slot index of the running count
+static inline size_t circular_buf_index(cbuf_handle_t cbuf, size_t count) {
+    return (cbuf->mask != 0) ? (count & cbuf->mask) : (count % cbuf->max);
 }
 
-// Hold the mutex lock.
-static inline void hold_lock(void) {
-    if (pthread_mutex_lock(&lock) != 0) {
+// Get the pointer of the slot of the running count
+static inline uint8_t *circular_buf_slot(cbuf_handle_t cbuf, size_t count) {
+    return cbuf->buffer + circular_buf_index(cbuf, count) * cbuf->sizeElement;
+}
+
+// Hold the mutex lock of the buffer.
+static inline void hold_lock(cbuf_handle_t cbuf) {
+    if (pthread_mutex_lock(&cbuf->lock) != 0) {
         syslog(LOG_ERR, "Mutex lock has failed.");
         exit(1);
     }
 }
 
-// Release the mutex lock.
-static inline void release_lock(void) {
-    if (pthread_mutex_unlock(&lock) != 0) {
+// Release the mutex lock of the buffer.
+static inline void release_lock(cbuf_handle_t cbuf) {
+    if (pthread_mutex_unlock(&cbuf->lock) != 0) {
         syslog(LOG_ERR, "Mutex unlock has failed.");
         exit(1);
     }
@@ -72,36 +132,107 @@ static inline void release_lock(void) {
 // Reset the circular buffer to empty, head == tail. Data not cleared
 // Requires: cbuf is valid and created by circular_buf_init()
 static void circular_buf_reset(cbuf_handle_t cbuf) {
-    cbuf->head = 0;
-    cbuf->tail = 0;
+    atomic_init(&cbuf->head, 0);
+    atomic_init(&cbuf->tail, 0);
+    atomic_init(&cbuf->peek, 0);
+    atomic_init(&cbuf->futex, 0);
+    atomic_init(&cbuf->numWaiter, 0);
+    atomic_init(&cbuf->numOverwrite, 0);
 }
 
 cbuf_handle_t circular_buf_init(size_t size) {
+    return circular_buf_init_mode(size, CircularBufMode_Mutex);
+}
+
+cbuf_handle_t circular_buf_init_mode(size_t size, CircularBufMode mode) {
+    return circular_buf_init_element(size, sizeof(commandStreamStructure_t),
+                                     mode);
+}
+
+// Get the smallest power of 2 that is not less than "value"
+static size_t circular_buf_round_up_pow2(size_t value) {
+    size_t pow2 = 1;
+    while (pow2 < value) {
+        pow2 <<= 1;
+    }
+
+    return pow2;
+}
+
+// Create the circular buffer. In the aligned layout, the number of slots is
+// rounded up to a power of 2 and the storage is aligned to the cache line.
+static cbuf_handle_t circular_buf_create(size_t size, size_t sizeElement,
+                                         CircularBufMode mode,
+                                         bool isAligned) {
+
+    // Check the size and mode
+    if ((size < 1) || (sizeElement < 1)) {
+        return NULL;
+    }
 
-    // Check the size
-    if (size < 1) {
+    if ((mode != CircularBufMode_Mutex) && (mode != CircularBufMode_Spsc) &&
+        (mode != CircularBufMode_Mpmc)) {
+        syslog(LOG_ERR, "Unknown mode of circular buffer: %d.", mode);
         return NULL;
     }
 
-    // Add one more slot for the head and tail to use
-    size_t size_plus_one = size + 1;
+    // Add one more slot for the head and tail to use. In the lock-free mode,
+    // this is also the slot the producer writes while the buffer is full, so
+    // it never touches the data that the consumer is reading. The MPMC mode
+    // tracks each slot by its sequence number instead.
+    size_t size_plus_one = (mode == CircularBufMode_Mpmc) ? size : (size + 1);
+    if (isAligned) {
+        size_plus_one = circular_buf_round_up_pow2(size_plus_one);
+    }
+
+    // Allocate the circular buffer. Each handle owns its storage. The handle
+    // and storage are aligned to the cache line by rtMemory_alloc(), which
+    // also pre-faults and locks them in the RtMemoryPolicy_Locked.
+    uint8_t *buffer = (uint8_t *)rtMemory_alloc(size_plus_one * sizeElement);
+    cbuf_handle_t cbuf = (cbuf_handle_t)rtMemory_alloc(sizeof(circular_buf_t));
 
-    // Allocate the circular buffer
-    buffer = (commandStreamStructure_t *)malloc(
-        size_plus_one * sizeof(commandStreamStructure_t));
-    cbuf_handle_t cbuf = malloc(sizeof(circular_buf_t));
+    atomic_size_t *pSeq = NULL;
+    if (mode == CircularBufMode_Mpmc) {
+        pSeq = (atomic_size_t *)rtMemory_alloc(size_plus_one *
+                                               sizeof(atomic_size_t));
+    }
 
     // Check the memory allocation is successful or not
-    if ((buffer == NULL) || (cbuf == NULL)) {
+    if ((buffer == NULL) || (cbuf == NULL) ||
+        ((mode == CircularBufMode_Mpmc) && (pSeq == NULL))) {
         syslog(LOG_ERR, "Memory not allocated.");
+
+        rtMemory_free(buffer);
+        rtMemory_free(cbuf);
+        rtMemory_free(pSeq);
         return NULL;
     }
 
+    // All the slots are free for the first put
+    size_t idx;
+    for (idx = 0; (pSeq != NULL) && (idx < size_plus_one); idx++) {
+        atomic_init(&pSeq[idx], idx);
+    }
+
     cbuf->buffer = buffer;
+    cbuf->sizeElement = sizeElement;
     cbuf->max = size_plus_one;
+    cbuf->capacity =
+        (mode == CircularBufMode_Mpmc) ? size_plus_one : (size_plus_one - 1);
+    cbuf->mask = isAligned ? (size_plus_one - 1) : 0;
+    cbuf->mode = mode;
+    cbuf->lane = NULL;
+    cbuf->pCmdPriority = NULL;
+    cbuf->numCmdPriority = 0;
+    cbuf->lanePeek = cbuf;
+    cbuf->pTimeStamp = NULL;
+    cbuf->pTimeStampGet = NULL;
+    cbuf->pLatency = NULL;
+    cbuf->pSeq = pSeq;
     circular_buf_reset(cbuf);
 
-    if (pthread_mutex_init(&lock, NULL) != 0) {
+    if ((mode == CircularBufMode_Mutex) &&
+        (pthread_mutex_init(&cbuf->lock, NULL) != 0)) {
         syslog(LOG_ERR, "Mutex init has failed.");
         exit(1);
     }
@@ -109,69 +240,1023 @@ cbuf_handle_t circular_buf_init(size_t size) {
     return cbuf;
 }
 
+cbuf_handle_t circular_buf_init_element(size_t size, size_t sizeElement,
+                                        CircularBufMode mode) {
+    return circular_buf_create(size, sizeElement, mode, false);
+}
+
+cbuf_handle_t circular_buf_init_aligned(size_t size, size_t sizeElement,
+                                        CircularBufMode mode) {
+    return circular_buf_create(size, sizeElement, mode, true);
+}
+
 void circular_buf_free(cbuf_handle_t cbuf) {
-    free(cbuf->buffer);
-    free(cbuf);
+    if (cbuf->lane != NULL) {
+        circular_buf_free(cbuf->lane);
+        rtMemory_free(cbuf->pCmdPriority);
+    }
 
-    if (pthread_mutex_destroy(&lock) != 0) {
+    if ((cbuf->mode == CircularBufMode_Mutex) &&
+        (pthread_mutex_destroy(&cbuf->lock) != 0)) {
         syslog(LOG_ERR, "Mutex destroy has failed.");
         exit(1);
     }
+
+    rtMemory_free(cbuf->pTimeStamp);
+    rtMemory_free(cbuf->pTimeStampGet);
+    rtMemory_free(cbuf->pLatency);
+    rtMemory_free(cbuf->pSeq);
+    rtMemory_free(cbuf->buffer);
+    rtMemory_free(cbuf);
 }
 
-size_t circular_buf_size(cbuf_handle_t cbuf) {
-    // Do not consider the wasted slot
-    size_t size = cbuf->max - 1;
+CircularBufMode circular_buf_mode(cbuf_handle_t cbuf) { return cbuf->mode; }
 
-    hold_lock();
+size_t circular_buf_element_size(cbuf_handle_t cbuf) {
+    return cbuf->sizeElement;
+}
 
-    if (!circular_buf_full(cbuf)) {
-        if (cbuf->head >= cbuf->tail) {
-            size = (cbuf->head - cbuf->tail);
-        } else {
-            size = (cbuf->max + cbuf->head - cbuf->tail);
+int circular_buf_set_priority_lane(cbuf_handle_t cbuf, size_t size,
+                                   const unsigned int *pCmds, size_t numCmd) {
+
+    // Check the input
+    if ((size < 1) || (numCmd < 1) || (cbuf->lane != NULL) ||
+        (cbuf->sizeElement != sizeof(commandStreamStructure_t))) {
+        syslog(LOG_ERR, "Failed to set the priority lane of circular buffer.");
+        return -1;
+    }
+
+    // The lane has the same layout as the buffer
+    cbuf_handle_t lane =
+        circular_buf_create(size, cbuf->sizeElement, cbuf->mode,
+                            (cbuf->mask != 0));
+    unsigned int *pCmdPriority =
+        (unsigned int *)rtMemory_alloc(numCmd * sizeof(unsigned int));
+    if ((lane == NULL) || (pCmdPriority == NULL)) {
+        syslog(LOG_ERR, "Memory not allocated.");
+
+        if (lane != NULL) {
+            circular_buf_free(lane);
+        }
+        rtMemory_free(pCmdPriority);
+        return -1;
+    }
+
+    if ((cbuf->pLatency != NULL) && (circular_buf_enable_stats(lane) != 0)) {
+        circular_buf_free(lane);
+        rtMemory_free(pCmdPriority);
+        return -1;
+    }
+
+    memcpy(pCmdPriority, pCmds, numCmd * sizeof(unsigned int));
+
+    cbuf->pCmdPriority = pCmdPriority;
+    cbuf->numCmdPriority = numCmd;
+    cbuf->lane = lane;
+
+    return 0;
+}
+
+int circular_buf_enable_stats(cbuf_handle_t cbuf) {
+
+    if ((cbuf->lane != NULL) && (circular_buf_enable_stats(cbuf->lane) != 0)) {
+        return -1;
+    }
+
+    if (cbuf->pLatency != NULL) {
+        return 0;
+    }
+
+    // Let the stamps in the unused slots be zero
+    uint64_t *pTimeStamp =
+        (uint64_t *)rtMemory_alloc(cbuf->max * sizeof(uint64_t));
+    uint64_t *pTimeStampGet =
+        (uint64_t *)rtMemory_alloc(cbuf->max * sizeof(uint64_t));
+    circular_buf_latency_t *pLatency = (circular_buf_latency_t *)rtMemory_alloc(
+        sizeof(circular_buf_latency_t));
+    if ((pTimeStamp == NULL) || (pTimeStampGet == NULL) || (pLatency == NULL)) {
+        syslog(LOG_ERR, "Memory not allocated.");
+
+        rtMemory_free(pTimeStamp);
+        rtMemory_free(pTimeStampGet);
+        rtMemory_free(pLatency);
+        return -1;
+    }
+
+    cbuf->pTimeStamp = pTimeStamp;
+    cbuf->pTimeStampGet = pTimeStampGet;
+    cbuf->pLatency = pLatency;
+
+    return 0;
+}
+
+bool circular_buf_is_stats_enabled(cbuf_handle_t cbuf) {
+    return (cbuf->pLatency != NULL);
+}
+
+// Get the current time stamp in nanosecond if the statistics is enabled.
+// Otherwise, 0 to save the system call.
+static uint64_t circular_buf_now(cbuf_handle_t cbuf) {
+    if (cbuf->pLatency == NULL) {
+        return 0;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Get the bin of the latency in the histogram. The bins are exact below
+// 2^NUM_BIT_SUB_BIN and each power of 2 is split into 2^NUM_BIT_SUB_BIN
+// sub-bins above it.
+static size_t circular_buf_bin(uint64_t latency) {
+    if (latency < (1 << NUM_BIT_SUB_BIN)) {
+        return (size_t)latency;
+    }
+
+    int bitMax = 63 - __builtin_clzll(latency);
+    size_t sub = (size_t)(latency >> (bitMax - NUM_BIT_SUB_BIN)) &
+                 ((1 << NUM_BIT_SUB_BIN) - 1);
+
+    return ((size_t)(bitMax - NUM_BIT_SUB_BIN + 1) << NUM_BIT_SUB_BIN) + sub;
+}
+
+// Get the upper bound of the latency in the bin of histogram.
+static uint64_t circular_buf_bin_upper(size_t bin) {
+    if (bin < (1 << NUM_BIT_SUB_BIN)) {
+        return (uint64_t)bin;
+    }
+
+    int bitMax = (int)(bin >> NUM_BIT_SUB_BIN) + NUM_BIT_SUB_BIN - 1;
+    uint64_t sub = bin & ((1 << NUM_BIT_SUB_BIN) - 1);
+    uint64_t width = 1ULL << (bitMax - NUM_BIT_SUB_BIN);
+
+    return (1ULL << bitMax) + (sub + 1) * width - 1;
+}
+
+// Write the time stamp "timeInNs" of "num" slots starting at the running count
+// "head".
+static void circular_buf_stamp(cbuf_handle_t cbuf, size_t head, size_t num,
+                               uint64_t timeInNs) {
+    if (cbuf->pTimeStamp == NULL) {
+        return;
+    }
+
+    size_t idx = circular_buf_index(cbuf, head);
+    size_t count;
+    for (count = 0; count < num; count++) {
+        cbuf->pTimeStamp[idx] = timeInNs;
+        idx = ((idx + 1) == cbuf->max) ? 0 : (idx + 1);
+    }
+}
+
+// Copy the time stamps of "num" slots starting at the running count "tail" to
+// the consumer's copy.
+static void circular_buf_copy_stamp(cbuf_handle_t cbuf, size_t tail,
+                                    size_t num) {
+    if (cbuf->pTimeStamp == NULL) {
+        return;
+    }
+
+    size_t idx = circular_buf_index(cbuf, tail);
+    size_t count;
+    for (count = 0; count < num; count++) {
+        cbuf->pTimeStampGet[idx] = cbuf->pTimeStamp[idx];
+        idx = ((idx + 1) == cbuf->max) ? 0 : (idx + 1);
+    }
+}
+
+// Record the latency of "num" slots starting at the running count "tail" with
+// the time stamps in "pTimeStamp".
+static void circular_buf_record_latency(cbuf_handle_t cbuf,
+                                        const uint64_t *pTimeStamp,
+                                        size_t tail, size_t num) {
+    if (cbuf->pLatency == NULL) {
+        return;
+    }
+
+    uint64_t now = circular_buf_now(cbuf);
+    uint64_t latencyMax = 0;
+
+    size_t idx = circular_buf_index(cbuf, tail);
+    size_t count;
+    for (count = 0; count < num; count++) {
+        uint64_t latency =
+            (now > pTimeStamp[idx]) ? (now - pTimeStamp[idx]) : 0;
+        atomic_fetch_add_explicit(
+            &cbuf->pLatency->bins[circular_buf_bin(latency)], 1,
+            memory_order_relaxed);
+
+        if (latency > latencyMax) {
+            latencyMax = latency;
+        }
+
+        idx = ((idx + 1) == cbuf->max) ? 0 : (idx + 1);
+    }
+
+    atomic_fetch_add_explicit(&cbuf->pLatency->count, num,
+                              memory_order_relaxed);
+
+    uint64_t max =
+        atomic_load_explicit(&cbuf->pLatency->max, memory_order_relaxed);
+    while ((latencyMax > max) &&
+           !atomic_compare_exchange_weak_explicit(&cbuf->pLatency->max, &max,
+                                                  latencyMax,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+// Add the data lost to the overwrite count.
+static inline void circular_buf_count_overwrite(cbuf_handle_t cbuf,
+                                                size_t numLost) {
+    if (numLost > 0) {
+        atomic_fetch_add_explicit(&cbuf->numOverwrite, numLost,
+                                  memory_order_relaxed);
+    }
+}
+
+// Get the latency in the "percentile" (0 - 100) of the histogram "pBins".
+static uint64_t circular_buf_percentile(const uint64_t *pBins, uint64_t count,
+                                        uint64_t max, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint64_t sum = 0;
+    size_t bin;
+    for (bin = 0; bin < NUM_BIN_LATENCY; bin++) {
+        sum += pBins[bin];
+        if (sum >= rank) {
+            uint64_t upper = circular_buf_bin_upper(bin);
+            return (upper < max) ? upper : max;
+        }
+    }
+
+    return max;
+}
+
+void circular_buf_get_stats(cbuf_handle_t cbuf, circular_buf_stats_t *pStats) {
+
+    memset(pStats, 0, sizeof(circular_buf_stats_t));
+
+    // Merge the high-priority lane
+    cbuf_handle_t rings[2] = {cbuf, cbuf->lane};
+    uint64_t bins[NUM_BIN_LATENCY] = {0};
+
+    size_t idx;
+    for (idx = 0; idx < 2; idx++) {
+        cbuf_handle_t ring = rings[idx];
+        if (ring == NULL) {
+            continue;
+        }
+
+        pStats->numOverwrite +=
+            atomic_load_explicit(&ring->numOverwrite, memory_order_relaxed);
+
+        if (ring->pLatency == NULL) {
+            continue;
+        }
+
+        pStats->numLatency +=
+            atomic_load_explicit(&ring->pLatency->count, memory_order_relaxed);
+
+        uint64_t max =
+            atomic_load_explicit(&ring->pLatency->max, memory_order_relaxed);
+        if (max > pStats->latencyMax) {
+            pStats->latencyMax = max;
+        }
+
+        size_t bin;
+        for (bin = 0; bin < NUM_BIN_LATENCY; bin++) {
+            bins[bin] += atomic_load_explicit(&ring->pLatency->bins[bin],
+                                              memory_order_relaxed);
+        }
+    }
+
+    // The count might be behind the bins if the consumer is recording
+    uint64_t count = 0;
+    for (idx = 0; idx < NUM_BIN_LATENCY; idx++) {
+        count += bins[idx];
+    }
+
+    pStats->latencyP50 =
+        circular_buf_percentile(bins, count, pStats->latencyMax, 50.0);
+    pStats->latencyP99 =
+        circular_buf_percentile(bins, count, pStats->latencyMax, 99.0);
+}
+
+// The command goes to the high-priority lane or not
+static bool circular_buf_is_priority(cbuf_handle_t cbuf, const void *pData) {
+    unsigned int cmd = ((const commandStreamStructure_t *)pData)->cmd;
+
+    size_t idx;
+    for (idx = 0; idx < cbuf->numCmdPriority; idx++) {
+        if (cbuf->pCmdPriority[idx] == cmd) {
+            return true;
         }
     }
 
-    release_lock();
+    return false;
+}
+
+// Get the number of data in the ring itself
+static size_t circular_buf_size_ring(cbuf_handle_t cbuf) {
+
+    if (cbuf->mode != CircularBufMode_Mutex) {
+        // Load the tail first, so the head is never behind it. The producer
+        // might put more data in between, so clamp to the capacity.
+        size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_acquire);
+        size_t head = atomic_load_explicit(&cbuf->head, memory_order_acquire);
+
+        size_t size = head - tail;
+        return (size > circular_buf_capacity_ring(cbuf))
+                   ? circular_buf_capacity_ring(cbuf)
+                   : size;
+    }
+
+    hold_lock(cbuf);
+
+    size_t size = atomic_load_explicit(&cbuf->head, memory_order_relaxed) -
+                  atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+
+    release_lock(cbuf);
 
     return size;
 }
 
+size_t circular_buf_size(cbuf_handle_t cbuf) {
+    if (cbuf->lane != NULL) {
+        return circular_buf_size_ring(cbuf->lane) +
+               circular_buf_size_ring(cbuf);
+    }
+
+    return circular_buf_size_ring(cbuf);
+}
+
 size_t circular_buf_capacity(cbuf_handle_t cbuf) {
-    // Do not consider the wasted slot
-    return cbuf->max - 1;
+    if (cbuf->lane != NULL) {
+        return circular_buf_capacity_ring(cbuf->lane) +
+               circular_buf_capacity_ring(cbuf);
+    }
+
+    return circular_buf_capacity_ring(cbuf);
 }
 
-bool circular_buf_put(cbuf_handle_t cbuf, commandStreamStructure_t data) {
+// Copy "num" elements from "pData" to the slots starting at the running count
+// "head". There are at most two segments because of the wraparound.
+static void circular_buf_copy_in(cbuf_handle_t cbuf, size_t head,
+                                 const uint8_t *pData, size_t num) {
+    size_t idx = circular_buf_index(cbuf, head);
+    size_t numFirst = (num < (cbuf->max - idx)) ? num : (cbuf->max - idx);
+
+    memcpy(cbuf->buffer + idx * cbuf->sizeElement, pData,
+           numFirst * cbuf->sizeElement);
+    if (num > numFirst) {
+        memcpy(cbuf->buffer, pData + numFirst * cbuf->sizeElement,
+               (num - numFirst) * cbuf->sizeElement);
+    }
+}
 
-    hold_lock();
+// Copy "num" elements from the slots starting at the running count "tail" to
+// "pData". There are at most two segments because of the wraparound.
+static void circular_buf_copy_out(cbuf_handle_t cbuf, size_t tail,
+                                  uint8_t *pData, size_t num) {
+    size_t idx = circular_buf_index(cbuf, tail);
+    size_t numFirst = (num < (cbuf->max - idx)) ? num : (cbuf->max - idx);
+
+    memcpy(pData, cbuf->buffer + idx * cbuf->sizeElement,
+           numFirst * cbuf->sizeElement);
+    if (num > numFirst) {
+        memcpy(pData + numFirst * cbuf->sizeElement, cbuf->buffer,
+               (num - numFirst) * cbuf->sizeElement);
+    }
+}
+
+// Put the data under the mutex lock.
+// Return the number of old data deleted.
+static size_t circular_buf_put_mutex(cbuf_handle_t cbuf, const uint8_t *pData,
+                                     size_t num, uint64_t timeInNs) {
+
+    hold_lock(cbuf);
+
+    size_t head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
 
     // Check there will be the data lost or not
     // This check should be before putting the new data to avoid the
     // mis-judgement that the new added data might make the not-full buffer to
     // to be full
-    bool lostData = circular_buf_full(cbuf);
+    size_t numLost = 0;
+    if ((head + num) > (tail + circular_buf_capacity_ring(cbuf))) {
+        numLost = head + num - tail - circular_buf_capacity_ring(cbuf);
+    }
+
+    circular_buf_copy_in(cbuf, head, pData, num);
+    circular_buf_stamp(cbuf, head, num, timeInNs);
+
+    atomic_store_explicit(&cbuf->tail, tail + numLost, memory_order_relaxed);
+    atomic_store_explicit(&cbuf->head, head + num, memory_order_relaxed);
+
+    release_lock(cbuf);
+
+    return numLost;
+}
+
+// Make room for "num" new data at the running count "head" in the SPSC mode by
+// dropping the oldest data. If the consumer takes some of them at the same
+// time, the exchange fails and the tail is updated. Check again with it.
+// The data is never dropped while the consumer holds a slot by
+// circular_buf_peek(), otherwise the producer might overwrite that slot. Only
+// the available room is used at that time.
+// Return the number of new data that can be put. The number of deleted data
+// (old or new) is written to "pNumLost".
+static size_t circular_buf_room_spsc(cbuf_handle_t cbuf, size_t head,
+                                     size_t num, size_t *pNumLost) {
+
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_acquire);
+    while ((head + num) > (tail + circular_buf_capacity_ring(cbuf))) {
+
+        // The consumer announces the held slot before claiming it, so it is
+        // visible here once the claim is.
+        if (atomic_load_explicit(&cbuf->peek, memory_order_seq_cst) != 0) {
+            size_t numRoom = tail + circular_buf_capacity_ring(cbuf) - head;
+            *pNumLost = num - numRoom;
+            return numRoom;
+        }
+
+        size_t tailNew = head + num - circular_buf_capacity_ring(cbuf);
+        if (atomic_compare_exchange_weak_explicit(
+                &cbuf->tail, &tail, tailNew, memory_order_seq_cst,
+                memory_order_acquire)) {
+            *pNumLost = tailNew - tail;
+            return num;
+        }
+    }
+
+    *pNumLost = 0;
+    return num;
+}
+
+// Put the data without the lock. Only one thread can call this at a time.
+// Return the number of data deleted.
+static size_t circular_buf_put_spsc(cbuf_handle_t cbuf, const uint8_t *pData,
+                                    size_t num, uint64_t timeInNs) {
 
-    cbuf->buffer[cbuf->head] = data;
-    advance_pointer(cbuf);
+    // The head is only written by the producer (this thread)
+    size_t head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
 
-    release_lock();
+    size_t numLost = 0;
+    size_t numPut = circular_buf_room_spsc(cbuf, head, num, &numLost);
 
-    return lostData;
+    // If the buffer was full, the slots in [head, head + numPut) held the
+    // oldest data and the consumer might still be copying them out while they
+    // are overwritten here. The consumer detects it because the tail moved
+    // above, so its exchange of the tail fails and the torn copy is discarded.
+    circular_buf_copy_in(cbuf, head, pData, numPut);
+    circular_buf_stamp(cbuf, head, numPut, timeInNs);
+
+    // Publish the data to the consumer
+    atomic_store_explicit(&cbuf->head, head + numPut, memory_order_release);
+
+    return numLost;
+}
+
+// Claim the slot of the next put in the MPMC mode.
+// Return true and write the running count of the slot to "pHead" if success.
+// Otherwise, the buffer is full.
+static bool circular_buf_claim_put_mpmc(cbuf_handle_t cbuf, size_t *pHead) {
+
+    size_t head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+    while (true) {
+        size_t seq = atomic_load_explicit(
+            &cbuf->pSeq[circular_buf_index(cbuf, head)], memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)head;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &cbuf->head, &head, head + 1, memory_order_relaxed,
+                    memory_order_relaxed)) {
+                *pHead = head;
+                return true;
+            }
+        } else if (diff < 0) {
+            // The slot still holds the data of the last round
+            return false;
+        } else {
+            // Another producer claimed it
+            head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+        }
+    }
+}
+
+// Claim the slot of the next get in the MPMC mode.
+// Return true and write the running count of the slot to "pTail" if success.
+// Otherwise, the buffer is empty.
+static bool circular_buf_claim_get_mpmc(cbuf_handle_t cbuf, size_t *pTail) {
+
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+    while (true) {
+        size_t seq = atomic_load_explicit(
+            &cbuf->pSeq[circular_buf_index(cbuf, tail)], memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(tail + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &cbuf->tail, &tail, tail + 1, memory_order_relaxed,
+                    memory_order_relaxed)) {
+                *pTail = tail;
+                return true;
+            }
+        } else if (diff < 0) {
+            // The slot is not published yet
+            return false;
+        } else {
+            // Another consumer claimed it
+            tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// Get at most "num" data in the MPMC mode. Each element is claimed on its own,
+// so the data of a batch might interleave with the other consumers. Put NULL
+// to "pData" to drop the data.
+// Return the number of data retrieved.
+static size_t circular_buf_get_mpmc(cbuf_handle_t cbuf, uint8_t *pData,
+                                    size_t num) {
+
+    size_t numGet;
+    for (numGet = 0; numGet < num; numGet++) {
+        size_t tail = 0;
+        if (!circular_buf_claim_get_mpmc(cbuf, &tail)) {
+            break;
+        }
+
+        if (pData != NULL) {
+            circular_buf_copy_out(cbuf, tail,
+                                  pData + numGet * cbuf->sizeElement, 1);
+            circular_buf_record_latency(cbuf, cbuf->pTimeStamp, tail, 1);
+        }
+
+        // Free the slot for the put of the next round
+        atomic_store_explicit(&cbuf->pSeq[circular_buf_index(cbuf, tail)],
+                              tail + cbuf->max, memory_order_release);
+    }
+
+    return numGet;
+}
+
+// Put the data in the MPMC mode. Any number of threads can call this at the
+// same time. If the buffer is full, the oldest data is dropped to make room.
+// Return the number of data deleted.
+static size_t circular_buf_put_mpmc(cbuf_handle_t cbuf, const uint8_t *pData,
+                                    size_t num, uint64_t timeInNs) {
+
+    size_t numLost = 0;
+    size_t idx;
+    for (idx = 0; idx < num; idx++) {
+        size_t head = 0;
+        while (!circular_buf_claim_put_mpmc(cbuf, &head)) {
+            // Another producer might take the room first, so more than one
+            // data can be dropped. The buffer might also look full while
+            // another thread is copying the slot. Let it finish in that case.
+            size_t numDrop = circular_buf_get_mpmc(cbuf, NULL, 1);
+            if (numDrop == 0) {
+                sched_yield();
+            }
+            numLost += numDrop;
+        }
+
+        circular_buf_copy_in(cbuf, head, pData + idx * cbuf->sizeElement, 1);
+        circular_buf_stamp(cbuf, head, 1, timeInNs);
+
+        // Publish the data to the consumers
+        atomic_store_explicit(&cbuf->pSeq[circular_buf_index(cbuf, head)],
+                              head + 1, memory_order_release);
+    }
+
+    return numLost;
+}
+
+// Wake up the consumers waiting in circular_buf_get_timed() after new data is
+// published. There is no system call if nobody is waiting.
+static void circular_buf_wake(cbuf_handle_t cbuf) {
+
+    // Pair with the consumer, which registers itself and then checks the
+    // buffer again. Either it sees the new data or we see it waiting.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&cbuf->numWaiter, memory_order_relaxed) == 0) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&cbuf->futex, 1, memory_order_release);
+    syscall(SYS_futex, &cbuf->futex, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL,
+            0);
+}
+
+// Put "num" elements in "pData" to the ring itself. If "num" is bigger than the
+// capacity, only the newest ones are kept and the others are counted as the
+// lost data. The data is stamped with "timeInNs" for the statistics.
+// Return the number of data deleted.
+static size_t circular_buf_put_ring(cbuf_handle_t cbuf, const void *pData,
+                                    size_t num, uint64_t timeInNs) {
+
+    size_t numSkip = 0;
+    if (num > circular_buf_capacity_ring(cbuf)) {
+        numSkip = num - circular_buf_capacity_ring(cbuf);
+    }
+
+    const uint8_t *pDataPut =
+        (const uint8_t *)pData + numSkip * cbuf->sizeElement;
+    size_t numPut = num - numSkip;
+    if (numPut == 0) {
+        return 0;
+    }
+
+    size_t numLost = 0;
+    if (cbuf->mode == CircularBufMode_Spsc) {
+        numLost = circular_buf_put_spsc(cbuf, pDataPut, numPut, timeInNs);
+    } else if (cbuf->mode == CircularBufMode_Mpmc) {
+        numLost = circular_buf_put_mpmc(cbuf, pDataPut, numPut, timeInNs);
+    } else {
+        numLost = circular_buf_put_mutex(cbuf, pDataPut, numPut, timeInNs);
+    }
+
+    circular_buf_wake(cbuf);
+
+    circular_buf_count_overwrite(cbuf, numSkip + numLost);
+
+    return numSkip + numLost;
+}
+
+// Put "num" elements in "pData". The commands in the high-priority lane are
+// put there, so the other commands can never overwrite them.
+// Return the number of data deleted.
+static size_t circular_buf_put_data(cbuf_handle_t cbuf, const void *pData,
+                                    size_t num, uint64_t timeInNs) {
+    if (cbuf->lane == NULL) {
+        return circular_buf_put_ring(cbuf, pData, num, timeInNs);
+    }
+
+    // Put the other commands between the priority ones together
+    const uint8_t *pDataPut = (const uint8_t *)pData;
+    size_t numLost = 0;
+    size_t idxStart = 0;
+    size_t idx;
+    for (idx = 0; idx < num; idx++) {
+        const uint8_t *pElement = pDataPut + idx * cbuf->sizeElement;
+        if (circular_buf_is_priority(cbuf, pElement)) {
+            numLost += circular_buf_put_ring(
+                cbuf, pDataPut + idxStart * cbuf->sizeElement, idx - idxStart,
+                timeInNs);
+            numLost += circular_buf_put_ring(cbuf->lane, pElement, 1, timeInNs);
+
+            // The consumer waits on this buffer instead of the lane
+            circular_buf_wake(cbuf);
+
+            idxStart = idx + 1;
+        }
+    }
+
+    numLost += circular_buf_put_ring(
+        cbuf, pDataPut + idxStart * cbuf->sizeElement, num - idxStart,
+        timeInNs);
+
+    return numLost;
+}
+
+bool circular_buf_put_element(cbuf_handle_t cbuf, const void *pData) {
+    return (circular_buf_put_data(cbuf, pData, 1, circular_buf_now(cbuf)) > 0);
+}
+
+bool circular_buf_put(cbuf_handle_t cbuf, commandStreamStructure_t data) {
+    return circular_buf_put_element(cbuf, &data);
+}
+
+bool circular_buf_put_stamped(cbuf_handle_t cbuf, commandStreamStructure_t data,
+                              const struct timespec *pTimeRecv) {
+    uint64_t timeInNs = (uint64_t)pTimeRecv->tv_sec * 1000000000ULL +
+                        (uint64_t)pTimeRecv->tv_nsec;
+    return (circular_buf_put_data(cbuf, &data, 1, timeInNs) > 0);
+}
+
+size_t circular_buf_put_n_element(cbuf_handle_t cbuf, const void *pData,
+                                  size_t num) {
+    return circular_buf_put_data(cbuf, pData, num, circular_buf_now(cbuf));
+}
+
+size_t circular_buf_put_n(cbuf_handle_t cbuf,
+                          const commandStreamStructure_t *pData, size_t num) {
+    return circular_buf_put_data(cbuf, pData, num, circular_buf_now(cbuf));
+}
+
+// Get the data under the mutex lock.
+// Return the number of data retrieved.
+static size_t circular_buf_get_mutex(cbuf_handle_t cbuf, uint8_t *pData,
+                                     size_t num) {
+
+    hold_lock(cbuf);
+
+    size_t head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+
+    size_t numGet = ((head - tail) < num) ? (head - tail) : num;
+    if (numGet > 0) {
+        circular_buf_copy_out(cbuf, tail, pData, numGet);
+        circular_buf_record_latency(cbuf, cbuf->pTimeStamp, tail, numGet);
+        atomic_store_explicit(&cbuf->tail, tail + numGet,
+                              memory_order_relaxed);
+    }
+
+    release_lock(cbuf);
+
+    return numGet;
+}
+
+// Get the data without the lock. Only one thread can call this at a time.
+// Return the number of data retrieved.
+static size_t circular_buf_get_spsc(cbuf_handle_t cbuf, uint8_t *pData,
+                                    size_t num) {
+
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_acquire);
+    while (true) {
+        size_t head = atomic_load_explicit(&cbuf->head, memory_order_acquire);
+        if (head == tail) {
+            return 0;
+        }
+
+        size_t numGet = ((head - tail) < num) ? (head - tail) : num;
+        circular_buf_copy_out(cbuf, tail, pData, numGet);
+        circular_buf_copy_stamp(cbuf, tail, numGet);
+
+        // Claim the slots. If the producer dropped any of them while we were
+        // copying (the data might be torn), the exchange fails and "tail" is
+        // updated to the new oldest one. Retry with it.
+        if (atomic_compare_exchange_strong_explicit(
+                &cbuf->tail, &tail, tail + numGet, memory_order_acq_rel,
+                memory_order_acquire)) {
+            circular_buf_record_latency(cbuf, cbuf->pTimeStampGet, tail,
+                                        numGet);
+            return numGet;
+        }
+    }
+}
+
+// Get at most "num" elements from the ring itself to "pData".
+// Return the number of data retrieved.
+static size_t circular_buf_get_ring(cbuf_handle_t cbuf, void *pData,
+                                    size_t num) {
+    if (num == 0) {
+        return 0;
+    }
+
+    if (cbuf->mode == CircularBufMode_Spsc) {
+        return circular_buf_get_spsc(cbuf, (uint8_t *)pData, num);
+    }
+
+    if (cbuf->mode == CircularBufMode_Mpmc) {
+        return circular_buf_get_mpmc(cbuf, (uint8_t *)pData, num);
+    }
+
+    return circular_buf_get_mutex(cbuf, (uint8_t *)pData, num);
+}
+
+// Get at most "num" elements to "pData". The high-priority lane is drained
+// first.
+// Return the number of data retrieved.
+static size_t circular_buf_get_data(cbuf_handle_t cbuf, void *pData,
+                                    size_t num) {
+    if (cbuf->lane == NULL) {
+        return circular_buf_get_ring(cbuf, pData, num);
+    }
+
+    size_t numGet = circular_buf_get_ring(cbuf->lane, pData, num);
+    if (numGet < num) {
+        numGet += circular_buf_get_ring(
+            cbuf, (uint8_t *)pData + numGet * cbuf->sizeElement, num - numGet);
+    }
+
+    return numGet;
+}
+
+bool circular_buf_get_element(cbuf_handle_t cbuf, void *pData) {
+    return (circular_buf_get_data(cbuf, pData, 1) == 0);
 }
 
 bool circular_buf_get(cbuf_handle_t cbuf, commandStreamStructure_t *data) {
+    return circular_buf_get_element(cbuf, data);
+}
+
+bool circular_buf_get_timed_element(cbuf_handle_t cbuf, void *pData,
+                                    const struct timespec *pDeadline) {
+
+    while (true) {
+        if (circular_buf_get_data(cbuf, pData, 1) == 1) {
+            return false;
+        }
+
+        // Register as the waiting consumer and check the buffer again. Any
+        // later put changes the futex word and wakes us up.
+        unsigned int futex =
+            atomic_load_explicit(&cbuf->futex, memory_order_acquire);
+        atomic_fetch_add_explicit(&cbuf->numWaiter, 1, memory_order_seq_cst);
+
+        if (circular_buf_get_data(cbuf, pData, 1) == 1) {
+            atomic_fetch_sub_explicit(&cbuf->numWaiter, 1,
+                                      memory_order_relaxed);
+            return false;
+        }
+
+        // The timeout of FUTEX_WAIT_BITSET is the absolute time of
+        // CLOCK_MONOTONIC
+        long status =
+            syscall(SYS_futex, &cbuf->futex, FUTEX_WAIT_BITSET_PRIVATE, futex,
+                    pDeadline, NULL, FUTEX_BITSET_MATCH_ANY);
+        int error = errno;
+
+        atomic_fetch_sub_explicit(&cbuf->numWaiter, 1, memory_order_relaxed);
+
+        // Last try when the deadline passed
+        if ((status == -1) && (error == ETIMEDOUT)) {
+            return (circular_buf_get_data(cbuf, pData, 1) == 0);
+        }
+
+        // Otherwise, woken up, interrupted, or the futex word changed already
+    }
+}
+
+bool circular_buf_get_timed(cbuf_handle_t cbuf, commandStreamStructure_t *data,
+                            const struct timespec *pDeadline) {
+    return circular_buf_get_timed_element(cbuf, data, pDeadline);
+}
+
+size_t circular_buf_get_n_element(cbuf_handle_t cbuf, void *pData, size_t num) {
+    return circular_buf_get_data(cbuf, pData, num);
+}
+
+size_t circular_buf_get_n(cbuf_handle_t cbuf, commandStreamStructure_t *pData,
+                          size_t num) {
+    return circular_buf_get_data(cbuf, pData, num);
+}
+
+void *circular_buf_reserve(cbuf_handle_t cbuf) {
+
+    // The slot can not be tracked per producer in the MPMC mode
+    if (cbuf->mode == CircularBufMode_Mpmc) {
+        return NULL;
+    }
+
+    // Hold the lock until circular_buf_commit() in the mutex mode
+    if (cbuf->mode == CircularBufMode_Mutex) {
+        hold_lock(cbuf);
+        return circular_buf_slot(
+            cbuf, atomic_load_explicit(&cbuf->head, memory_order_relaxed));
+    }
+
+    // The head slot is never in [tail, head), so the producer can write it in
+    // place. The room is checked again in circular_buf_commit().
+    size_t head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_acquire);
+    if (((head - tail) == circular_buf_capacity_ring(cbuf)) &&
+        (atomic_load_explicit(&cbuf->peek, memory_order_seq_cst) != 0)) {
+        return NULL;
+    }
+
+    return circular_buf_slot(cbuf, head);
+}
+
+bool circular_buf_commit(cbuf_handle_t cbuf) {
 
-    hold_lock();
+    size_t head = atomic_load_explicit(&cbuf->head, memory_order_relaxed);
 
-    bool isBufEmpty = circular_buf_empty(cbuf);
-    if (!isBufEmpty) {
-        *data = cbuf->buffer[cbuf->tail];
-        retreat_pointer(cbuf);
+    // Move the priority command to its lane. The reserved slot is not added.
+    uint8_t *pSlot = circular_buf_slot(cbuf, head);
+    if ((cbuf->lane != NULL) && circular_buf_is_priority(cbuf, pSlot)) {
+        bool lostData = (circular_buf_put_ring(cbuf->lane, pSlot, 1,
+                                               circular_buf_now(cbuf)) > 0);
+
+        if (cbuf->mode == CircularBufMode_Mutex) {
+            release_lock(cbuf);
+        }
+
+        circular_buf_wake(cbuf);
+
+        return lostData;
+    }
+
+    if (cbuf->mode == CircularBufMode_Mutex) {
+        size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+
+        bool lostData = ((head - tail) == circular_buf_capacity_ring(cbuf));
+        if (lostData) {
+            atomic_store_explicit(&cbuf->tail, tail + 1, memory_order_relaxed);
+        }
+        circular_buf_stamp(cbuf, head, 1, circular_buf_now(cbuf));
+        atomic_store_explicit(&cbuf->head, head + 1, memory_order_relaxed);
+
+        release_lock(cbuf);
+
+        circular_buf_wake(cbuf);
+
+        circular_buf_count_overwrite(cbuf, lostData ? 1 : 0);
+
+        return lostData;
+    }
+
+    // The reserved data is dropped if there is no room for it
+    size_t numLost = 0;
+    size_t numPut = circular_buf_room_spsc(cbuf, head, 1, &numLost);
+    circular_buf_stamp(cbuf, head, numPut, circular_buf_now(cbuf));
+    atomic_store_explicit(&cbuf->head, head + numPut, memory_order_release);
+
+    circular_buf_wake(cbuf);
+
+    circular_buf_count_overwrite(cbuf, numLost);
+
+    return (numLost > 0);
+}
+
+// Peek the oldest element in the ring itself.
+static void *circular_buf_peek_ring(cbuf_handle_t cbuf) {
+
+    // Hold the lock until circular_buf_release() in the mutex mode
+    if (cbuf->mode == CircularBufMode_Mutex) {
+        hold_lock(cbuf);
+
+        size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+        if (atomic_load_explicit(&cbuf->head, memory_order_relaxed) == tail) {
+            release_lock(cbuf);
+            return NULL;
+        }
+
+        return circular_buf_slot(cbuf, tail);
+    }
+
+    size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_acquire);
+    while (true) {
+        size_t head = atomic_load_explicit(&cbuf->head, memory_order_acquire);
+        if (head == tail) {
+            atomic_store_explicit(&cbuf->peek, 0, memory_order_release);
+            return NULL;
+        }
+
+        // Announce the held slot before claiming it. The producer checks it
+        // before dropping the old data, so either the claim fails or the
+        // producer sees the held slot.
+        atomic_store_explicit(&cbuf->peek, tail + 1, memory_order_seq_cst);
+        if (atomic_compare_exchange_strong_explicit(
+                &cbuf->tail, &tail, tail + 1, memory_order_seq_cst,
+                memory_order_acquire)) {
+            return circular_buf_slot(cbuf, tail);
+        }
+    }
+}
+
+// Release the element held by circular_buf_peek_ring().
+static void circular_buf_release_ring(cbuf_handle_t cbuf) {
+
+    if (cbuf->mode == CircularBufMode_Mutex) {
+        size_t tail = atomic_load_explicit(&cbuf->tail, memory_order_relaxed);
+        circular_buf_record_latency(cbuf, cbuf->pTimeStamp, tail, 1);
+        atomic_store_explicit(&cbuf->tail, tail + 1, memory_order_relaxed);
+
+        release_lock(cbuf);
+        return;
     }
 
-    release_lock();
+    // The slot was claimed in circular_buf_peek() already. The producer does
+    // not write the slot or its time stamp before the release.
+    size_t peek = atomic_load_explicit(&cbuf->peek, memory_order_relaxed);
+    circular_buf_record_latency(cbuf, cbuf->pTimeStamp, peek - 1, 1);
+
+    atomic_store_explicit(&cbuf->peek, 0, memory_order_release);
+}
+
+void *circular_buf_peek(cbuf_handle_t cbuf) {
+
+    // The slot can not be tracked per consumer in the MPMC mode
+    if (cbuf->mode == CircularBufMode_Mpmc) {
+        return NULL;
+    }
+    if (cbuf->lane == NULL) {
+        return circular_buf_peek_ring(cbuf);
+    }
+
+    // Peek the high-priority lane first
+    void *pData = circular_buf_peek_ring(cbuf->lane);
+    if (pData != NULL) {
+        cbuf->lanePeek = cbuf->lane;
+        return pData;
+    }
+
+    cbuf->lanePeek = cbuf;
+    return circular_buf_peek_ring(cbuf);
+}
 
-    return isBufEmpty;
+void circular_buf_release(cbuf_handle_t cbuf) {
+    circular_buf_release_ring((cbuf->lane != NULL) ? cbuf->lanePeek : cbuf);
 }
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "cmdTlmServer.h"
@@ -499,12 +500,27 @@ static void *cmdTlmServer_run(void *pData) {
                 break;
             }
 
+            // Receive time of the command, so the latency statistics covers
+            // the time in the server as well. It is only taken when the
+            // statistics is enabled.
+            struct timespec timeRecv = {0, 0};
+            bool isStamped =
+                circular_buf_is_stats_enabled(pServerInfo->cmdMsgBuffer);
+            if (isStamped) {
+                clock_gettime(CLOCK_MONOTONIC, &timeRecv);
+            }
+
             commandStatusStructure_t cmdStatus;
             bool isCmdAuthorized = cmdTlmServer_isCmdAuthorized(
                 &cmdStatus, &cmdMsg, pServerInfo->isCommander);
             if (isCmdAuthorized) {
                 // Write command to command message buffer
-                if (circular_buf_put(pServerInfo->cmdMsgBuffer, cmdMsg)) {
+                bool isOverwritten =
+                    isStamped
+                        ? circular_buf_put_stamped(pServerInfo->cmdMsgBuffer,
+                                                   cmdMsg, &timeRecv)
+                        : circular_buf_put(pServerInfo->cmdMsgBuffer, cmdMsg);
+                if (isOverwritten) {
                     syslog(LOG_NOTICE,
                            "The command message is overwritten in %s server.",
                            pServerInfo->pName);
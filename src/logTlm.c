@@ -1,395 +1,2919 @@
+// Needed for O_DIRECT
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
 
-#include "logTlm.h"
-#include "utility.h"
+#include "logTlm.h"
+#include "rtMemory.h"
+#include "utility.h"
+
+// Block size of the direct I/O in bytes. The buffer address, file offset, and
+// size of each writing are aligned to this.
+#define LOGTLM_BLOCK_SIZE 4096
+
+// Capacity of the queue of direct I/O thread
+#define LOGTLM_NUM_WRITE_DIRECT 16
+
+// Queue of the buffer IDs (1 to numBuffer)
+typedef struct {
+    int *pIds;
+    // Maximum number of the IDs
+    int max;
+    // Index of the first ID
+    int head;
+    // Number of the IDs
+    int num;
+} logTlmBufferList_t;
+
+// Write of the direct backend queued to the direct I/O thread
+typedef struct {
+    // File descriptor
+    int fd;
+    // Aligned data to write. NULL means the fdatasync() of file after the
+    // writes queued before.
+    uint8_t *pData;
+    // Size of the data in bytes, which is the multiple of block size
+    size_t size;
+    // Offset in the file
+    off_t offset;
+    // ID of the buffer that has the data. 0 means the staging buffer.
+    int idBuffer;
+} logTlmWriteDirect_t;
+
+// Opened telemetry file. The fields in use depend on the backend.
+typedef struct {
+    // Pointer of the file (stream backend)
+    FILE *pFile;
+
+    // File descriptor (direct and mmap backends)
+    int fd;
+
+    // Offset of the next block in the file (direct backend)
+    off_t offsetDirect;
+
+    // Aligned staging buffer of 2 halves (direct backend). The data that is
+    // not an aligned buffer is copied to the active half. Its whole blocks are
+    // written while the other half takes the tail, which is kept until the
+    // next writing or closing of the file.
+    uint8_t *pDirect;
+
+    // Size of each half of the staging buffer in bytes
+    size_t sizeDirect;
+
+    // Number of bytes in the active half
+    size_t numDirect;
+
+    // Index of the active half
+    int idxDirect;
+
+    // Count of the queued writes when each half was written, so the half is
+    // reused after the direct I/O thread writes it
+    long countsDirect[2];
+
+    // Mapping of the whole file (mmap backend)
+    void *pMap;
+
+    // Size of the mapping in bytes
+    size_t sizeMap;
+
+    // Records in the mapping that have been synchronized to the file
+    int countFileSynced;
+
+    // Bytes written to the file (stream and direct backends)
+    off_t sizeWritten;
+
+    // Bytes whose writeback has been started by the durability policy
+    off_t sizeSynced;
+
+    // Index of the blocks (container format)
+    logTlmIndexEntry_t *pIndex;
+
+    // Number of the entries in the index
+    int numIndex;
+
+    // Capacity of the index
+    int maxIndex;
+} logTlmFile_t;
+
+// Time range of the records in a buffer
+typedef struct {
+    int64_t timeMinNs;
+    int64_t timeMaxNs;
+} logTlmTimeRange_t;
+
+// The definition of the telemetry logger is hidden from the user. Each handle
+// owns its buffers, file, and flush thread.
+struct logTlm_t {
+    // File name
+    char *filename;
+
+    // Backend to write the file
+    LogTlmBackend backend;
+
+    // Format of the file
+    LogTlmFormat format;
+
+    // ID of the record layout in the header of container format
+    uint32_t schemaId;
+
+    // Codec of the blocks in container format
+    LogTlmCodec codec;
+
+    // Buffer of the encoded block, which has the size of a buffer
+    void *pEncoded;
+
+    // Fields of the columnar layout
+    logTlmField_t *pFields;
+
+    // Number of the fields. 0 means the row layout.
+    int numField;
+
+    // Size of each column in the block in bytes
+    uint32_t *pSizeColumns;
+
+    // Buffer of a column before the encoding, which has the size of a buffer
+    void *pColumn;
+
+    // Current file in use
+    logTlmFile_t file;
+
+    // Next file prepared by the housekeeping thread (critical section)
+    logTlmFile_t fileNext;
+
+    // Old file to close and rename by the housekeeping thread (critical
+    // section)
+    logTlmFile_t fileOld;
+
+    // ID of rotated file of the old file
+    int idRotateOld;
+
+    // Pointers of the buffers
+
+    // Current buffer in use, which is one in ppBuffers or NULL.
+    void *pBufferCurrent;
+
+    // Buffers that store the data, which are aligned to the block. The ID of
+    // buffer is the index + 1.
+    void **ppBuffers;
+
+    // Number of the flush and queued writes that are using each buffer, so it
+    // is not reused before written. The index is the buffer ID - 1. (critical
+    // section)
+    int *pCountsWriting;
+
+    // Number of the buffers
+    int numBuffer;
+
+    // Time range of the records in each buffer (container format). The index
+    // is the buffer ID - 1. (critical section)
+    logTlmTimeRange_t *pTimeRanges;
+
+    // Time range of the records in the current buffer (container format)
+    logTlmTimeRange_t timeRangeCurrent;
+
+    // Buffers that can be written (critical section)
+    logTlmBufferList_t listFree;
+
+    // Full buffers to flush in order. The buffer stays in the list until it
+    // is flushed. (critical section)
+    logTlmBufferList_t listFull;
+
+    // High-water mark of the full buffers (critical section)
+    int numBufferFullMax;
+
+    // Number of the records dropped because all the buffers were full
+    // (critical section)
+    long numRecordDropped;
+
+    // Size of each element in buffer, including the record header
+    size_t sizeElementInBuffer;
+
+    // Size of the record header. 0 means the header is disabled.
+    size_t sizeRecordHeader;
+
+    // Sequence number of the next record
+    uint64_t sequence;
+
+    // There are the dropped records not marked in the file yet
+    bool isGap;
+
+    // Sequence number of the first dropped record of the gap
+    uint64_t sequenceGap;
+
+    // Offset of the TAI time from the monotonic clock in nanoseconds. It is
+    // updated in the flush and read by logTlm_write(). (atomic)
+    int64_t timeOffsetTaiNs;
+
+    // Durability policy of the file
+    LogTlmDurability durability;
+
+    // Threshold of the durability policy in bytes or milliseconds
+    long thresholdDurability;
+
+    // Monotonic time of the last synchronization in nanoseconds
+    int64_t timeSyncLastNs;
+
+    // There is the fdatasync() of "fdSync" for the housekeeping thread. It is
+    // kept until the fdatasync() is done. (critical section)
+    bool isSyncPending;
+
+    // File descriptor to synchronize (critical section)
+    int fdSync;
+
+    // There is the fdatasync() of "fdSyncQueued" to do after the pending one,
+    // which is for another file after the rotation. (critical section)
+    bool isSyncQueued;
+
+    // File descriptor to synchronize after the pending one (critical section)
+    int fdSyncQueued;
+
+    // Statistics of fdatasync() (critical section)
+    long numSync;
+    long numSyncFailed;
+    int64_t timeSyncTotalNs;
+    int64_t timeSyncMaxNs;
+
+    // Decimation of the records out of the pre-trigger ring
+    LogTlmDecimation decimation;
+
+    // Factor of the decimation
+    int factorDecimation;
+
+    // Position of the record in the sample or window of decimation
+    int countDecimation;
+
+    // Fields of the min/max/mean decimation as the arrays of double
+    logTlmField_t *pFieldsDecimation;
+
+    // Number of the fields of the min/max/mean decimation
+    int numFieldDecimation;
+
+    // Minimum, maximum, and sum of the values in the window, which has 3
+    // arrays of the values in the fields in this order
+    double *pWindowValues;
+
+    // Number of the values in the fields
+    int numValueWindow;
+
+    // Last record in the window and the record to write, which are 2 records
+    // in the format of buffer
+    uint8_t *pWindowRecords;
+
+    // Predicate to trigger the full-rate capture. NULL means no trigger.
+    logTlmTrigger_t trigger;
+
+    // Pointer given to the trigger
+    void *pUserTrigger;
+
+    // Number of the records kept before the trigger
+    int numPreTrigger;
+
+    // Number of the records written at the full rate after the trigger
+    int numPostTrigger;
+
+    // Records left in the full-rate capture
+    int countPostTrigger;
+
+    // Ring of the records before the decimation in the format of buffer. It
+    // has "numPreTrigger" + 1 records. NULL means all the records are written
+    // directly.
+    uint8_t *pRing;
+
+    // Index of the oldest record in the ring
+    int headRing;
+
+    // Number of the records in the ring
+    int numRing;
+
+    // Number of the triggered full-rate captures (critical section)
+    long numTrigger;
+
+    // Counter of the rotating file
+    int countRotatingFile;
+
+    // Maximum count per file
+    int countFileMax;
+
+    // Current count of the file
+    int countFile;
+
+    // Maximum count of the buffer
+    int countBufferMax;
+
+    // Current count in the buffer
+    int countBufferCurrent;
+
+    // Mutex lock
+    pthread_mutex_t lock;
+
+    // Condition to wake up the thread when a buffer is full or the thread is
+    // closed
+    pthread_cond_t condFull;
+
+    // Thread to flush the data to file
+    pthread_t thread;
+
+    // Thread is ready or not
+    bool isThreadReady;
+
+    // There is the job for the housekeeping thread (critical section)
+    bool isHousekeepingPending;
+
+    // Condition to wake up the housekeeping thread or the waiters of its job
+    pthread_cond_t condHousekeeping;
+
+    // Thread to prepare the next file and close the old one
+    pthread_t threadHousekeeping;
+
+    // Housekeeping thread is ready or not
+    bool isHousekeepingReady;
+
+    // Retention of the rotated files (critical section)
+    logTlmRetention_t retention;
+
+    // Filename of the rotated files in the retention (critical section)
+    char *filenameRetention;
+
+    // IDs of the oldest and newest rotated files in the retention (critical
+    // section)
+    int idRetentionOldest;
+    int idRetentionNewest;
+
+    // Account of the rotated files (critical section)
+    logTlmRetentionAccount_t accountRetention;
+
+    // There is the job for the retention thread (critical section)
+    bool isRetentionPending;
+
+    // Condition to wake up the retention thread
+    pthread_cond_t condRetention;
+
+    // Thread to delete or compress the rotated files
+    pthread_t threadRetention;
+
+    // Retention thread is ready or not
+    bool isRetentionReady;
+
+    // Writes of the direct backend in order (critical section)
+    logTlmWriteDirect_t writesDirect[LOGTLM_NUM_WRITE_DIRECT];
+
+    // Index of the first write and number of the writes in the queue
+    // (critical section)
+    int headWriteDirect;
+    int numWriteDirect;
+
+    // Counts of the queued and done writes (critical section)
+    long countWriteQueued;
+    long countWriteDone;
+
+    // A queued write failed. It is cleared when the file is opened. (critical
+    // section)
+    bool isWriteDirectFailed;
+
+    // Condition to wake up the direct I/O thread or the waiters of its writes
+    pthread_cond_t condDirect;
+
+    // Thread to write the data of direct backend, so the flush does not wait
+    // for the last write
+    pthread_t threadDirect;
+
+    // Direct I/O thread is ready or not
+    bool isDirectReady;
+};
+
+// Default logger used by the functions without the handle
+static struct logTlm_t logTlmDefault = {
+    .filename = "",
+    .backend = LogTlmBackend_Stream,
+    .format = LogTlmFormat_Raw,
+    .codec = LogTlmCodec_None,
+    .durability = LogTlmDurability_None,
+    .file = {.fd = -1},
+    .fileNext = {.fd = -1},
+    .fileOld = {.fd = -1},
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .condFull = PTHREAD_COND_INITIALIZER,
+    .condHousekeeping = PTHREAD_COND_INITIALIZER,
+    .condRetention = PTHREAD_COND_INITIALIZER,
+    .condDirect = PTHREAD_COND_INITIALIZER,
+};
+
+// The file is opened or not.
+static inline bool logTlm_isFileOpen(logTlmFile_t *pFileTlm) {
+    return (pFileTlm->pFile != NULL) || (pFileTlm->fd != -1);
+}
+
+// The file is synchronized to the disk when closing or not.
+static inline bool logTlm_isDurable(logTlm_handle_t pLog) {
+    return pLog->durability != LogTlmDurability_None;
+}
+
+// Reset the file to be closed.
+static inline void logTlm_resetFile(logTlmFile_t *pFileTlm) {
+    memset(pFileTlm, 0, sizeof(logTlmFile_t));
+    pFileTlm->fd = -1;
+}
+
+logTlm_handle_t logTlmHandle_init(void) {
+    logTlm_handle_t pLog = (logTlm_handle_t)calloc(1, sizeof(struct logTlm_t));
+    if (pLog == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the memory of telemetry logger.");
+        return NULL;
+    }
+
+    pLog->filename = "";
+    pLog->backend = LogTlmBackend_Stream;
+    pLog->format = LogTlmFormat_Raw;
+    pLog->codec = LogTlmCodec_None;
+    pLog->durability = LogTlmDurability_None;
+    logTlm_resetFile(&pLog->file);
+    logTlm_resetFile(&pLog->fileNext);
+    logTlm_resetFile(&pLog->fileOld);
+
+    if (pthread_mutex_init(&pLog->lock, NULL) != 0) {
+        syslog(LOG_ERR, "Mutex init has failed in the telemetry file.");
+
+        free(pLog);
+        return NULL;
+    }
+
+    if ((pthread_cond_init(&pLog->condFull, NULL) != 0) ||
+        (pthread_cond_init(&pLog->condHousekeeping, NULL) != 0) ||
+        (pthread_cond_init(&pLog->condRetention, NULL) != 0) ||
+        (pthread_cond_init(&pLog->condDirect, NULL) != 0)) {
+        syslog(LOG_ERR, "Condition init has failed in the telemetry file.");
+
+        pthread_mutex_destroy(&pLog->lock);
+        free(pLog);
+        return NULL;
+    }
+
+    return pLog;
+}
+
+void logTlmHandle_free(logTlm_handle_t pLog) {
+    logTlmHandle_closeThread(pLog);
+    logTlmHandle_close(pLog);
+
+    // The retention thread is independent of the flush thread
+    logTlmHandle_setRetention(pLog, NULL);
+    logTlmHandle_freeBuffer(pLog);
+    logTlmHandle_setColumns(pLog, NULL, 0);
+
+    if (strlen(pLog->filename) != 0) {
+        free(pLog->filename);
+    }
+
+    free(pLog->filenameRetention);
+
+    // Destroy the mutex lock
+    if (pthread_mutex_destroy(&pLog->lock) != 0) {
+        syslog(LOG_ERR, "Mutex destroy has failed in the telemetry file.");
+        exit(1);
+    }
+
+    // Destroy the condition
+    if ((pthread_cond_destroy(&pLog->condFull) != 0) ||
+        (pthread_cond_destroy(&pLog->condHousekeeping) != 0) ||
+        (pthread_cond_destroy(&pLog->condRetention) != 0) ||
+        (pthread_cond_destroy(&pLog->condDirect) != 0)) {
+        syslog(LOG_ERR, "Condition destroy has failed in the telemetry file.");
+        exit(1);
+    }
+
+    free(pLog);
+}
+
+logTlm_handle_t logTlm_getDefaultHandle(void) { return &logTlmDefault; }
+
+int logTlmHandle_setBackend(logTlm_handle_t pLog, LogTlmBackend backend) {
+
+    if ((backend != LogTlmBackend_Stream) &&
+        (backend != LogTlmBackend_Direct) && (backend != LogTlmBackend_Mmap)) {
+        syslog(LOG_ERR, "Unknown backend of telemetry file: %d.", backend);
+        return -1;
+    }
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the backend when the telemetry file "
+                        "is opened.");
+        return -1;
+    }
+
+    if ((backend == LogTlmBackend_Mmap) &&
+        (pLog->format == LogTlmFormat_Container)) {
+        syslog(LOG_ERR, "The mmap backend does not support the container "
+                        "format of telemetry file.");
+        return -1;
+    }
+
+    pLog->backend = backend;
+
+    return 0;
+}
+
+int logTlmHandle_setFormat(logTlm_handle_t pLog, LogTlmFormat format,
+                           uint32_t schemaId) {
+
+    if ((format != LogTlmFormat_Raw) && (format != LogTlmFormat_Container)) {
+        syslog(LOG_ERR, "Unknown format of telemetry file: %d.", format);
+        return -1;
+    }
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the format when the telemetry file "
+                        "is opened.");
+        return -1;
+    }
+
+    if ((format == LogTlmFormat_Container) &&
+        (pLog->backend == LogTlmBackend_Mmap)) {
+        syslog(LOG_ERR, "The mmap backend does not support the container "
+                        "format of telemetry file.");
+        return -1;
+    }
+
+    pLog->format = format;
+    pLog->schemaId = schemaId;
+
+    // The raw format has no block to encode
+    if (format == LogTlmFormat_Raw) {
+        pLog->codec = LogTlmCodec_None;
+        logTlmHandle_setColumns(pLog, NULL, 0);
+    }
+
+    return 0;
+}
+
+int logTlmHandle_setCodec(logTlm_handle_t pLog, LogTlmCodec codec) {
+
+    if ((codec != LogTlmCodec_None) && (codec != LogTlmCodec_XorShuffle)) {
+        syslog(LOG_ERR, "Unknown codec of telemetry file: %d.", codec);
+        return -1;
+    }
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the codec when the telemetry file "
+                        "is opened.");
+        return -1;
+    }
+
+    if (pLog->format != LogTlmFormat_Container) {
+        syslog(LOG_ERR, "The codec needs the container format of telemetry "
+                        "file.");
+        return -1;
+    }
+
+    pLog->codec = codec;
+
+    return 0;
+}
+
+int logTlmHandle_setColumns(logTlm_handle_t pLog, const logTlmField_t *pFields,
+                            int numField) {
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the layout when the telemetry file "
+                        "is opened.");
+        return -1;
+    }
+
+    free(pLog->pFields);
+    pLog->pFields = NULL;
+
+    free(pLog->pSizeColumns);
+    pLog->pSizeColumns = NULL;
+
+    pLog->numField = 0;
+
+    // Row layout
+    if (numField <= 0) {
+        return 0;
+    }
+
+    if (pLog->format != LogTlmFormat_Container) {
+        syslog(LOG_ERR, "The columnar layout needs the container format of "
+                        "telemetry file.");
+        return -1;
+    }
+
+    pLog->pFields = (logTlmField_t *)calloc(numField, sizeof(logTlmField_t));
+    pLog->pSizeColumns = (uint32_t *)calloc(numField, sizeof(uint32_t));
+    if ((pLog->pFields == NULL) || (pLog->pSizeColumns == NULL)) {
+        syslog(LOG_ERR, "Failed to allocate the fields of telemetry file.");
+
+        logTlmHandle_setColumns(pLog, NULL, 0);
+        return -1;
+    }
+
+    memcpy(pLog->pFields, pFields, numField * sizeof(logTlmField_t));
+    pLog->numField = numField;
+
+    return 0;
+}
+
+int logTlmHandle_setRecordHeader(logTlm_handle_t pLog, bool isEnabled) {
+
+    if (pLog->ppBuffers != NULL) {
+        syslog(LOG_ERR, "Can not change the record header when the buffers "
+                        "of telemetry file are created.");
+        return -1;
+    }
+
+    pLog->sizeRecordHeader = isEnabled ? sizeof(logTlmRecordHeader_t) : 0;
+
+    return 0;
+}
+
+int logTlmHandle_setDurability(logTlm_handle_t pLog,
+                               LogTlmDurability durability, long threshold) {
+
+    if ((durability != LogTlmDurability_None) &&
+        (durability != LogTlmDurability_Bytes) &&
+        (durability != LogTlmDurability_Time) &&
+        (durability != LogTlmDurability_Rotation)) {
+        syslog(LOG_ERR, "Unknown durability policy of telemetry file: %d.",
+               durability);
+        return -1;
+    }
+
+    if (((durability == LogTlmDurability_Bytes) ||
+         (durability == LogTlmDurability_Time)) &&
+        (threshold <= 0)) {
+        syslog(LOG_ERR, "The threshold of durability policy should be > 0.");
+        return -1;
+    }
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the durability policy when the "
+                        "telemetry file is opened.");
+        return -1;
+    }
+
+    pLog->durability = durability;
+    pLog->thresholdDurability = threshold;
+
+    return 0;
+}
+
+// Free the memory of the min/max/mean decimation.
+static void logTlm_freeWindow(logTlm_handle_t pLog) {
+    free(pLog->pFieldsDecimation);
+    pLog->pFieldsDecimation = NULL;
+
+    rtMemory_free(pLog->pWindowValues);
+    pLog->pWindowValues = NULL;
+
+    rtMemory_free(pLog->pWindowRecords);
+    pLog->pWindowRecords = NULL;
+
+    pLog->numFieldDecimation = 0;
+    pLog->numValueWindow = 0;
+}
+
+// Allocate the pre-trigger ring if the decimation or trigger is used.
+// Otherwise, free it. The records in the ring are discarded.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_updateRing(logTlm_handle_t pLog) {
+
+    rtMemory_free(pLog->pRing);
+    pLog->pRing = NULL;
+
+    pLog->headRing = 0;
+    pLog->numRing = 0;
+    pLog->countDecimation = 0;
+    pLog->countPostTrigger = 0;
+
+    if ((pLog->decimation == LogTlmDecimation_None) &&
+        (pLog->trigger == NULL)) {
+        return 0;
+    }
+
+    pLog->pRing = (uint8_t *)rtMemory_alloc((pLog->numPreTrigger + 1) *
+                                            pLog->sizeElementInBuffer);
+    if (pLog->pRing == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the memory of pre-trigger ring "
+                        "of telemetry file.");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Clear the decimation and trigger.
+static void logTlm_clearCapture(logTlm_handle_t pLog) {
+    logTlm_freeWindow(pLog);
+
+    pLog->decimation = LogTlmDecimation_None;
+    pLog->trigger = NULL;
+    pLog->numPreTrigger = 0;
+    pLog->numPostTrigger = 0;
+
+    logTlm_updateRing(pLog);
+}
+
+int logTlmHandle_setDecimation(logTlm_handle_t pLog,
+                               LogTlmDecimation decimation, int factor,
+                               const logTlmField_t *pFields, int numField) {
+
+    if ((decimation != LogTlmDecimation_None) &&
+        (decimation != LogTlmDecimation_Sample) &&
+        (decimation != LogTlmDecimation_MinMaxMean)) {
+        syslog(LOG_ERR, "Unknown decimation of telemetry file: %d.",
+               decimation);
+        return -1;
+    }
+
+    if ((decimation != LogTlmDecimation_None) && (factor <= 0)) {
+        syslog(LOG_ERR, "The factor of decimation should be > 0.");
+        return -1;
+    }
+
+    if (pLog->ppBuffers == NULL) {
+        syslog(LOG_ERR, "The decimation needs the buffers of telemetry "
+                        "file.");
+        return -1;
+    }
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the decimation when the telemetry "
+                        "file is opened.");
+        return -1;
+    }
+
+    // The values of min/max/mean are the arrays of double in the record
+    int numValue = 0;
+    int idxField;
+    for (idxField = 0; (decimation == LogTlmDecimation_MinMaxMean) &&
+                       (idxField < numField);
+         idxField++) {
+        const logTlmField_t *pField = &pFields[idxField];
+        if ((pField->size == 0) || ((pField->size % sizeof(double)) != 0) ||
+            ((pField->offset + pField->size) > pLog->sizeElementInBuffer)) {
+            syslog(LOG_ERR, "The field %d of decimation is not an array of "
+                            "double in the telemetry record.",
+                   idxField);
+            return -1;
+        }
+
+        numValue += pField->size / sizeof(double);
+    }
+
+    if ((decimation == LogTlmDecimation_MinMaxMean) && (numValue == 0)) {
+        syslog(LOG_ERR, "The min/max/mean decimation needs the fields.");
+        return -1;
+    }
+
+    logTlm_freeWindow(pLog);
+    pLog->decimation = LogTlmDecimation_None;
+
+    if (decimation == LogTlmDecimation_MinMaxMean) {
+        pLog->pFieldsDecimation =
+            (logTlmField_t *)calloc(numField, sizeof(logTlmField_t));
+        pLog->pWindowValues =
+            (double *)rtMemory_alloc(3 * numValue * sizeof(double));
+        pLog->pWindowRecords =
+            (uint8_t *)rtMemory_alloc(2 * pLog->sizeElementInBuffer);
+        if ((pLog->pFieldsDecimation == NULL) ||
+            (pLog->pWindowValues == NULL) || (pLog->pWindowRecords == NULL)) {
+            syslog(LOG_ERR, "Failed to allocate the memory of decimation of "
+                            "telemetry file.");
+
+            logTlm_freeWindow(pLog);
+            logTlm_updateRing(pLog);
+            return -1;
+        }
+
+        memcpy(pLog->pFieldsDecimation, pFields,
+               numField * sizeof(logTlmField_t));
+        pLog->numFieldDecimation = numField;
+        pLog->numValueWindow = numValue;
+    }
+
+    pLog->decimation = decimation;
+    pLog->factorDecimation = factor;
+
+    if (logTlm_updateRing(pLog) != 0) {
+        logTlm_freeWindow(pLog);
+        pLog->decimation = LogTlmDecimation_None;
+        return -1;
+    }
+
+    return 0;
+}
+
+int logTlmHandle_setTrigger(logTlm_handle_t pLog, logTlmTrigger_t trigger,
+                            void *pUser, int numPreTrigger,
+                            int numPostTrigger) {
+
+    if ((numPreTrigger < 0) || (numPostTrigger < 0)) {
+        syslog(LOG_ERR, "The number of records around the trigger should be "
+                        ">= 0.");
+        return -1;
+    }
+
+    if (pLog->ppBuffers == NULL) {
+        syslog(LOG_ERR, "The trigger needs the buffers of telemetry file.");
+        return -1;
+    }
+
+    if (logTlm_isFileOpen(&pLog->file)) {
+        syslog(LOG_ERR, "Can not change the trigger when the telemetry file "
+                        "is opened.");
+        return -1;
+    }
+
+    pLog->trigger = trigger;
+    pLog->pUserTrigger = pUser;
+    pLog->numPreTrigger = (trigger == NULL) ? 0 : numPreTrigger;
+    pLog->numPostTrigger = numPostTrigger;
+
+    if (logTlm_updateRing(pLog) != 0) {
+        pLog->trigger = NULL;
+        pLog->numPreTrigger = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+char *logTlmHandle_getFilename(logTlm_handle_t pLog) { return pLog->filename; }
+
+void *logTlmHandle_getBuffer(logTlm_handle_t pLog, int id) {
+    if (id == 0) {
+        return pLog->pBufferCurrent;
+    } else if ((id >= 1) && (id <= pLog->numBuffer) &&
+               (pLog->ppBuffers != NULL)) {
+        return pLog->ppBuffers[id - 1];
+    } else {
+        return NULL;
+    }
+}
+
+// Add the buffer ID to the end of list.
+static void logTlm_pushList(logTlmBufferList_t *pList, int id) {
+    pList->pIds[(pList->head + pList->num) % pList->max] = id;
+    pList->num += 1;
+}
+
+// Remove the first buffer ID in the list.
+// Return the ID. Otherwise, 0 if the list is empty.
+static int logTlm_popList(logTlmBufferList_t *pList) {
+    if (pList->num == 0) {
+        return 0;
+    }
+
+    int id = pList->pIds[pList->head];
+    pList->head = (pList->head + 1) % pList->max;
+    pList->num -= 1;
+
+    return id;
+}
+
+// Free the buffers and lists, and set to NULL.
+static void logTlm_freeBufferAll(logTlm_handle_t pLog) {
+
+    int idx;
+    for (idx = 0; (pLog->ppBuffers != NULL) && (idx < pLog->numBuffer); idx++) {
+        rtMemory_free(pLog->ppBuffers[idx]);
+    }
+
+    free(pLog->ppBuffers);
+    pLog->ppBuffers = NULL;
+
+    free(pLog->pCountsWriting);
+    pLog->pCountsWriting = NULL;
+
+    free(pLog->listFree.pIds);
+    pLog->listFree.pIds = NULL;
+
+    free(pLog->listFull.pIds);
+    pLog->listFull.pIds = NULL;
+
+    free(pLog->pTimeRanges);
+    pLog->pTimeRanges = NULL;
+
+    rtMemory_free(pLog->pEncoded);
+    pLog->pEncoded = NULL;
+
+    rtMemory_free(pLog->pColumn);
+    pLog->pColumn = NULL;
+
+    pLog->numBuffer = 0;
+}
+
+void logTlmHandle_freeBuffer(logTlm_handle_t pLog) {
+
+    // Free the buffer
+    logTlm_freeBufferAll(pLog);
+    logTlm_clearCapture(pLog);
+
+    pLog->pBufferCurrent = NULL;
+}
+
+// Create the single buffer by rtMemory_allocAligned(), so the buffer is
+// pre-faulted and locked in the RtMemoryPolicy_Locked. The buffer is aligned
+// and sized to the block, so the direct backend can write it without the copy.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_createBufferSingle(void **ppBuffer, int sizeBuffer,
+                                     size_t sizeElement, int id) {
+    size_t size = (sizeBuffer * sizeElement + LOGTLM_BLOCK_SIZE - 1) /
+                  LOGTLM_BLOCK_SIZE * LOGTLM_BLOCK_SIZE;
+    *ppBuffer = rtMemory_allocAligned(size, LOGTLM_BLOCK_SIZE);
+    if (*ppBuffer == NULL) {
+        syslog(LOG_ERR,
+               "Failed to allocate the memory of buffer %d of telemetry file.",
+               id);
+        return -1;
+    }
+
+    return 0;
+}
+
+int logTlmHandle_createBuffer(logTlm_handle_t pLog, int sizeBuffer,
+                              size_t sizeElement) {
+    return logTlmHandle_createBufferPool(pLog, 2, sizeBuffer, sizeElement);
+}
+
+int logTlmHandle_createBufferPool(logTlm_handle_t pLog, int num,
+                                  int sizeBuffer, size_t sizeElement) {
+    if ((num <= 0) || (sizeBuffer <= 0) || (sizeElement <= 0)) {
+        syslog(LOG_ERR, "The number of buffers and buffer/element size should "
+                        "be > 0.");
+        return -1;
+    }
+
+    // The record header is stored before the data
+    sizeElement += pLog->sizeRecordHeader;
+
+    // Allocate the memory
+    pLog->numBuffer = num;
+    pLog->ppBuffers = (void **)calloc(num, sizeof(void *));
+    pLog->pCountsWriting = (int *)calloc(num, sizeof(int));
+    pLog->listFree.pIds = (int *)calloc(num, sizeof(int));
+    pLog->listFull.pIds = (int *)calloc(num, sizeof(int));
+    pLog->pTimeRanges =
+        (logTlmTimeRange_t *)calloc(num, sizeof(logTlmTimeRange_t));
+    pLog->pEncoded = rtMemory_alloc(sizeBuffer * sizeElement);
+    pLog->pColumn = rtMemory_alloc(sizeBuffer * sizeElement);
+    pLog->listFree.max = num;
+    pLog->listFull.max = num;
+
+    int status = 0;
+    if ((pLog->ppBuffers == NULL) || (pLog->pCountsWriting == NULL) ||
+        (pLog->listFree.pIds == NULL) || (pLog->listFull.pIds == NULL) ||
+        (pLog->pTimeRanges == NULL) || (pLog->pEncoded == NULL) ||
+        (pLog->pColumn == NULL)) {
+        syslog(LOG_ERR, "Failed to allocate the memory of buffer pool of "
+                        "telemetry file.");
+        status = -1;
+    }
+
+    int idx;
+    for (idx = 0; (status == 0) && (idx < num); idx++) {
+        status = logTlm_createBufferSingle(&pLog->ppBuffers[idx], sizeBuffer,
+                                           sizeElement, idx + 1);
+    }
+
+    // Free the allocated buffers if failed to allocate the memory
+    if (status == -1) {
+        logTlm_freeBufferAll(pLog);
+        return -1;
+    }
+
+    // Update the internal data
+    pLog->countBufferMax = sizeBuffer;
+    pLog->sizeElementInBuffer = sizeElement;
+
+    pLog->numBufferFullMax = 0;
+    pLog->numRecordDropped = 0;
+
+    pLog->sequence = 0;
+    pLog->isGap = false;
+
+    logTlm_clearCapture(pLog);
+    pLog->numTrigger = 0;
+
+    pLog->numSync = 0;
+    pLog->numSyncFailed = 0;
+    pLog->timeSyncTotalNs = 0;
+    pLog->timeSyncMaxNs = 0;
+
+    return 0;
+}
+
+// Hold the mutex lock.
+static inline void logTlm_lock(logTlm_handle_t pLog) {
+    if (pthread_mutex_lock(&pLog->lock) != 0) {
+        syslog(LOG_ERR, "Mutex lock has failed in the telemetry file.");
+        exit(1);
+    }
+}
+
+// Release the mutex lock.
+static inline void logTlm_unlock(logTlm_handle_t pLog) {
+    if (pthread_mutex_unlock(&pLog->lock) != 0) {
+        syslog(LOG_ERR, "Mutex unlock has failed in the telemetry file.");
+        exit(1);
+    }
+}
+
+// Get the current time in nanoseconds since the epoch.
+static inline int64_t logTlm_getTimeNs(void) {
+    struct timespec timeCurrent;
+    clock_gettime(CLOCK_REALTIME, &timeCurrent);
+
+    return (int64_t)timeCurrent.tv_sec * 1000000000 + timeCurrent.tv_nsec;
+}
+
+// Get the monotonic time in nanoseconds.
+static inline int64_t logTlm_getTimeMonotonicNs(void) {
+    struct timespec timeCurrent;
+    clock_gettime(CLOCK_MONOTONIC, &timeCurrent);
+
+    return (int64_t)timeCurrent.tv_sec * 1000000000 + timeCurrent.tv_nsec;
+}
+
+// Wait until the data of file is on the disk by fdatasync() and record the
+// latency in the statistics.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_syncData(logTlm_handle_t pLog, int fd) {
+
+    int64_t timeStartNs = logTlm_getTimeMonotonicNs();
+    int status = fdatasync(fd);
+    int64_t timeSyncNs = logTlm_getTimeMonotonicNs() - timeStartNs;
+
+    logTlm_lock(pLog);
+
+    if (status == 0) {
+        pLog->numSync += 1;
+        pLog->timeSyncTotalNs += timeSyncNs;
+        if (timeSyncNs > pLog->timeSyncMaxNs) {
+            pLog->timeSyncMaxNs = timeSyncNs;
+        }
+    } else {
+        pLog->numSyncFailed += 1;
+    }
+
+    logTlm_unlock(pLog);
+
+    if (status != 0) {
+        syslog(LOG_ERR, "Failed to synchronize the telemetry file to the "
+                        "disk.");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Update the offset of the TAI time from the monotonic clock. This is called
+// out of logTlm_write() so the time of record header is from the monotonic
+// clock only, which is read without the system call by vDSO.
+static void logTlm_updateTimeOffsetTai(logTlm_handle_t pLog) {
+    if (pLog->sizeRecordHeader == 0) {
+        return;
+    }
+
+    struct timespec timeTai, timeMonotonic;
+    clock_gettime(CLOCK_MONOTONIC, &timeMonotonic);
+    clock_gettime(CLOCK_TAI, &timeTai);
+
+    int64_t offset =
+        ((int64_t)timeTai.tv_sec - timeMonotonic.tv_sec) * 1000000000 +
+        (timeTai.tv_nsec - timeMonotonic.tv_nsec);
+    __atomic_store_n(&pLog->timeOffsetTaiNs, offset, __ATOMIC_RELAXED);
+}
+
+// Get the TAI time in nanoseconds since the epoch for the record header.
+static inline int64_t logTlm_getTimeTaiNs(logTlm_handle_t pLog) {
+    struct timespec timeCurrent;
+    clock_gettime(CLOCK_MONOTONIC, &timeCurrent);
+
+    return (int64_t)timeCurrent.tv_sec * 1000000000 + timeCurrent.tv_nsec +
+           __atomic_load_n(&pLog->timeOffsetTaiNs, __ATOMIC_RELAXED);
+}
+
+// The writes of direct backend are queued to the direct I/O thread or not.
+static inline bool logTlm_isWriteQueued(logTlm_handle_t pLog) {
+    return (pLog->backend == LogTlmBackend_Direct) && pLog->isDirectReady;
+}
+
+// Write all the data of vector to the file by pwritev(), which continues after
+// the partial writing.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_writeVector(int fd, struct iovec *pIovs, int num,
+                              off_t offset) {
+
+    while (num > 0) {
+        ssize_t sizeWritten = pwritev(fd, pIovs, num, offset);
+        if (sizeWritten <= 0) {
+            return -1;
+        }
+
+        offset += sizeWritten;
+
+        // Skip the written data
+        while ((num > 0) && ((size_t)sizeWritten >= pIovs->iov_len)) {
+            sizeWritten -= pIovs->iov_len;
+            pIovs++;
+            num--;
+        }
+
+        if (num > 0) {
+            pIovs->iov_base = (uint8_t *)pIovs->iov_base + sizeWritten;
+            pIovs->iov_len -= sizeWritten;
+        }
+    }
+
+    return 0;
+}
+
+// Queue the write of aligned data or the fdatasync() ("pData" is NULL) of
+// direct backend to the direct I/O thread. It waits if the queue is full.
+// Without the thread, the data is written here.
+// Return the count of queued writes including this one, or 0 if written here.
+// Otherwise, -1.
+static long logTlm_queueWriteDirect(logTlm_handle_t pLog, int fd,
+                                    uint8_t *pData, size_t size, off_t offset,
+                                    int idBuffer) {
+
+    if (!logTlm_isWriteQueued(pLog)) {
+        struct iovec iov = {pData, size};
+        return (pData == NULL) ? logTlm_syncData(pLog, fd)
+                               : logTlm_writeVector(fd, &iov, 1, offset);
+    }
+
+    logTlm_lock(pLog);
+
+    while (pLog->numWriteDirect == LOGTLM_NUM_WRITE_DIRECT) {
+        pthread_cond_wait(&pLog->condDirect, &pLog->lock);
+    }
+
+    long count = -1;
+    if (!pLog->isWriteDirectFailed) {
+        int idx = (pLog->headWriteDirect + pLog->numWriteDirect) %
+                  LOGTLM_NUM_WRITE_DIRECT;
+        logTlmWriteDirect_t *pWrite = &pLog->writesDirect[idx];
+        pWrite->fd = fd;
+        pWrite->pData = pData;
+        pWrite->size = size;
+        pWrite->offset = offset;
+        pWrite->idBuffer = idBuffer;
+
+        if (idBuffer > 0) {
+            pLog->pCountsWriting[idBuffer - 1] += 1;
+        }
+
+        pLog->numWriteDirect += 1;
+        pLog->countWriteQueued += 1;
+        count = pLog->countWriteQueued;
+
+        pthread_cond_broadcast(&pLog->condDirect);
+    }
+
+    logTlm_unlock(pLog);
+
+    return count;
+}
+
+// Wait until the direct I/O thread has done the writes up to the "count"-th
+// one. The negative "count" means all the queued writes.
+// Return 0 if success. Otherwise, -1 if a queued write failed.
+static int logTlm_waitWriteDirect(logTlm_handle_t pLog, long count) {
+
+    logTlm_lock(pLog);
+
+    if (count < 0) {
+        count = pLog->countWriteQueued;
+    }
+
+    while (pLog->countWriteDone < count) {
+        pthread_cond_wait(&pLog->condDirect, &pLog->lock);
+    }
+
+    int status = pLog->isWriteDirectFailed ? -1 : 0;
+
+    logTlm_unlock(pLog);
+
+    return status;
+}
+
+// Release the buffer after the flush or a queued write of it. The buffer is
+// free when nothing uses it, or re-assigned as the current buffer if
+// logTlmHandle_write(pLog) found all the buffers were full.
+// Requires: hold the mutex lock
+static void logTlm_releaseBuffer(logTlm_handle_t pLog, int id) {
+
+    pLog->pCountsWriting[id - 1] -= 1;
+    if (pLog->pCountsWriting[id - 1] > 0) {
+        return;
+    }
+
+    if (pLog->pBufferCurrent == NULL) {
+        pLog->pBufferCurrent = pLog->ppBuffers[id - 1];
+        pLog->countBufferCurrent = 0;
+    } else {
+        logTlm_pushList(&pLog->listFree, id);
+    }
+}
+
+// Run the direct I/O thread. The queued writes are done in order and the
+// contiguous ones of a file are merged into one pwritev().
+static void *logTlm_runDirect(void *pData) {
+
+    logTlm_handle_t pLog = (logTlm_handle_t)pData;
+
+    struct iovec iovs[LOGTLM_NUM_WRITE_DIRECT];
+
+    // Finish the queued writes before closing the thread
+    logTlm_lock(pLog);
+    while (pLog->isDirectReady || (pLog->numWriteDirect > 0)) {
+
+        if (pLog->numWriteDirect == 0) {
+            pthread_cond_wait(&pLog->condDirect, &pLog->lock);
+            continue;
+        }
+
+        // The queued writes are not changed until they are done
+        logTlmWriteDirect_t *pFirst =
+            &pLog->writesDirect[pLog->headWriteDirect];
+        off_t offsetNext = pFirst->offset;
+        int num = 0;
+        while (num < pLog->numWriteDirect) {
+            logTlmWriteDirect_t *pWrite =
+                &pLog->writesDirect[(pLog->headWriteDirect + num) %
+                                    LOGTLM_NUM_WRITE_DIRECT];
+            if ((pWrite->pData == NULL) || (pWrite->fd != pFirst->fd) ||
+                (pWrite->offset != offsetNext)) {
+                break;
+            }
+
+            iovs[num].iov_base = pWrite->pData;
+            iovs[num].iov_len = pWrite->size;
+            offsetNext += pWrite->size;
+            num++;
+        }
+
+        logTlm_unlock(pLog);
+
+        int status = 0;
+        if (num == 0) {
+            num = 1;
+            logTlm_syncData(pLog, pFirst->fd);
+        } else {
+            status = logTlm_writeVector(pFirst->fd, iovs, num, pFirst->offset);
+        }
+
+        logTlm_lock(pLog);
+
+        if (status != 0) {
+            pLog->isWriteDirectFailed = true;
+            syslog(LOG_ERR, "Failed to write the data to telemetry file in "
+                            "the direct I/O thread.");
+        }
+
+        int idx;
+        for (idx = 0; idx < num; idx++) {
+            int idBuffer = pLog->writesDirect[pLog->headWriteDirect].idBuffer;
+            if (idBuffer > 0) {
+                logTlm_releaseBuffer(pLog, idBuffer);
+            }
+
+            pLog->headWriteDirect =
+                (pLog->headWriteDirect + 1) % LOGTLM_NUM_WRITE_DIRECT;
+        }
+
+        pLog->numWriteDirect -= num;
+        pLog->countWriteDone += num;
+        pthread_cond_broadcast(&pLog->condDirect);
+    }
+    logTlm_unlock(pLog);
+
+    return 0;
+}
+
+// Get the active half of the staging buffer of direct backend.
+static inline uint8_t *logTlm_getStaging(logTlmFile_t *pFileTlm) {
+    return pFileTlm->pDirect + pFileTlm->idxDirect * pFileTlm->sizeDirect;
+}
+
+// Write the whole blocks in the active half of the staging buffer, and move
+// the tail to the other half, which waits for its last write if queued.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_submitStaging(logTlm_handle_t pLog,
+                                logTlmFile_t *pFileTlm) {
+
+    size_t sizeBlocks =
+        (pFileTlm->numDirect / LOGTLM_BLOCK_SIZE) * LOGTLM_BLOCK_SIZE;
+    if (sizeBlocks == 0) {
+        return 0;
+    }
+
+    int idxOther = 1 - pFileTlm->idxDirect;
+    if (logTlm_waitWriteDirect(pLog, pFileTlm->countsDirect[idxOther]) != 0) {
+        return -1;
+    }
+
+    uint8_t *pStaging = logTlm_getStaging(pFileTlm);
+    long count = logTlm_queueWriteDirect(pLog, pFileTlm->fd, pStaging,
+                                         sizeBlocks, pFileTlm->offsetDirect, 0);
+    if (count < 0) {
+        return -1;
+    }
+
+    pFileTlm->countsDirect[pFileTlm->idxDirect] = count;
+
+    memcpy(pFileTlm->pDirect + idxOther * pFileTlm->sizeDirect,
+           pStaging + sizeBlocks, pFileTlm->numDirect - sizeBlocks);
+
+    pFileTlm->idxDirect = idxOther;
+    pFileTlm->offsetDirect += sizeBlocks;
+    pFileTlm->numDirect -= sizeBlocks;
+
+    return 0;
+}
+
+// Write the data to the file of direct backend. The whole blocks of buffer
+// "idBuffer" are written without the copy if the buffer and file offset are
+// aligned. Otherwise, the data is copied to the staging buffer, which is
+// written when a half is full or by logTlm_submitStaging().
+// Return 0 if success. Otherwise, -1.
+static int logTlm_writeDirect(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                              uint8_t *pData, size_t size, int idBuffer) {
+
+    size_t sizeBlocks = (size / LOGTLM_BLOCK_SIZE) * LOGTLM_BLOCK_SIZE;
+    if ((idBuffer > 0) && (sizeBlocks > 0) &&
+        (((uintptr_t)pData % LOGTLM_BLOCK_SIZE) == 0) &&
+        ((pFileTlm->numDirect % LOGTLM_BLOCK_SIZE) == 0)) {
+        if ((logTlm_submitStaging(pLog, pFileTlm) != 0) ||
+            (logTlm_queueWriteDirect(pLog, pFileTlm->fd, pData, sizeBlocks,
+                                     pFileTlm->offsetDirect, idBuffer) < 0)) {
+            return -1;
+        }
+
+        pFileTlm->offsetDirect += sizeBlocks;
+        pData += sizeBlocks;
+        size -= sizeBlocks;
+    }
+
+    while (size > 0) {
+        size_t sizeCopy = pFileTlm->sizeDirect - pFileTlm->numDirect;
+        if (sizeCopy > size) {
+            sizeCopy = size;
+        }
+
+        memcpy(logTlm_getStaging(pFileTlm) + pFileTlm->numDirect, pData,
+               sizeCopy);
+        pFileTlm->numDirect += sizeCopy;
+
+        pData += sizeCopy;
+        size -= sizeCopy;
+
+        if ((pFileTlm->numDirect == pFileTlm->sizeDirect) &&
+            (logTlm_submitStaging(pLog, pFileTlm) != 0)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Write the bytes to the file of stream or direct backend. The "idBuffer" is
+// the ID of buffer that "pData" is in, which the direct backend might write
+// without the copy. 0 if the data is not in a buffer.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_writeBytes(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                             void *pData, size_t size, int idBuffer) {
+
+    if (size == 0) {
+        return 0;
+    }
+
+    int status = 0;
+    if (pLog->backend == LogTlmBackend_Direct) {
+        status = logTlm_writeDirect(pLog, pFileTlm, (uint8_t *)pData, size,
+                                    idBuffer);
+    } else if (fwrite(pData, size, 1, pFileTlm->pFile) <= 0) {
+        status = -1;
+    }
+
+    if (status == 0) {
+        pFileTlm->sizeWritten += size;
+    }
+
+    return status;
+}
+
+// Write the header of container file.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_writeFileHeader(logTlm_handle_t pLog,
+                                  logTlmFile_t *pFileTlm) {
+
+    logTlmFileHeader_t header;
+    memset(&header, 0, sizeof(header));
+
+    strncpy(header.magic, LOGTLM_FILE_MAGIC, sizeof(header.magic));
+    header.version = LOGTLM_FILE_VERSION;
+    header.sizeElement = pLog->sizeElementInBuffer;
+    header.schemaId = pLog->schemaId;
+    header.recordPerBlock = pLog->countBufferMax;
+    header.codec = pLog->codec;
+    header.numField = pLog->numField;
+    if (pLog->sizeRecordHeader > 0) {
+        header.flags = LOGTLM_FLAG_RECORD_HEADER;
+        header.timeStartNs = logTlm_getTimeTaiNs(pLog);
+    } else {
+        header.timeStartNs = logTlm_getTimeNs();
+    }
+
+    if (logTlm_writeBytes(pLog, pFileTlm, &header, sizeof(header), 0) != 0) {
+        return -1;
+    }
+
+    return logTlm_writeBytes(pLog, pFileTlm, pLog->pFields,
+                             pLog->numField * sizeof(logTlmField_t), 0);
+}
+
+// Write the header of a block and add the block to the index.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_writeBlockHeader(logTlm_handle_t pLog,
+                                   logTlmFile_t *pFileTlm, int numRecord,
+                                   size_t sizeData,
+                                   logTlmTimeRange_t *pTimeRange) {
+
+    // Double the capacity of index if needed
+    if (pFileTlm->numIndex == pFileTlm->maxIndex) {
+        int maxIndex = (pFileTlm->maxIndex == 0) ? 64 : 2 * pFileTlm->maxIndex;
+        logTlmIndexEntry_t *pIndex = (logTlmIndexEntry_t *)realloc(
+            pFileTlm->pIndex, maxIndex * sizeof(logTlmIndexEntry_t));
+        if (pIndex == NULL) {
+            syslog(LOG_ERR, "Failed to allocate the index of telemetry file.");
+            return -1;
+        }
+
+        pFileTlm->pIndex = pIndex;
+        pFileTlm->maxIndex = maxIndex;
+    }
+
+    logTlmIndexEntry_t *pEntry = &pFileTlm->pIndex[pFileTlm->numIndex];
+    memset(pEntry, 0, sizeof(logTlmIndexEntry_t));
+
+    pEntry->offset = pFileTlm->sizeWritten;
+    pEntry->timeMinNs = pTimeRange->timeMinNs;
+    pEntry->timeMaxNs = pTimeRange->timeMaxNs;
+    pEntry->numRecord = numRecord;
+
+    pFileTlm->numIndex += 1;
+
+    logTlmBlockHeader_t header;
+    memset(&header, 0, sizeof(header));
+
+    header.numRecord = numRecord;
+    header.sizeData = sizeData;
+    header.timeMinNs = pTimeRange->timeMinNs;
+    header.timeMaxNs = pTimeRange->timeMaxNs;
+
+    return logTlm_writeBytes(pLog, pFileTlm, &header, sizeof(header), 0);
+}
+
+// Write the index and footer at the end of container file.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_writeIndex(logTlm_handle_t pLog, logTlmFile_t *pFileTlm) {
+
+    logTlmFileFooter_t footer;
+    memset(&footer, 0, sizeof(footer));
+
+    strncpy(footer.magic, LOGTLM_INDEX_MAGIC, sizeof(footer.magic));
+    footer.numBlock = pFileTlm->numIndex;
+    footer.offsetIndex = pFileTlm->sizeWritten;
+
+    if (logTlm_writeBytes(pLog, pFileTlm, pFileTlm->pIndex,
+                          pFileTlm->numIndex * sizeof(logTlmIndexEntry_t),
+                          0) != 0) {
+        return -1;
+    }
+
+    return logTlm_writeBytes(pLog, pFileTlm, &footer, sizeof(footer), 0);
+}
+
+// Open the file of mmap backend. The file is preallocated to hold
+// "countFileMax" records and mapped as a whole.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_openMap(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                          char *filename) {
+
+    pFileTlm->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (pFileTlm->fd == -1) {
+        return -1;
+    }
+
+    size_t sizeMap = pLog->countFileMax * pLog->sizeElementInBuffer;
+    pFileTlm->pMap = MAP_FAILED;
+    if ((sizeMap > 0) && (posix_fallocate(pFileTlm->fd, 0, sizeMap) == 0)) {
+        pFileTlm->pMap = mmap(NULL, sizeMap, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, pFileTlm->fd, 0);
+    }
+
+    if (pFileTlm->pMap == MAP_FAILED) {
+        syslog(LOG_ERR, "Failed to preallocate and map the telemetry file.");
+
+        close(pFileTlm->fd);
+        logTlm_resetFile(pFileTlm);
+
+        return -1;
+    }
+
+    pFileTlm->sizeMap = sizeMap;
+    pFileTlm->countFileSynced = 0;
+
+    return 0;
+}
+
+// Close the file of mmap backend. The file is truncated to "sizeFile" bytes
+// to remove the preallocated space that is not written. The file is
+// synchronized to the disk if "isSync" is true.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_closeMap(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                           off_t sizeFile, bool isSync) {
+
+    int status = 0;
+    if (munmap(pFileTlm->pMap, pFileTlm->sizeMap) != 0) {
+        status = -1;
+    }
+
+    if (ftruncate(pFileTlm->fd, sizeFile) != 0) {
+        status = -1;
+    }
+
+    // The dirty pages of mapping are still in the page cache of file
+    if (isSync && (logTlm_syncData(pLog, pFileTlm->fd) != 0)) {
+        status = -1;
+    }
+
+    if (close(pFileTlm->fd) != 0) {
+        status = -1;
+    }
+
+    return status;
+}
+
+// Open the file of direct backend with the aligned staging buffer.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_openDirect(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                             char *filename) {
+
+    // Each half of the staging buffer holds a whole buffer plus the tail of
+    // last writing
+    size_t sizeBuffer = pLog->countBufferMax * pLog->sizeElementInBuffer;
+    size_t sizeDirect =
+        (sizeBuffer / LOGTLM_BLOCK_SIZE + 2) * LOGTLM_BLOCK_SIZE;
+    void *pDirect = NULL;
+    if (posix_memalign(&pDirect, LOGTLM_BLOCK_SIZE, 2 * sizeDirect) != 0) {
+        syslog(LOG_ERR, "Failed to allocate the aligned staging buffer of "
+                        "telemetry file.");
+
+        return -1;
+    }
+
+    pFileTlm->pDirect = (uint8_t *)pDirect;
+    pFileTlm->sizeDirect = sizeDirect;
+    pFileTlm->numDirect = 0;
+    pFileTlm->idxDirect = 0;
+    pFileTlm->countsDirect[0] = 0;
+    pFileTlm->countsDirect[1] = 0;
+    pFileTlm->offsetDirect = 0;
+
+    // Some file systems such as tmpfs do not support the direct I/O. Use the
+    // page cache in this case.
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    pFileTlm->fd = open(filename, flags | O_DIRECT, 0644);
+    if ((pFileTlm->fd == -1) && (errno == EINVAL)) {
+        syslog(LOG_WARNING, "No direct I/O for the telemetry file. Use the "
+                            "page cache instead.");
+
+        pFileTlm->fd = open(filename, flags, 0644);
+    }
+
+    if (pFileTlm->fd == -1) {
+        free(pFileTlm->pDirect);
+        logTlm_resetFile(pFileTlm);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+// Close the file of direct backend. The queued writes are waited for, and the
+// data in the staging buffer is written as whole blocks and the padding is
+// truncated. The file is synchronized to the disk if "isSync" is true.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_closeDirect(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                              bool isSync) {
+
+    int status = logTlm_waitWriteDirect(pLog, -1);
+    if (pFileTlm->numDirect > 0) {
+        uint8_t *pStaging = logTlm_getStaging(pFileTlm);
+        size_t sizeBlocks =
+            (pFileTlm->numDirect + LOGTLM_BLOCK_SIZE - 1) / LOGTLM_BLOCK_SIZE *
+            LOGTLM_BLOCK_SIZE;
+        memset(pStaging + pFileTlm->numDirect, 0,
+               sizeBlocks - pFileTlm->numDirect);
+
+        struct iovec iov = {pStaging, sizeBlocks};
+        off_t sizeFile = pFileTlm->offsetDirect + pFileTlm->numDirect;
+        if ((logTlm_writeVector(pFileTlm->fd, &iov, 1,
+                                pFileTlm->offsetDirect) != 0) ||
+            (ftruncate(pFileTlm->fd, sizeFile) != 0)) {
+            status = -1;
+        }
+    }
+
+    if (isSync && (logTlm_syncData(pLog, pFileTlm->fd) != 0)) {
+        status = -1;
+    }
+
+    if (close(pFileTlm->fd) != 0) {
+        status = -1;
+    }
+
+    free(pFileTlm->pDirect);
+
+    return status;
+}
+
+// Close the file with the backend. The "sizeFile" in bytes is used by the
+// mmap backend only. The file is synchronized to the disk before the closing
+// if "isSync" is true.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_closeFile(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                            off_t sizeFile, bool isSync) {
+
+    int status = 0;
+    if ((pLog->format == LogTlmFormat_Container) &&
+        (pLog->backend != LogTlmBackend_Mmap) && logTlm_isFileOpen(pFileTlm)) {
+        status = logTlm_writeIndex(pLog, pFileTlm);
+    }
+
+    free(pFileTlm->pIndex);
+
+    if (pFileTlm->pFile != NULL) {
+        if (isSync &&
+            ((fflush(pFileTlm->pFile) != 0) ||
+             (logTlm_syncData(pLog, fileno(pFileTlm->pFile)) != 0))) {
+            status = -1;
+        }
+
+        status |= fclose(pFileTlm->pFile);
+    } else if (pFileTlm->fd != -1) {
+        status |= (pLog->backend == LogTlmBackend_Mmap)
+                      ? logTlm_closeMap(pLog, pFileTlm, sizeFile, isSync)
+                      : logTlm_closeDirect(pLog, pFileTlm, isSync);
+    }
+
+    logTlm_resetFile(pFileTlm);
+
+    return status;
+}
+
+// Open the file with the backend. The disk space of a whole file is reserved
+// if the file system supports it, so the writing does not allocate blocks.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_openFile(logTlm_handle_t pLog, logTlmFile_t *pFileTlm,
+                           char *filename) {
+
+    if (pLog->backend == LogTlmBackend_Mmap) {
+        return logTlm_openMap(pLog, pFileTlm, filename);
+    }
+
+    int fd = -1;
+    if (pLog->backend == LogTlmBackend_Stream) {
+        pFileTlm->pFile = fopen(filename, "w");
+        if (pFileTlm->pFile == NULL) {
+            return -1;
+        }
+
+        fd = fileno(pFileTlm->pFile);
+    } else {
+        if (logTlm_openDirect(pLog, pFileTlm, filename) != 0) {
+            return -1;
+        }
+
+        fd = pFileTlm->fd;
+    }
+
+    // The size of file is not changed. Ignore the failure because this is
+    // only an optimization.
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0,
+              pLog->countFileMax * pLog->sizeElementInBuffer);
+
+    if ((pLog->format == LogTlmFormat_Container) &&
+        (logTlm_writeFileHeader(pLog, pFileTlm) != 0)) {
+        syslog(LOG_ERR, "Failed to write the header of telemetry file.");
+
+        logTlm_closeFile(pLog, pFileTlm, 0, false);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Get the filename of the next file. The user needs to free the memory.
+static char *logTlm_getNextFilename(logTlm_handle_t pLog) {
+    return joinStr(pLog->filename, ".next");
+}
+
+// Wait until the job of housekeeping thread is done.
+// Requires: hold the mutex lock
+static void logTlm_waitHousekeeping(logTlm_handle_t pLog) {
+    while (pLog->isHousekeepingPending) {
+        pthread_cond_wait(&pLog->condHousekeeping, &pLog->lock);
+    }
+}
+
+// Wait until the pending and queued fdatasync() are done, so the file is not
+// closed before them.
+// Requires: hold the mutex lock
+static void logTlm_waitSync(logTlm_handle_t pLog) {
+    while (pLog->isSyncPending) {
+        pthread_cond_wait(&pLog->condHousekeeping, &pLog->lock);
+    }
+}
+
+// Get the rotated file name with the ID. The user needs to free the output
+// memory if it is not needed anymore.
+static char *logTlm_getRotatedFilename(logTlm_handle_t pLog, int id) {
+    char extension[100];
+    sprintf(extension, ".%d", id);
+
+    return joinStr(pLog->filename, extension);
+}
+
+// Let the retention thread check the rotated files up to "id".
+static void logTlm_notifyRetention(logTlm_handle_t pLog, int id) {
+    logTlm_lock(pLog);
+
+    pLog->idRetentionNewest = id;
+    pLog->isRetentionPending = true;
+    pthread_cond_signal(&pLog->condRetention);
+
+    logTlm_unlock(pLog);
+}
+
+// Close and rename the old file. The current file was the next file before
+// the rotation and is renamed to the file name.
+static void logTlm_closeOldFile(logTlm_handle_t pLog, char *filenameNext) {
+
+    off_t sizeFile = pLog->countFileMax * pLog->sizeElementInBuffer;
+    if (logTlm_closeFile(pLog, &pLog->fileOld, sizeFile,
+                         logTlm_isDurable(pLog)) != 0) {
+        syslog(LOG_ERR, "Failed to close the old telemetry file.");
+    }
+
+    char *filenameNew = logTlm_getRotatedFilename(pLog, pLog->idRotateOld);
+    if ((rename(pLog->filename, filenameNew) == -1) ||
+        (rename(filenameNext, pLog->filename) == -1)) {
+        syslog(LOG_ERR, "Failed to rename the telemetry file.");
+    } else {
+        logTlm_notifyRetention(pLog, pLog->idRotateOld);
+    }
+
+    free(filenameNew);
+}
+
+// Close and rename the old file, and prepare the next file. This runs in the
+// housekeeping thread, so the flush path does not wait for the metadata
+// operations of file system. Without the thread, the mmap backend calls this
+// in logTlmHandle_open() and logTlmHandle_flush() instead of
+// logTlmHandle_write().
+static void logTlm_doHousekeeping(logTlm_handle_t pLog) {
+
+    char *filenameNext = logTlm_getNextFilename(pLog);
+
+    if (logTlm_isFileOpen(&pLog->fileOld)) {
+        logTlm_closeOldFile(pLog, filenameNext);
+    }
+
+    if (logTlm_isFileOpen(&pLog->file) &&
+        (!logTlm_isFileOpen(&pLog->fileNext))) {
+        if (logTlm_openFile(pLog, &pLog->fileNext, filenameNext) != 0) {
+            syslog(LOG_ERR, "Failed to prepare the next telemetry file.");
+        }
+    }
+
+    free(filenameNext);
+}
+
+int logTlmHandle_close(logTlm_handle_t pLog) {
+
+    // Wait for the renaming of old file and the synchronization of file, and
+    // remove the next file if any
+    logTlm_lock(pLog);
+    logTlm_waitHousekeeping(pLog);
+    logTlm_waitSync(pLog);
+    logTlm_unlock(pLog);
+
+    // The mmap backend without the housekeeping thread might have the old
+    // file not renamed yet
+    if (logTlm_isFileOpen(&pLog->fileOld)) {
+        char *filenameNext = logTlm_getNextFilename(pLog);
+        logTlm_closeOldFile(pLog, filenameNext);
+        free(filenameNext);
+    }
+
+    if (logTlm_isFileOpen(&pLog->fileNext)) {
+        logTlm_closeFile(pLog, &pLog->fileNext, 0, false);
+
+        char *filenameNext = logTlm_getNextFilename(pLog);
+        unlink(filenameNext);
+        free(filenameNext);
+    }
+
+    int status = 0;
+    if (logTlm_isFileOpen(&pLog->file)) {
+        status = logTlm_closeFile(pLog, &pLog->file,
+                                  pLog->countFile * pLog->sizeElementInBuffer,
+                                  logTlm_isDurable(pLog));
+    }
+
+    if (status != 0) {
+        syslog(LOG_ERR, "Failed to close the telemetry file.");
+    }
+
+    return status;
+}
+
+// Set the filename. The user needs to free the memory of "filename" if it is
+// not needed anymore.
+static void logTlm_setFilename(logTlm_handle_t pLog, char *pathDir,
+                               char *formatFileName) {
+
+    // Getting current time
+    time_t timeCurrent;
+    time(&timeCurrent);
+    struct tm *timeLocal = localtime(&timeCurrent);
+
+    // Formatting time
+    char timeFormatted[200];
+    strftime(timeFormatted, sizeof(timeFormatted), formatFileName, timeLocal);
+
+    // Before setting the filename, check we need to free the memory or not.
+    if (strlen(pLog->filename) != 0) {
+        free(pLog->filename);
+    }
+
+    pLog->filename = joinStr(pathDir, timeFormatted);
+}
+
+int logTlmHandle_open(logTlm_handle_t pLog, char *pathDir,
+                      char *formatFilename, int recordPerFile) {
+
+    // Check the input
+    if ((recordPerFile <= 0) || (recordPerFile < pLog->countBufferMax)) {
+        syslog(LOG_ERR,
+               "The size or file record should be > 0 or size of buffer.");
+        return -1;
+    }
+
+    // The fields of columnar layout should be in the record
+    size_t sizeFields = 0;
+    int idxField;
+    for (idxField = 0; idxField < pLog->numField; idxField++) {
+        logTlmField_t *pField = &pLog->pFields[idxField];
+        sizeFields += pField->size;
+        if ((pField->size == 0) || ((pField->offset + pField->size) >
+                                    pLog->sizeElementInBuffer)) {
+            syslog(LOG_ERR, "The field %d is out of the telemetry record.",
+                   idxField);
+            return -1;
+        }
+    }
+
+    if (sizeFields > pLog->sizeElementInBuffer) {
+        syslog(LOG_ERR, "The fields are larger than the telemetry record.");
+        return -1;
+    }
+
+    // Check there is still the flushing or not
+    if (logTlmHandle_isFlushing(pLog)) {
+        syslog(LOG_ERR, "Can not open a new telemetry file because the "
+                        "flushing is still ongoing.");
+        return -1;
+    }
+
+    // Always close the file first if there is any
+    if (logTlmHandle_close(pLog) != 0) {
+        return -1;
+    }
+
+    // Open a new file
+    pLog->countFileMax = recordPerFile;
+    pLog->countFile = 0;
+    pLog->timeSyncLastNs = logTlm_getTimeMonotonicNs();
+
+    logTlm_updateTimeOffsetTai(pLog);
+
+    logTlm_setFilename(pLog, pathDir, formatFilename);
+    if (logTlm_openFile(pLog, &pLog->file, pLog->filename) != 0) {
+        syslog(LOG_ERR, "Failed to open the telemetry file.");
+        return -1;
+    }
+
+    // Update the internal data
+    pLog->countRotatingFile = 0;
+    pLog->countBufferCurrent = 0;
+
+    logTlm_lock(pLog);
+
+    // Let the housekeeping thread prepare the next file
+    bool isHousekeepingReady = pLog->isHousekeepingReady;
+    if (isHousekeepingReady) {
+        pLog->isHousekeepingPending = true;
+        pthread_cond_broadcast(&pLog->condHousekeeping);
+    }
+
+    // The retention follows the rotated files of the new file
+    free(pLog->filenameRetention);
+    pLog->filenameRetention = strdup(pLog->filename);
+    pLog->idRetentionOldest = 0;
+    pLog->idRetentionNewest = -1;
+
+    // The failed write of direct I/O thread was of the last file
+    pLog->isWriteDirectFailed = false;
+
+    // The first buffer is in use and the others are free
+
+    pLog->listFree.head = 0;
+    pLog->listFree.num = 0;
+    pLog->listFull.head = 0;
+    pLog->listFull.num = 0;
+
+    int id;
+    for (id = 2; id <= pLog->numBuffer; id++) {
+        logTlm_pushList(&pLog->listFree, id);
+    }
+
+    pLog->pBufferCurrent = (pLog->numBuffer > 0) ? pLog->ppBuffers[0] : NULL;
+
+    logTlm_unlock(pLog);
+
+    // Without the housekeeping thread, the next file of mmap backend is
+    // prepared here, so logTlmHandle_write() only swaps the mapping
+    if ((pLog->backend == LogTlmBackend_Mmap) && (!isHousekeepingReady)) {
+        logTlm_doHousekeeping(pLog);
+    }
+
+    return 0;
+}
+
+// Rotate the file. If the housekeeping thread prepared the next file, this is
+// just a swap of the files and the thread closes and renames the old one.
+// Otherwise, the file is closed, renamed, and opened here.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_rotateFile(logTlm_handle_t pLog) {
+
+    off_t sizeFile = pLog->countFile * pLog->sizeElementInBuffer;
+
+    if (pLog->isHousekeepingReady) {
+        logTlm_lock(pLog);
+
+        // The old file should be renamed before this rotation
+        logTlm_waitHousekeeping(pLog);
+
+        bool isSwapped = logTlm_isFileOpen(&pLog->fileNext);
+        if (isSwapped) {
+            pLog->fileOld = pLog->file;
+            pLog->file = pLog->fileNext;
+            logTlm_resetFile(&pLog->fileNext);
+
+            pLog->idRotateOld = pLog->countRotatingFile;
+            pLog->countRotatingFile += 1;
+
+            pLog->isHousekeepingPending = true;
+            pthread_cond_broadcast(&pLog->condHousekeeping);
+        } else {
+            // The current file is closed here, so its fdatasync() in the
+            // housekeeping thread should be done first
+            logTlm_waitSync(pLog);
+        }
+
+        logTlm_unlock(pLog);
+
+        if (isSwapped) {
+            return 0;
+        }
+    }
+
+    // Close the current file
+    if (logTlm_closeFile(pLog, &pLog->file, sizeFile,
+                         logTlm_isDurable(pLog)) != 0) {
+        return -1;
+    }
+
+    // Rename the file
+    char *filenameNew =
+        logTlm_getRotatedFilename(pLog, pLog->countRotatingFile);
+    int status = rename(pLog->filename, filenameNew);
+
+    // Release the resource
+    free(filenameNew);
+    filenameNew = NULL;
+
+    if (status == -1) {
+        return -1;
+    }
+
+    logTlm_notifyRetention(pLog, pLog->countRotatingFile);
+
+    // Update the counter
+    pLog->countRotatingFile += 1;
+
+    // Open a new file
+    if (logTlm_openFile(pLog, &pLog->file, pLog->filename) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Run the housekeeping thread.
+static void *logTlm_runHousekeeping(void *pData) {
+
+    logTlm_handle_t pLog = (logTlm_handle_t)pData;
+
+    // Finish the pending job before closing the thread
+    logTlm_lock(pLog);
+    while (pLog->isHousekeepingReady || pLog->isHousekeepingPending ||
+           pLog->isSyncPending) {
+
+        // The synchronization goes first, so the file is not closed as the
+        // old file before it.
+        if (pLog->isSyncPending) {
+            int fd = pLog->fdSync;
+            logTlm_unlock(pLog);
+
+            logTlm_syncData(pLog, fd);
+
+            logTlm_lock(pLog);
+
+            // The queued one is for the file after the rotation
+            if (pLog->isSyncQueued) {
+                pLog->fdSync = pLog->fdSyncQueued;
+                pLog->isSyncQueued = false;
+            } else {
+                pLog->isSyncPending = false;
+            }
+
+            pthread_cond_broadcast(&pLog->condHousekeeping);
+            continue;
+        }
+
+        if (!pLog->isHousekeepingPending) {
+            pthread_cond_wait(&pLog->condHousekeeping, &pLog->lock);
+            continue;
+        }
+
+        logTlm_unlock(pLog);
+
+        logTlm_doHousekeeping(pLog);
+
+        logTlm_lock(pLog);
+
+        pLog->isHousekeepingPending = false;
+        pthread_cond_broadcast(&pLog->condHousekeeping);
+    }
+    logTlm_unlock(pLog);
+
+    return 0;
+}
+
+// Run the retention thread. The retention is applied when the thread is woken
+// up by the rotation or the setting, and every LOGTLM_RETENTION_PERIOD
+// seconds for the age.
+static void *logTlm_runRetention(void *pData) {
+
+    logTlm_handle_t pLog = (logTlm_handle_t)pData;
+
+    logTlm_lock(pLog);
+    while (pLog->isRetentionReady) {
+
+        if (!pLog->isRetentionPending) {
+            struct timespec timeWake;
+            clock_gettime(CLOCK_REALTIME, &timeWake);
+            timeWake.tv_sec += LOGTLM_RETENTION_PERIOD;
+
+            if ((pthread_cond_timedwait(&pLog->condRetention, &pLog->lock,
+                                        &timeWake) == ETIMEDOUT) &&
+                (pLog->retention.ageMaxInSec > 0)) {
+                pLog->isRetentionPending = true;
+            }
+
+            continue;
+        }
+
+        pLog->isRetentionPending = false;
+
+        if (pLog->filenameRetention == NULL) {
+            continue;
+        }
+
+        logTlmRetention_t retention = pLog->retention;
+        char *filename = strdup(pLog->filenameRetention);
+        int idOldest = pLog->idRetentionOldest;
+        int idNewest = pLog->idRetentionNewest;
+
+        logTlm_unlock(pLog);
+
+        logTlmRetentionAccount_t account;
+        memset(&account, 0, sizeof(account));
+
+        int idOldestLeft = idOldest;
+        if (filename != NULL) {
+            idOldestLeft = logTlmRetention_apply(filename, idOldest, idNewest,
+                                                 &retention, &account);
+        }
+
+        logTlm_lock(pLog);
+
+        pLog->accountRetention.numFileDeleted += account.numFileDeleted;
+        pLog->accountRetention.numFileCompressed += account.numFileCompressed;
+
+        // The file may be opened again in the meantime
+        if ((filename != NULL) && (pLog->filenameRetention != NULL) &&
+            (strcmp(filename, pLog->filenameRetention) == 0)) {
+            pLog->idRetentionOldest = idOldestLeft;
+            pLog->accountRetention.numFile = account.numFile;
+            pLog->accountRetention.size = account.size;
+        }
+
+        free(filename);
+    }
+    logTlm_unlock(pLog);
+
+    return 0;
+}
+
+// Close the retention thread. The current job is finished.
+static void logTlm_closeRetention(logTlm_handle_t pLog) {
+
+    if (!pLog->isRetentionReady) {
+        return;
+    }
+
+    logTlm_lock(pLog);
+    pLog->isRetentionReady = false;
+    pthread_cond_signal(&pLog->condRetention);
+    logTlm_unlock(pLog);
+
+    if (pthread_join(pLog->threadRetention, NULL) != 0) {
+        syslog(LOG_ERR, "Failed the waiting of telemetry retention thread.");
+    }
+}
+
+int logTlmHandle_setRetention(logTlm_handle_t pLog,
+                              const logTlmRetention_t *pRetention) {
+
+    logTlmRetention_t retention;
+    memset(&retention, 0, sizeof(retention));
+    if (pRetention != NULL) {
+        retention = *pRetention;
+    }
+
+    if ((retention.sizeMax < 0) || (retention.ageMaxInSec < 0)) {
+        syslog(LOG_ERR, "The budgets of telemetry retention should be >= 0.");
+        return -1;
+    }
+
+    logTlm_lock(pLog);
+    pLog->retention = retention;
+    pLog->isRetentionPending = true;
+    pthread_cond_signal(&pLog->condRetention);
+    logTlm_unlock(pLog);
+
+    if ((retention.sizeMax == 0) && (retention.ageMaxInSec == 0)) {
+        logTlm_closeRetention(pLog);
+        return 0;
+    }
+
+    if (pLog->isRetentionReady) {
+        return 0;
+    }
+
+    // The thread has the default priority to not disturb the flush thread
+    pLog->isRetentionReady = true;
+    if (pthread_create(&pLog->threadRetention, NULL, logTlm_runRetention,
+                       pLog) != 0) {
+        syslog(LOG_ERR, "Failed to create the retention thread in telemetry "
+                        "file.");
+
+        pLog->isRetentionReady = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Get the ID of buffer.
+// Return the ID. Otherwise, 0 if not found.
+static int logTlm_getBufferId(logTlm_handle_t pLog, void *pBuffer) {
+    int idx;
+    for (idx = 0; idx < pLog->numBuffer; idx++) {
+        if (pLog->ppBuffers[idx] == pBuffer) {
+            return idx + 1;
+        }
+    }
+
+    return 0;
+}
+
+// Copy the record header and data to "pRecord". The data is zero if "pData"
+// is NULL (gap marker).
+static inline void logTlm_copyRecord(logTlm_handle_t pLog, uint8_t *pRecord,
+                                     logTlmRecordHeader_t *pHeader,
+                                     void *pData) {
+    size_t sizeData = pLog->sizeElementInBuffer - pLog->sizeRecordHeader;
+    if (pLog->sizeRecordHeader > 0) {
+        memcpy(pRecord, pHeader, pLog->sizeRecordHeader);
+        pRecord += pLog->sizeRecordHeader;
+    }
+
+    if (pData == NULL) {
+        memset(pRecord, 0, sizeData);
+    } else {
+        memcpy(pRecord, pData, sizeData);
+    }
+}
+
+// Rotate the full file of mmap backend by swapping the mapping with the next
+// file. This does not wait for the housekeeping thread and does no file
+// operation, which is done by logTlm_doHousekeeping() later.
+// Return true if the file is rotated. Otherwise, false if the next file is not
+// ready yet.
+static bool logTlm_swapMap(logTlm_handle_t pLog) {
+
+    logTlm_lock(pLog);
+
+    // The housekeeping thread owns the next and old files while it has the job
+    bool isSwapped = (!pLog->isHousekeepingPending) &&
+                     logTlm_isFileOpen(&pLog->fileNext) &&
+                     (!logTlm_isFileOpen(&pLog->fileOld));
+    if (isSwapped) {
+        pLog->fileOld = pLog->file;
+        pLog->file = pLog->fileNext;
+        logTlm_resetFile(&pLog->fileNext);
+
+        pLog->idRotateOld = pLog->countRotatingFile;
+        pLog->countRotatingFile += 1;
+        pLog->countFile = 0;
+
+        if (pLog->isHousekeepingReady) {
+            pLog->isHousekeepingPending = true;
+            pthread_cond_broadcast(&pLog->condHousekeeping);
+        }
+    }
+
+    logTlm_unlock(pLog);
+
+    return isSwapped;
+}
+
+// Write the data into the mapping of mmap backend directly and rotate the file
+// if it is full. If the next file is not ready, the record is dropped as the
+// buffers are full.
+// Return 0 if success. Otherwise, -2 if no file or the record is dropped.
+static int logTlm_writeToMap(logTlm_handle_t pLog,
+                             logTlmRecordHeader_t *pHeader, void *pData) {
+
+    if (pLog->file.pMap == NULL) {
+        return -2;
+    }
+
+    // The last rotation found no next file
+    if ((pLog->countFile >= pLog->countFileMax) && (!logTlm_swapMap(pLog))) {
+        if (pData != NULL) {
+            logTlm_lock(pLog);
+            pLog->numRecordDropped += 1;
+            logTlm_unlock(pLog);
+        }
+
+        return -2;
+    }
+
+    size_t offset = pLog->countFile * pLog->sizeElementInBuffer;
+    logTlm_copyRecord(pLog, (uint8_t *)pLog->file.pMap + offset, pHeader,
+                      pData);
+    pLog->countFile += 1;
+
+    if (pLog->countFile == pLog->countFileMax) {
+        logTlm_swapMap(pLog);
+    }
+
+    return 0;
+}
+
+// Synchronize the records written since the last call to the file of mmap
+// backend. The writeback is only scheduled and this does not block.
+// Return 0 if success. Otherwise, -1.
+static int logTlm_syncMap(logTlm_handle_t pLog) {
+
+    // The address of msync() should be aligned to the page
+    size_t sizePage = sysconf(_SC_PAGESIZE);
+    size_t start = pLog->file.countFileSynced * pLog->sizeElementInBuffer;
+    start = (start / sizePage) * sizePage;
+
+    size_t end = pLog->countFile * pLog->sizeElementInBuffer;
+    if ((end > start) && (msync((uint8_t *)pLog->file.pMap + start,
+                                end - start, MS_ASYNC) != 0)) {
+        syslog(LOG_ERR, "Failed to synchronize the telemetry file.");
+        return -1;
+    }
+
+    pLog->file.countFileSynced = pLog->countFile;
+
+    return 0;
+}
+
+// Write the record to the buffer with the header. The data is zero if "pData"
+// is NULL (gap marker), which is not counted as the dropped record.
+// Return the same as logTlmHandle_write().
+static int logTlm_writeRecord(logTlm_handle_t pLog,
+                              logTlmRecordHeader_t *pHeader, void *pData) {
+
+    // The mmap backend does not use the buffers
+    if (pLog->backend == LogTlmBackend_Mmap) {
+        return logTlm_writeToMap(pLog, pHeader, pData);
+    }
+
+    // Check there is the buffer or file available or not
+    if ((pLog->pBufferCurrent == NULL) || (!logTlm_isFileOpen(&pLog->file))) {
+
+        // All the buffers are waiting for the flush
+        if (logTlm_isFileOpen(&pLog->file) && (pLog->numBuffer > 0) &&
+            (pData != NULL)) {
+            logTlm_lock(pLog);
+            pLog->numRecordDropped += 1;
+            logTlm_unlock(pLog);
+        }
+
+        return -2;
+    }
+
+    // Copy the data to memory and update the counter
+    if (pLog->countBufferCurrent < pLog->countBufferMax) {
+        logTlm_copyRecord(pLog,
+                          (uint8_t *)pLog->pBufferCurrent +
+                              pLog->countBufferCurrent *
+                                  pLog->sizeElementInBuffer,
+                          pHeader, pData);
+
+        pLog->countBufferCurrent += 1;
+
+        // Track the time range of the buffer for the block header. The time
+        // of record header is used if any.
+        if (pLog->format == LogTlmFormat_Container) {
+            int64_t timeNs =
+                (pHeader != NULL) ? pHeader->timeNs : logTlm_getTimeNs();
+            if (pLog->countBufferCurrent == 1) {
+                pLog->timeRangeCurrent.timeMinNs = timeNs;
+            }
+
+            pLog->timeRangeCurrent.timeMaxNs = timeNs;
+        }
+    }
+
+    // Check the buffer is full or not
+    if (pLog->countBufferCurrent < pLog->countBufferMax) {
+        return 0;
+    }
+
+    // Check there is the telemetry thread or not. If not, flush the data to
+    // file.
+    if (!pLog->isThreadReady) {
+        logTlmHandle_flush(pLog);
+        return 0;
+    }
+
+    // There is the telemetry thread and the current buffer is full. Hand it
+    // to the thread and use a free buffer if possible.
+    logTlm_lock(pLog);
+
+    int idFull = logTlm_getBufferId(pLog, pLog->pBufferCurrent);
+    pLog->pTimeRanges[idFull - 1] = pLog->timeRangeCurrent;
+    logTlm_pushList(&pLog->listFull, idFull);
+    if (pLog->listFull.num > pLog->numBufferFullMax) {
+        pLog->numBufferFullMax = pLog->listFull.num;
+    }
+
+    // Set the current buffer pointer to be NULL if all the buffers are full.
+    // The thread will assign the buffer after the flushing.
+    int id = logTlm_popList(&pLog->listFree);
+    pLog->pBufferCurrent = (id == 0) ? NULL : pLog->ppBuffers[id - 1];
+    pLog->countBufferCurrent = 0;
+
+    // Wake up the thread to flush the full buffer immediately
+    pthread_cond_signal(&pLog->condFull);
+
+    logTlm_unlock(pLog);
+
+    return (id == 0) ? -1 : 0;
+}
+
+// Write the record with the gap marker of the dropped records before it.
+// Return the same as logTlmHandle_write().
+static int logTlm_writeRecordWithGap(logTlm_handle_t pLog,
+                                     logTlmRecordHeader_t *pHeader,
+                                     void *pData) {
+
+    if (pHeader == NULL) {
+        return logTlm_writeRecord(pLog, NULL, pData);
+    }
+
+    // Mark the dropped records before this one
+    if (pLog->isGap) {
+        logTlmRecordHeader_t marker;
+        marker.sequence = pLog->sequenceGap | LOGTLM_SEQUENCE_GAP;
+        marker.timeNs = pHeader->timeNs;
+
+        if (logTlm_writeRecord(pLog, &marker, NULL) != -2) {
+            pLog->isGap = false;
+        }
+    }
+
+    int status = logTlm_writeRecord(pLog, pHeader, pData);
+
+    // The record is dropped because all the buffers are full
+    if ((status == -2) && logTlm_isFileOpen(&pLog->file) && (!pLog->isGap)) {
+        pLog->isGap = true;
+        pLog->sequenceGap = pHeader->sequence;
+    }
+
+    return status;
+}
+
+// Write the record in the format of buffer, which starts with the record
+// header if any.
+// Return the same as logTlmHandle_write().
+static int logTlm_writeRecordInBuffer(logTlm_handle_t pLog, uint8_t *pRecord) {
+    logTlmRecordHeader_t header;
+    if (pLog->sizeRecordHeader == 0) {
+        return logTlm_writeRecordWithGap(pLog, NULL, pRecord);
+    }
 
-// File name
-static char *filename = "";
+    memcpy(&header, pRecord, sizeof(header));
+    return logTlm_writeRecordWithGap(pLog, &header,
+                                     pRecord + pLog->sizeRecordHeader);
+}
 
-// Pointer of the file
-static FILE *pFile = NULL;
+// Write the minimum, maximum, and mean records of the window if any.
+// Return the same as logTlmHandle_write(). The last failure is returned if
+// any.
+static int logTlm_writeWindow(logTlm_handle_t pLog) {
 
-// Pointers of the buffers
+    if (pLog->countDecimation == 0) {
+        return 0;
+    }
 
-// Current buffer in use, which is pBuffer1, pBuffer1, or NULL.
-static void *pBufferCurrent = NULL;
+    uint8_t *pLast = pLog->pWindowRecords;
+    uint8_t *pRecord = pLog->pWindowRecords + pLog->sizeElementInBuffer;
 
-// Buffers that store the data
-static void *pBuffer1 = NULL;
-static void *pBuffer2 = NULL;
+    int status = 0;
+    int idxOutput;
+    for (idxOutput = 0; idxOutput < 3; idxOutput++) {
+        memcpy(pRecord, pLast, pLog->sizeElementInBuffer);
+
+        double *pValues =
+            pLog->pWindowValues + idxOutput * pLog->numValueWindow;
+        int idxValue = 0;
+        int idxField;
+        for (idxField = 0; idxField < pLog->numFieldDecimation; idxField++) {
+            logTlmField_t *pField = &pLog->pFieldsDecimation[idxField];
+
+            size_t offset;
+            for (offset = 0; offset < pField->size;
+                 offset += sizeof(double)) {
+                double value = pValues[idxValue];
+                if (idxOutput == 2) {
+                    value /= pLog->countDecimation;
+                }
+
+                memcpy(pRecord + pField->offset + offset, &value,
+                       sizeof(double));
+                idxValue++;
+            }
+        }
 
-// Size of each element in buffer
-static size_t sizeElementInBuffer = 0;
+        int statusRecord = logTlm_writeRecordInBuffer(pLog, pRecord);
+        if (statusRecord != 0) {
+            status = statusRecord;
+        }
+    }
 
-// Counter of the rotating file
-static int countRotatingFile = 0;
+    pLog->countDecimation = 0;
 
-// Maximum count per file
-static int countFileMax = 0;
+    return status;
+}
 
-// Current count of the file
-static int countFile = 0;
+// Add the record to the window of min/max/mean decimation and write the
+// window if it is full.
+// Return the same as logTlmHandle_write().
+static int logTlm_addToWindow(logTlm_handle_t pLog, uint8_t *pRecord) {
+
+    double *pMin = pLog->pWindowValues;
+    double *pMax = pMin + pLog->numValueWindow;
+    double *pSum = pMax + pLog->numValueWindow;
+
+    int idxValue = 0;
+    int idxField;
+    for (idxField = 0; idxField < pLog->numFieldDecimation; idxField++) {
+        logTlmField_t *pField = &pLog->pFieldsDecimation[idxField];
+
+        size_t offset;
+        for (offset = 0; offset < pField->size; offset += sizeof(double)) {
+            double value;
+            memcpy(&value, pRecord + pField->offset + offset, sizeof(double));
+
+            if (pLog->countDecimation == 0) {
+                pMin[idxValue] = value;
+                pMax[idxValue] = value;
+                pSum[idxValue] = value;
+            } else {
+                if (value < pMin[idxValue]) {
+                    pMin[idxValue] = value;
+                }
+                if (value > pMax[idxValue]) {
+                    pMax[idxValue] = value;
+                }
+                pSum[idxValue] += value;
+            }
 
-// Maximum count of the buffer
-static int countBufferMax = 0;
+            idxValue++;
+        }
+    }
 
-// Current count in the buffer
-static int countBufferCurrent = 0;
+    memcpy(pLog->pWindowRecords, pRecord, pLog->sizeElementInBuffer);
+    pLog->countDecimation += 1;
 
-// Mutex lock
-static pthread_mutex_t lock;
+    if (pLog->countDecimation < pLog->factorDecimation) {
+        return 0;
+    }
 
-// Buffers are full or not (critical section)
-static bool isFullBuffer1 = false;
-static bool isFullBuffer2 = false;
+    return logTlm_writeWindow(pLog);
+}
 
-// Thread to flush the data to file
-static pthread_t thread;
+// Write the record in the format of buffer with the decimation.
+// Return the same as logTlmHandle_write().
+static int logTlm_decimateRecord(logTlm_handle_t pLog, uint8_t *pRecord) {
 
-// Thread is ready or not
-static bool isThreadReady = false;
+    if (pLog->decimation == LogTlmDecimation_Sample) {
+        bool isWritten = (pLog->countDecimation == 0);
+        pLog->countDecimation =
+            (pLog->countDecimation + 1) % pLog->factorDecimation;
 
-char *logTlm_getFilename(void) { return filename; }
+        return isWritten ? logTlm_writeRecordInBuffer(pLog, pRecord) : 0;
+    }
 
-void *logTlm_getBuffer(int id) {
-    if (id == 0) {
-        return pBufferCurrent;
-    } else if (id == 1) {
-        return pBuffer1;
-    } else if (id == 2) {
-        return pBuffer2;
-    } else {
-        return NULL;
+    if (pLog->decimation == LogTlmDecimation_MinMaxMean) {
+        return logTlm_addToWindow(pLog, pRecord);
     }
+
+    return logTlm_writeRecordInBuffer(pLog, pRecord);
 }
 
-// Free the single buffer and set to NULL.
-static void logTlm_freeBufferSingle(void **ppBuffer) {
+// Remove the oldest record in the pre-trigger ring.
+// Return the record. It is valid until the next record is put in the ring.
+static uint8_t *logTlm_popRing(logTlm_handle_t pLog) {
+    uint8_t *pRecord =
+        pLog->pRing + pLog->headRing * pLog->sizeElementInBuffer;
 
-    if (*ppBuffer != NULL) {
-        free(*ppBuffer);
-        *ppBuffer = NULL;
-    }
+    pLog->headRing = (pLog->headRing + 1) % (pLog->numPreTrigger + 1);
+    pLog->numRing -= 1;
+
+    return pRecord;
 }
 
-void logTlm_freeBuffer(void) {
+// Capture the record with the pre-trigger ring, trigger, and decimation. The
+// records are decimated when they leave the ring, so the file keeps the order
+// of records when the ring is written at the full rate.
+// Return the same as logTlmHandle_write().
+static int logTlm_captureRecord(logTlm_handle_t pLog,
+                                logTlmRecordHeader_t *pHeader, void *pData) {
 
-    // Free the buffer
-    logTlm_freeBufferSingle(&pBuffer1);
-    logTlm_freeBufferSingle(&pBuffer2);
+    int status = 0;
+    if ((pLog->trigger != NULL) && pLog->trigger(pLog->pUserTrigger, pData)) {
 
-    pBufferCurrent = NULL;
+        // Write the history before the trigger in order
+        if (pLog->countPostTrigger == 0) {
+            logTlm_lock(pLog);
+            pLog->numTrigger += 1;
+            logTlm_unlock(pLog);
 
-    // Destroy the mutex lock
-    if (pthread_mutex_destroy(&lock) != 0) {
-        syslog(LOG_ERR, "Mutex destroy has failed in the telemetry file.");
-        exit(1);
-    }
-}
+            if (pLog->decimation == LogTlmDecimation_MinMaxMean) {
+                status = logTlm_writeWindow(pLog);
+            }
 
-// Create the single buffer.
-// Return 0 if success. Otherwise, -1.
-static int logTlm_createBufferSingle(void **ppBuffer, int sizeBuffer,
-                                     size_t sizeElement, int id) {
-    *ppBuffer = calloc(sizeBuffer, sizeElement);
-    if (*ppBuffer == NULL) {
-        syslog(LOG_ERR,
-               "Failed to allocate the memory of buffer %d of telemetry file.",
-               id);
-        return -1;
+            while (pLog->numRing > 0) {
+                int statusRecord =
+                    logTlm_writeRecordInBuffer(pLog, logTlm_popRing(pLog));
+                if (statusRecord != 0) {
+                    status = statusRecord;
+                }
+            }
+        }
+
+        // This record and the post-trigger ones
+        pLog->countPostTrigger = pLog->numPostTrigger + 1;
     }
 
-    return 0;
-}
+    if (pLog->countPostTrigger > 0) {
+        pLog->countPostTrigger -= 1;
 
-int logTlm_createBuffer(int sizeBuffer, size_t sizeElement) {
-    if ((sizeBuffer <= 0) || (sizeElement <= 0)) {
-        syslog(LOG_ERR, "The buffer/element size should be > 0.");
-        return -1;
+        int statusRecord = logTlm_writeRecordWithGap(pLog, pHeader, pData);
+        return (statusRecord != 0) ? statusRecord : status;
     }
 
-    // Allocate the memory
-    int status =
-        logTlm_createBufferSingle(&pBuffer1, sizeBuffer, sizeElement, 1);
-    if (status == 0) {
-        status =
-            logTlm_createBufferSingle(&pBuffer2, sizeBuffer, sizeElement, 2);
+    // Keep the record in the ring and decimate the oldest one out of it
+    int idxRing = (pLog->headRing + pLog->numRing) % (pLog->numPreTrigger + 1);
+    uint8_t *pRecord = pLog->pRing + idxRing * pLog->sizeElementInBuffer;
+    if (pHeader != NULL) {
+        memcpy(pRecord, pHeader, pLog->sizeRecordHeader);
     }
 
-    // Free the buffer 1 if failed to allocate the memory for buffer 2
-    if ((status == -1) && (pBuffer1 != NULL)) {
-        logTlm_freeBufferSingle(&pBuffer1);
-        return -1;
-    }
+    memcpy(pRecord + pLog->sizeRecordHeader, pData,
+           pLog->sizeElementInBuffer - pLog->sizeRecordHeader);
+    pLog->numRing += 1;
 
-    if (pthread_mutex_init(&lock, NULL) != 0) {
-        syslog(LOG_ERR, "Mutex init has failed in the telemetry file.");
-        return -1;
+    if (pLog->numRing <= pLog->numPreTrigger) {
+        return 0;
     }
 
-    // Update the internal data
-    countBufferMax = sizeBuffer;
-    sizeElementInBuffer = sizeElement;
-
-    return 0;
+    return logTlm_decimateRecord(pLog, logTlm_popRing(pLog));
 }
 
-int logTlm_close(void) {
+int logTlmHandle_flushCapture(logTlm_handle_t pLog) {
+
+    if (pLog->pRing == NULL) {
+        return 0;
+    }
+
     int status = 0;
-    if (pFile != NULL) {
-        status = fclose(pFile);
-        pFile = NULL;
+    while (pLog->numRing > 0) {
+        int statusRecord = logTlm_decimateRecord(pLog, logTlm_popRing(pLog));
+        if (statusRecord != 0) {
+            status = statusRecord;
+        }
     }
 
-    if (status != 0) {
-        syslog(LOG_ERR, "Failed to close the telemetry file.");
+    if (pLog->decimation == LogTlmDecimation_MinMaxMean) {
+        int statusRecord = logTlm_writeWindow(pLog);
+        if (statusRecord != 0) {
+            status = statusRecord;
+        }
     }
 
     return status;
 }
 
-// Set the filename. The user needs to free the memory of "filename" if it is
-// not needed anymore.
-static void logTlm_setFilename(char *pathDir, char *formatFileName) {
-
-    // Getting current time
-    time_t timeCurrent;
-    time(&timeCurrent);
-    struct tm *timeLocal = localtime(&timeCurrent);
+int logTlmHandle_write(logTlm_handle_t pLog, void *pData) {
 
-    // Formatting time
-    char timeFormatted[200];
-    strftime(timeFormatted, sizeof(timeFormatted), formatFileName, timeLocal);
+    logTlmRecordHeader_t header;
+    logTlmRecordHeader_t *pHeader = NULL;
+    if (pLog->sizeRecordHeader > 0) {
+        header.sequence = pLog->sequence;
+        header.timeNs = logTlm_getTimeTaiNs(pLog);
 
-    // Before setting the filename, check we need to free the memory or not.
-    if (strlen(filename) != 0) {
-        free(filename);
+        pLog->sequence += 1;
+        pHeader = &header;
     }
 
-    filename = joinStr(pathDir, timeFormatted);
-}
-
-// Hold the mutex lock.
-static inline void logTlm_lock(void) {
-    if (pthread_mutex_lock(&lock) != 0) {
-        syslog(LOG_ERR, "Mutex lock has failed in the telemetry file.");
-        exit(1);
+    if (pLog->pRing != NULL) {
+        return logTlm_captureRecord(pLog, pHeader, pData);
     }
-}
 
-// Release the mutex lock.
-static inline void logTlm_unlock(void) {
-    if (pthread_mutex_unlock(&lock) != 0) {
-        syslog(LOG_ERR, "Mutex unlock has failed in the telemetry file.");
-        exit(1);
-    }
+    return logTlm_writeRecordWithGap(pLog, pHeader, pData);
 }
 
-int logTlm_open(char *pathDir, char *formatFilename, int recordPerFile) {
+// Transpose the records to the columns and encode each column if it becomes
+// smaller. The encoded columns are put in "pEncoded" and their sizes are in
+// "pSizeColumns".
+// Return the size of the columns in bytes.
+static size_t logTlm_encodeColumns(logTlm_handle_t pLog, void *pBuffer,
+                                   int numRecord) {
+
+    uint8_t *pRecords = (uint8_t *)pBuffer;
+    uint8_t *pColumn = (uint8_t *)pLog->pColumn;
+
+    size_t sizeColumns = 0;
+    int idxField, idxRecord;
+    for (idxField = 0; idxField < pLog->numField; idxField++) {
+        size_t offset = pLog->pFields[idxField].offset;
+        size_t size = pLog->pFields[idxField].size;
+
+        for (idxRecord = 0; idxRecord < numRecord; idxRecord++) {
+            memcpy(pColumn + idxRecord * size,
+                   pRecords + idxRecord * pLog->sizeElementInBuffer + offset,
+                   size);
+        }
 
-    // Check the input
-    if ((recordPerFile <= 0) || (recordPerFile < countBufferMax)) {
-        syslog(LOG_ERR,
-               "The size or file record should be > 0 or size of buffer.");
-        return -1;
-    }
+        size_t sizeRaw = numRecord * size;
+        uint8_t *pDst = (uint8_t *)pLog->pEncoded + sizeColumns;
 
-    // Check there is still the flushing or not
-    if (logTlm_isFlushing()) {
-        syslog(LOG_ERR, "Can not open a new telemetry file because the "
-                        "flushing is still ongoing.");
-        return -1;
-    }
+        long sizeEncoded = -1;
+        if (pLog->codec != LogTlmCodec_None) {
+            sizeEncoded = logTlmCodec_encode(pLog->codec, pColumn, numRecord,
+                                             size, pDst, sizeRaw - 1);
+        }
 
-    // Always close the file first if there is any
-    if (logTlm_close() != 0) {
-        return -1;
-    }
+        if (sizeEncoded < 0) {
+            memcpy(pDst, pColumn, sizeRaw);
+            sizeEncoded = sizeRaw;
+        }
 
-    // Open a new file
-    logTlm_setFilename(pathDir, formatFilename);
-    pFile = fopen(filename, "w");
-    if (pFile == NULL) {
-        syslog(LOG_ERR, "Failed to open the telemetry file.");
-        return -1;
+        pLog->pSizeColumns[idxField] = sizeEncoded;
+        sizeColumns += sizeEncoded;
     }
 
-    // Update the internal data
-    countFileMax = recordPerFile;
-    countFile = 0;
-
-    countRotatingFile = 0;
-    countBufferCurrent = 0;
-
-    pBufferCurrent = pBuffer1;
-
-    logTlm_lock();
-    isFullBuffer1 = false;
-    isFullBuffer2 = false;
-    logTlm_unlock();
-
-    return 0;
+    return sizeColumns;
 }
 
-// Get the rotated file name. The user needs to free the output memory if it is
-// not needed anymore.
-static char *logTlm_getRotatedFilename(void) {
-    char extension[100];
-    sprintf(extension, ".%d", countRotatingFile);
+// Write the records to the current file. In the container format, the
+// records are written as a block and the block is added to the index. The
+// "idBuffer" is the ID of buffer that "pBuffer" is in, or 0.
+// Return 0 if success. Otherwise, -1 and the file is closed.
+static int logTlm_writeToFile(logTlm_handle_t pLog, void *pBuffer,
+                              int numRecord, logTlmTimeRange_t *pTimeRange,
+                              int idBuffer) {
 
-    return joinStr(filename, extension);
-}
+    if (numRecord <= 0) {
+        return 0;
+    }
 
-// Rotate the file to the next one.
-// Return 0 if success. Otherwise, -1.
-static int logTlm_rotateFile(void) {
+    void *pData = pBuffer;
+    size_t sizeData = numRecord * pLog->sizeElementInBuffer;
+
+    // The size of each column is before the columns
+    size_t sizeDirectory = pLog->numField * sizeof(uint32_t);
+    if (pLog->numField > 0) {
+        pData = pLog->pEncoded;
+        sizeData = logTlm_encodeColumns(pLog, pBuffer, numRecord);
+    } else if (pLog->codec != LogTlmCodec_None) {
+        // Encode the block if it becomes smaller
+        long sizeEncoded =
+            logTlmCodec_encode(pLog->codec, pBuffer, numRecord,
+                               pLog->sizeElementInBuffer, pLog->pEncoded,
+                               sizeData - 1);
+        if (sizeEncoded >= 0) {
+            pData = pLog->pEncoded;
+            sizeData = sizeEncoded;
+        }
+    }
 
-    // Close the current file
-    if (logTlm_close() != 0) {
-        return -1;
+    int status = 0;
+    if (pLog->format == LogTlmFormat_Container) {
+        status = logTlm_writeBlockHeader(pLog, &pLog->file, numRecord,
+                                         sizeDirectory + sizeData, pTimeRange);
     }
 
-    // Rename the file
-    char *filenameNew = logTlm_getRotatedFilename();
-    if (rename(filename, filenameNew) == -1) {
-        // Release the resource
-        free(filenameNew);
-        filenameNew = NULL;
+    if (status == 0) {
+        status = logTlm_writeBytes(pLog, &pLog->file, pLog->pSizeColumns,
+                                   sizeDirectory, 0);
+    }
 
-        return -1;
+    if (status == 0) {
+        status = logTlm_writeBytes(pLog, &pLog->file, pData, sizeData,
+                                   (pData == pBuffer) ? idBuffer : 0);
     }
 
-    // Release the resource
-    free(filenameNew);
-    filenameNew = NULL;
+    // Write the whole blocks of this flush
+    if ((status == 0) && (pLog->backend == LogTlmBackend_Direct)) {
+        status = logTlm_submitStaging(pLog, &pLog->file);
+    }
 
-    // Update the counter
-    countRotatingFile += 1;
+    if (status == -1) {
+        logTlmHandle_close(pLog);
 
-    // Open a new file pointer
-    pFile = fopen(filename, "w");
-    if (pFile == NULL) {
-        return -1;
+        syslog(LOG_ERR,
+               "Failed to write the data to telemetry log. Closing...");
     }
 
-    return 0;
+    return status;
 }
 
-int logTlm_write(void *pData) {
+// Synchronize the current file if the durability policy is due. The writeback
+// of data written since the last synchronization is started by
+// sync_file_range() without waiting, and the housekeeping thread waits for it
+// by fdatasync(). Without the housekeeping thread, fdatasync() is called here.
+// The "sizeWritten" is the bytes written to the file.
+static void logTlm_checkDurability(logTlm_handle_t pLog, off_t sizeWritten) {
 
-    // Check there is the buffer or file available or not
-    if ((pBufferCurrent == NULL) || (pFile == NULL)) {
-        return -2;
+    if ((pLog->durability != LogTlmDurability_Bytes) &&
+        (pLog->durability != LogTlmDurability_Time)) {
+        return;
     }
 
-    // Copy the data to memory and update the counter
-    if (countBufferCurrent < countBufferMax) {
-        memcpy(pBufferCurrent + countBufferCurrent * sizeElementInBuffer, pData,
-               sizeElementInBuffer);
-
-        countBufferCurrent += 1;
-    }
+    logTlmFile_t *pFileTlm = &pLog->file;
+    off_t sizeNew = sizeWritten - pFileTlm->sizeSynced;
+    int64_t timeNs = logTlm_getTimeMonotonicNs();
 
-    // Check the buffer is full or not
-    if (countBufferCurrent < countBufferMax) {
-        return 0;
+    bool isDue = (pLog->durability == LogTlmDurability_Bytes)
+                     ? (sizeNew >= pLog->thresholdDurability)
+                     : ((timeNs - pLog->timeSyncLastNs) >=
+                        (int64_t)pLog->thresholdDurability * 1000000);
+    if ((!isDue) || (sizeNew <= 0)) {
+        return;
     }
 
-    // Check there is the telemetry thread or not. If not, flush the data to
-    // file.
-    if (!isThreadReady) {
-        logTlm_flush();
-        return 0;
+    int fd = pFileTlm->fd;
+    if (pFileTlm->pFile != NULL) {
+        fflush(pFileTlm->pFile);
+        fd = fileno(pFileTlm->pFile);
     }
 
-    // There is the telemetry thread and the current buffer is full. Use
-    // another buffer if possible.
-    bool isAnotherBufferFull = true;
-    if (pBufferCurrent == pBuffer1) {
-
-        logTlm_lock();
-        isFullBuffer1 = true;
-        isAnotherBufferFull = isFullBuffer2;
-        logTlm_unlock();
-
-        if (!isAnotherBufferFull) {
-            pBufferCurrent = pBuffer2;
-            countBufferCurrent = 0;
-            return 0;
-        }
-    } else {
-
-        logTlm_lock();
-        isAnotherBufferFull = isFullBuffer1;
-        isFullBuffer2 = true;
-        logTlm_unlock();
+    // The direct I/O thread synchronizes the file after the queued writes of
+    // it
+    if (logTlm_isWriteQueued(pLog)) {
+        pFileTlm->sizeSynced = sizeWritten;
+        pLog->timeSyncLastNs = timeNs;
 
-        if (!isAnotherBufferFull) {
-            pBufferCurrent = pBuffer1;
-            countBufferCurrent = 0;
-            return 0;
-        }
+        logTlm_queueWriteDirect(pLog, fd, NULL, 0, 0, 0);
+        return;
     }
 
-    // Set the current buffer pointer to be NULL if both of buffers are full
-    if (isAnotherBufferFull) {
-        pBufferCurrent = NULL;
-    }
+    // Ignore the failure because fdatasync() writes the data anyway
+    sync_file_range(fd, pFileTlm->sizeSynced, sizeNew, SYNC_FILE_RANGE_WRITE);
 
-    return -1;
-}
+    pFileTlm->sizeSynced = sizeWritten;
+    pLog->timeSyncLastNs = timeNs;
 
-// Write to the file.
-// Return 0 if success. Otherwise -1.
-static int logTlm_writeToFile(void *pBuffer, size_t size) {
-    if (fwrite(pBuffer, size, 1, pFile) <= 0) {
-        logTlm_close();
+    if (!pLog->isHousekeepingReady) {
+        logTlm_syncData(pLog, fd);
+        return;
+    }
 
-        syslog(LOG_ERR,
-               "Failed to write the data to telemetry log. Closing...");
-        return -1;
+    // If the last one of the same file is still ongoing, the next
+    // synchronization covers the data. If it is of the file before the
+    // rotation, queue this one after it.
+    logTlm_lock(pLog);
+    if (!pLog->isSyncPending) {
+        pLog->isSyncPending = true;
+        pLog->fdSync = fd;
+        pthread_cond_broadcast(&pLog->condHousekeeping);
+    } else if (fd != pLog->fdSync) {
+        pLog->isSyncQueued = true;
+        pLog->fdSyncQueued = fd;
     }
-    return 0;
+    logTlm_unlock(pLog);
 }
 
-// Flush the buffer data to file.
-static void logTlm_flushToFile(void *pBuffer, int countBuffer) {
+// Flush the buffer data to file. The "idBuffer" is the ID of buffer that the
+// direct backend might queue to write without the copy. 0 if the buffer is
+// reused after this call, so the data is copied.
+static void logTlm_flushToFile(logTlm_handle_t pLog, void *pBuffer,
+                               int countBuffer, logTlmTimeRange_t *pTimeRange,
+                               int idBuffer) {
 
     // Return immediately if no file
-    if (pFile == NULL) {
+    if (!logTlm_isFileOpen(&pLog->file)) {
         syslog(LOG_ERR, "No telemetry file to flush. Returning ...");
         return;
     }
 
+    // Follow the adjustment of the TAI time
+    logTlm_updateTimeOffsetTai(pLog);
+
     // Check the current space
-    int spaceAvailable = countFileMax - countFile;
+    int spaceAvailable = pLog->countFileMax - pLog->countFile;
     bool isSpaceEnough = (countBuffer <= spaceAvailable);
 
     int numToFile = isSpaceEnough ? countBuffer : spaceAvailable;
-    int status = logTlm_writeToFile(pBuffer, numToFile * sizeElementInBuffer);
+    int status =
+        logTlm_writeToFile(pLog, pBuffer, numToFile, pTimeRange, idBuffer);
 
     // Rotate to a new file
     bool isRotated = false;
     if ((status == 0) && (spaceAvailable == numToFile)) {
-        status = logTlm_rotateFile();
+        status = logTlm_rotateFile(pLog);
         isRotated = (status == 0);
     }
 
     // If the rotation is needed, write the left data.
     if ((!isSpaceEnough) && isRotated) {
-        status =
-            logTlm_writeToFile(pBuffer + numToFile * sizeElementInBuffer,
-                               (countBuffer - numToFile) * sizeElementInBuffer);
+        status = logTlm_writeToFile(
+            pLog, (uint8_t *)pBuffer + numToFile * pLog->sizeElementInBuffer,
+            countBuffer - numToFile, pTimeRange, idBuffer);
     }
 
     if (status == -1) {
-        logTlm_close();
+        logTlmHandle_close(pLog);
 
         syslog(LOG_ERR,
                "Failed to write the data to telemetry log. Closing...");
@@ -397,62 +2921,131 @@ static void logTlm_flushToFile(void *pBuffer, int countBuffer) {
     }
 
     // Update the counters
-    countFile = isRotated ? (countBuffer - numToFile) : (countFile + numToFile);
+    pLog->countFile = isRotated ? (countBuffer - numToFile)
+                                : (pLog->countFile + numToFile);
+
+    logTlm_checkDurability(pLog, pLog->file.sizeWritten);
 }
 
-int logTlm_flush(void) {
+int logTlmHandle_flush(logTlm_handle_t pLog) {
+    // The data of mmap backend is in the file already
+    if (pLog->backend == LogTlmBackend_Mmap) {
+        logTlm_updateTimeOffsetTai(pLog);
+        if (pLog->file.pMap == NULL) {
+            return -1;
+        }
+
+        // Without the housekeeping thread, the old file is renamed and the
+        // next file is prepared here
+        logTlm_lock(pLog);
+        bool isHousekeepingReady = pLog->isHousekeepingReady;
+        logTlm_unlock(pLog);
+
+        if ((!isHousekeepingReady) &&
+            (logTlm_isFileOpen(&pLog->fileOld) ||
+             (!logTlm_isFileOpen(&pLog->fileNext)))) {
+            logTlm_doHousekeeping(pLog);
+        }
+
+        if (logTlm_syncMap(pLog) != 0) {
+            return -1;
+        }
+
+        logTlm_checkDurability(pLog,
+                               pLog->countFile * pLog->sizeElementInBuffer);
+        return 0;
+    }
+
     // Check there is the file or buffer available or not
-    if ((pFile == NULL) || (pBufferCurrent == NULL)) {
+    if ((!logTlm_isFileOpen(&pLog->file)) || (pLog->pBufferCurrent == NULL)) {
         return -1;
     }
 
     // If the thread is running, check the data in buffer is flushing or not.
-    if (isThreadReady && logTlm_isFlushing()) {
+    if (pLog->isThreadReady && logTlmHandle_isFlushing(pLog)) {
         return -1;
     }
 
-    logTlm_flushToFile(pBufferCurrent, countBufferCurrent);
-    countBufferCurrent = 0;
+    logTlm_flushToFile(pLog, pLog->pBufferCurrent, pLog->countBufferCurrent,
+                       &pLog->timeRangeCurrent, 0);
+    pLog->countBufferCurrent = 0;
 
     return 0;
 }
 
-bool logTlm_isFlushing(void) {
+bool logTlmHandle_isFlushing(logTlm_handle_t pLog) {
 
     // Return false if there is no thread
-    if (!isThreadReady) {
+    if (!pLog->isThreadReady) {
         return false;
     }
 
     // By default, assume the flushing status is still ongoing.
     bool isFlushingOnGoing = true;
 
-    if (pthread_mutex_trylock(&lock) == 0) {
-        isFlushingOnGoing = (isFullBuffer1 || isFullBuffer2);
-        logTlm_unlock();
+    if (pthread_mutex_trylock(&pLog->lock) == 0) {
+        isFlushingOnGoing = (pLog->listFull.num > 0);
+        logTlm_unlock(pLog);
     }
 
     return isFlushingOnGoing;
 }
 
-void logTlm_closeThread(void) {
+// Close the direct I/O thread after it finishes the queued writes. The later
+// writes are done without the thread.
+static void logTlm_closeDirectThread(logTlm_handle_t pLog) {
+
+    if (!pLog->isDirectReady) {
+        return;
+    }
+
+    logTlm_lock(pLog);
+    pLog->isDirectReady = false;
+    pthread_cond_broadcast(&pLog->condDirect);
+    logTlm_unlock(pLog);
+
+    if (pthread_join(pLog->threadDirect, NULL) != 0) {
+        syslog(LOG_ERR, "Failed the waiting of telemetry direct I/O thread.");
+    }
+}
+
+void logTlmHandle_closeThread(logTlm_handle_t pLog) {
 
     int error = 0;
-    if (isThreadReady) {
-        isThreadReady = false;
-        error = pthread_join(thread, NULL);
+    if (pLog->isThreadReady) {
+        logTlm_lock(pLog);
+        pLog->isThreadReady = false;
+        pthread_cond_signal(&pLog->condFull);
+        logTlm_unlock(pLog);
+
+        error = pthread_join(pLog->thread, NULL);
     }
 
     if (error != 0) {
         syslog(LOG_ERR,
                "Failed the waiting of telemetry file thread. Cancelling it...");
 
-        error = pthread_cancel(thread);
+        error = pthread_cancel(pLog->thread);
     }
 
     if (error != 0) {
         syslog(LOG_ERR, "Failed to cancel the telemetry file thread.");
     }
+
+    // The housekeeping thread finishes the pending job before closing
+    if (pLog->isHousekeepingReady) {
+        logTlm_lock(pLog);
+        pLog->isHousekeepingReady = false;
+        pthread_cond_broadcast(&pLog->condHousekeeping);
+        logTlm_unlock(pLog);
+
+        if (pthread_join(pLog->threadHousekeeping, NULL) != 0) {
+            syslog(LOG_ERR, "Failed the waiting of telemetry housekeeping "
+                            "thread.");
+        }
+    }
+
+    logTlm_closeDirectThread(pLog);
 }
 
 // Run the thread job to flush the data automatically.
@@ -460,72 +3053,44 @@ void logTlm_closeThread(void) {
 // The input needs to cast to the correct data type when needed.
 static void *logTlm_run(void *pData) {
 
-    // Get the checking time in ms
-    int *pTimeInMs = (int *)pData;
-    syslog(LOG_INFO, "Checking time in telemetry file thread is %d ms.",
-           *pTimeInMs);
-
-    // Wait until the thread is ready
-    while (!isThreadReady) {
-        sleep(1);
-    }
-
-    // Loop delay time
-    struct timespec sleepTime;
-    sleepTime.tv_nsec = (*pTimeInMs) * 1e6;
-    sleepTime.tv_sec = 0;
+    logTlm_handle_t pLog = (logTlm_handle_t)pData;
+    syslog(LOG_INFO, "Telemetry file thread waits for the full buffers.");
 
-    // Flush the data to file
-    bool doFlushBuffer1;
-    bool doFlushBuffer2;
-    while (isThreadReady) {
+    // Flush the data to file. The thread sleeps on the condition until
+    // logTlmHandle_write() hands over a full buffer, so there is no polling.
+    logTlm_lock(pLog);
+    while (pLog->isThreadReady) {
 
-        // Check we need to flush the data or not
-        doFlushBuffer1 = false;
-        doFlushBuffer2 = false;
-        if (pthread_mutex_trylock(&lock) == 0) {
-            doFlushBuffer1 = isFullBuffer1;
-            doFlushBuffer2 = isFullBuffer2;
-            logTlm_unlock();
+        if (pLog->listFull.num == 0) {
+            pthread_cond_wait(&pLog->condFull, &pLog->lock);
+            continue;
         }
 
-        if (doFlushBuffer1 || doFlushBuffer2) {
-            // Flush the buffer 1
-            if (doFlushBuffer1) {
-                logTlm_flushToFile(pBuffer1, countBufferMax);
+        // The oldest full buffer is flushed first. Release the lock while
+        // writing so that logTlmHandle_write() is not blocked by the file.
+        int id = pLog->listFull.pIds[pLog->listFull.head];
+        pLog->pCountsWriting[id - 1] = 1;
+        logTlm_unlock(pLog);
 
-                logTlm_lock();
-                isFullBuffer1 = false;
-                logTlm_unlock();
-            }
+        logTlm_flushToFile(pLog, pLog->ppBuffers[id - 1],
+                           pLog->countBufferMax, &pLog->pTimeRanges[id - 1],
+                           id);
 
-            // Flush the buffer 2
-            if (doFlushBuffer2) {
-                logTlm_flushToFile(pBuffer2, countBufferMax);
+        logTlm_lock(pLog);
 
-                logTlm_lock();
-                isFullBuffer2 = false;
-                logTlm_unlock();
-            }
+        logTlm_popList(&pLog->listFull);
 
-            // Re-assign the current buffer if needed. This might happen if
-            // logTlm_write() finds both of buffers are full.
-            if (pBufferCurrent == NULL) {
-                pBufferCurrent = pBuffer1;
-                countBufferCurrent = 0;
-            }
-        } else {
-            // Give other functions a chance to run
-            nanosleep(&sleepTime, NULL);
-        }
+        // The direct I/O thread releases the buffer if it is still writing it
+        logTlm_releaseBuffer(pLog, id);
     }
+    logTlm_unlock(pLog);
 
     syslog(LOG_INFO, "Close the thread of telemetry file.");
 
     return 0;
 }
 
-int logTlm_runFlushInNewThread(int *pTimeInMs) {
+int logTlmHandle_runFlushInNewThread(logTlm_handle_t pLog, int *pTimeInMs) {
 
     // Check the input time
     if ((*pTimeInMs) <= 0) {
@@ -533,25 +3098,130 @@ int logTlm_runFlushInNewThread(int *pTimeInMs) {
         return -1;
     }
 
-    // Create the thread
-    int error = pthread_create(&thread, NULL, logTlm_run, pTimeInMs);
+    // The thread is event-driven and the checking time is only kept for the
+    // compatibility.
+    syslog(LOG_INFO, "Checking time in telemetry file thread is %d ms.",
+           *pTimeInMs);
+
+    // Create the direct I/O thread with the default priority before the
+    // flush thread, which queues the writes of direct backend to it. Without
+    // this thread, the flush writes the data.
+    if (pLog->backend == LogTlmBackend_Direct) {
+        pLog->isDirectReady = true;
+        if (pthread_create(&pLog->threadDirect, NULL, logTlm_runDirect,
+                           pLog) != 0) {
+            syslog(LOG_ERR, "Failed to create the direct I/O thread in "
+                            "telemetry file.");
+
+            pLog->isDirectReady = false;
+        }
+    }
+
+    // Create the thread. Mark it ready first so that the thread does not exit
+    // before this function returns.
+    pLog->isThreadReady = true;
+    int error = pthread_create(&pLog->thread, NULL, logTlm_run, pLog);
     struct sched_param param;
     if (error != 0) {
         syslog(LOG_ERR, "Failed to create the thread in telemetry file.");
+
+        pLog->isThreadReady = false;
+        logTlm_closeDirectThread(pLog);
         return -1;
     } else {
         // Set priority of this thread
         param.sched_priority = sched_get_priority_max(SCHED_OTHER);
-        if ((error = pthread_setschedparam(thread, SCHED_OTHER, &param)) != 0) {
+        if ((error = pthread_setschedparam(pLog->thread, SCHED_OTHER,
+                                           &param)) != 0) {
             syslog(LOG_ERR,
                    "Can't initialize the thread priority in telemetry file.");
 
-            pthread_cancel(thread);
+            logTlmHandle_closeThread(pLog);
             return -1;
         }
     }
 
-    isThreadReady = true;
+    // Create the housekeeping thread with the default priority and let it
+    // prepare the next file. Without this thread, the rotation is done in the
+    // flush path.
+    logTlm_lock(pLog);
+    pLog->isHousekeepingReady = true;
+    pLog->isHousekeepingPending = true;
+    logTlm_unlock(pLog);
+
+    if (pthread_create(&pLog->threadHousekeeping, NULL, logTlm_runHousekeeping,
+                       pLog) != 0) {
+        syslog(LOG_ERR, "Failed to create the housekeeping thread in "
+                        "telemetry file.");
+
+        logTlm_lock(pLog);
+        pLog->isHousekeepingReady = false;
+        pLog->isHousekeepingPending = false;
+        logTlm_unlock(pLog);
+    }
 
     return 0;
 }
+
+void logTlmHandle_getStats(logTlm_handle_t pLog, logTlmStats_t *pStats) {
+
+    logTlm_lock(pLog);
+
+    pStats->numRecordDropped = pLog->numRecordDropped;
+    pStats->numBufferFull = pLog->listFull.num;
+    pStats->numBufferFullMax = pLog->numBufferFullMax;
+    pStats->numSync = pLog->numSync;
+    pStats->numSyncFailed = pLog->numSyncFailed;
+    pStats->timeSyncTotalNs = pLog->timeSyncTotalNs;
+    pStats->timeSyncMaxNs = pLog->timeSyncMaxNs;
+    pStats->numTrigger = pLog->numTrigger;
+    pStats->accountRetention = pLog->accountRetention;
+
+    logTlm_unlock(pLog);
+}
+
+char *logTlm_getFilename(void) {
+    return logTlmHandle_getFilename(&logTlmDefault);
+}
+
+void *logTlm_getBuffer(int id) {
+    return logTlmHandle_getBuffer(&logTlmDefault, id);
+}
+
+void logTlm_freeBuffer(void) { logTlmHandle_freeBuffer(&logTlmDefault); }
+
+int logTlm_createBuffer(int sizeBuffer, size_t sizeElement) {
+    return logTlmHandle_createBuffer(&logTlmDefault, sizeBuffer, sizeElement);
+}
+
+int logTlm_createBufferPool(int num, int sizeBuffer, size_t sizeElement) {
+    return logTlmHandle_createBufferPool(&logTlmDefault, num, sizeBuffer,
+                                         sizeElement);
+}
+
+int logTlm_close(void) { return logTlmHandle_close(&logTlmDefault); }
+
+int logTlm_open(char *pathDir, char *formatFilename, int recordPerFile) {
+    return logTlmHandle_open(&logTlmDefault, pathDir, formatFilename,
+                             recordPerFile);
+}
+
+int logTlm_write(void *pData) {
+    return logTlmHandle_write(&logTlmDefault, pData);
+}
+
+int logTlm_flush(void) { return logTlmHandle_flush(&logTlmDefault); }
+
+bool logTlm_isFlushing(void) {
+    return logTlmHandle_isFlushing(&logTlmDefault);
+}
+
+void logTlm_getStats(logTlmStats_t *pStats) {
+    logTlmHandle_getStats(&logTlmDefault, pStats);
+}
+
+void logTlm_closeThread(void) { logTlmHandle_closeThread(&logTlmDefault); }
+
+int logTlm_runFlushInNewThread(int *pTimeInMs) {
+    return logTlmHandle_runFlushInNewThread(&logTlmDefault, pTimeInMs);
+}
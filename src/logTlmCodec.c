@@ -0,0 +1,193 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "logTlmCodec.h"
+
+// Maximum length of a run. The control byte of a run of zero is 0x80 + length
+// - 1, and the one of a run of literals is length - 1 followed by the bytes.
+#define LOGTLMCODEC_RUN_MAX 128
+
+// State of the run-length encoder
+typedef struct {
+    uint8_t *pDst;
+    size_t sizeDstMax;
+    // Number of the bytes in pDst
+    size_t size;
+    // Position of the control byte of the current run of literals
+    size_t posControl;
+    int numLiteral;
+    int numZero;
+    bool isOverflow;
+} logTlmCodecEncoder_t;
+
+// Close the current run of zero.
+static inline void logTlmCodec_closeZero(logTlmCodecEncoder_t *pEncoder) {
+    if (pEncoder->size >= pEncoder->sizeDstMax) {
+        pEncoder->isOverflow = true;
+        return;
+    }
+
+    pEncoder->pDst[pEncoder->size] = 0x80 | (pEncoder->numZero - 1);
+    pEncoder->size += 1;
+    pEncoder->numZero = 0;
+}
+
+// Close the current run of literals.
+static inline void logTlmCodec_closeLiteral(logTlmCodecEncoder_t *pEncoder) {
+    pEncoder->pDst[pEncoder->posControl] = pEncoder->numLiteral - 1;
+    pEncoder->numLiteral = 0;
+}
+
+// Put a byte to the encoder.
+static inline void logTlmCodec_putByte(logTlmCodecEncoder_t *pEncoder,
+                                       uint8_t value) {
+
+    if (value == 0) {
+        if (pEncoder->numLiteral > 0) {
+            logTlmCodec_closeLiteral(pEncoder);
+        }
+
+        pEncoder->numZero += 1;
+        if (pEncoder->numZero == LOGTLMCODEC_RUN_MAX) {
+            logTlmCodec_closeZero(pEncoder);
+        }
+
+        return;
+    }
+
+    if (pEncoder->numZero > 0) {
+        logTlmCodec_closeZero(pEncoder);
+    }
+
+    // Reserve the control byte of a new run of literals
+    if (pEncoder->numLiteral == 0) {
+        pEncoder->posControl = pEncoder->size;
+        pEncoder->size += 1;
+    }
+
+    if (pEncoder->size >= pEncoder->sizeDstMax) {
+        pEncoder->isOverflow = true;
+        return;
+    }
+
+    pEncoder->pDst[pEncoder->size] = value;
+    pEncoder->size += 1;
+
+    pEncoder->numLiteral += 1;
+    if (pEncoder->numLiteral == LOGTLMCODEC_RUN_MAX) {
+        logTlmCodec_closeLiteral(pEncoder);
+    }
+}
+
+long logTlmCodec_encode(LogTlmCodec codec, void *pSrc, int numRecord,
+                        size_t sizeElement, void *pDst, size_t sizeDstMax) {
+
+    size_t sizeSrc = numRecord * sizeElement;
+    if (codec == LogTlmCodec_None) {
+        if (sizeSrc > sizeDstMax) {
+            return -1;
+        }
+
+        memcpy(pDst, pSrc, sizeSrc);
+        return sizeSrc;
+    }
+
+    if (codec != LogTlmCodec_XorShuffle) {
+        return -1;
+    }
+
+    logTlmCodecEncoder_t encoder;
+    memset(&encoder, 0, sizeof(encoder));
+    encoder.pDst = (uint8_t *)pDst;
+    encoder.sizeDstMax = sizeDstMax;
+
+    // The same byte of all the records are encoded together
+    uint8_t *pRecords = (uint8_t *)pSrc;
+    size_t idxByte;
+    int idxRecord;
+    for (idxByte = 0; idxByte < sizeElement; idxByte++) {
+        uint8_t valuePrevious = 0;
+        for (idxRecord = 0; idxRecord < numRecord; idxRecord++) {
+            uint8_t value = pRecords[idxRecord * sizeElement + idxByte];
+            logTlmCodec_putByte(&encoder, value ^ valuePrevious);
+
+            valuePrevious = value;
+        }
+
+        if (encoder.isOverflow) {
+            return -1;
+        }
+    }
+
+    if (encoder.numZero > 0) {
+        logTlmCodec_closeZero(&encoder);
+    }
+
+    if (encoder.numLiteral > 0) {
+        logTlmCodec_closeLiteral(&encoder);
+    }
+
+    return encoder.isOverflow ? -1 : (long)encoder.size;
+}
+
+int logTlmCodec_decode(LogTlmCodec codec, void *pSrc, size_t sizeSrc,
+                       int numRecord, size_t sizeElement, void *pDst) {
+
+    size_t sizeDst = numRecord * sizeElement;
+    if (codec == LogTlmCodec_None) {
+        if (sizeSrc != sizeDst) {
+            return -1;
+        }
+
+        memcpy(pDst, pSrc, sizeDst);
+        return 0;
+    }
+
+    if (codec != LogTlmCodec_XorShuffle) {
+        return -1;
+    }
+
+    // Undo the run-length encoding and shuffle. The index "idx" is in the
+    // shuffled order, which is the byte "idxByte" of record "idxRecord".
+    uint8_t *pData = (uint8_t *)pSrc;
+    uint8_t *pRecords = (uint8_t *)pDst;
+    size_t posSrc = 0;
+    size_t idx = 0;
+    size_t idxRecord = 0;
+    size_t idxByte = 0;
+    while ((posSrc < sizeSrc) && (idx < sizeDst)) {
+
+        uint8_t control = pData[posSrc];
+        posSrc += 1;
+
+        bool isZero = ((control & 0x80) != 0);
+        size_t length = (control & 0x7F) + 1;
+        if (((idx + length) > sizeDst) ||
+            ((!isZero) && ((posSrc + length) > sizeSrc))) {
+            return -1;
+        }
+
+        size_t count;
+        for (count = 0; count < length; count++, idx++) {
+            uint8_t value = isZero ? 0 : pData[posSrc + count];
+            if (idxRecord > 0) {
+                value ^= pRecords[(idxRecord - 1) * sizeElement + idxByte];
+            }
+
+            pRecords[idxRecord * sizeElement + idxByte] = value;
+
+            idxRecord += 1;
+            if (idxRecord == (size_t)numRecord) {
+                idxRecord = 0;
+                idxByte += 1;
+            }
+        }
+
+        if (!isZero) {
+            posSrc += length;
+        }
+    }
+
+    return ((posSrc == sizeSrc) && (idx == sizeDst)) ? 0 : -1;
+}
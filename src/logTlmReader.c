@@ -0,0 +1,1158 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logTlmReader.h"
+
+// Mapped telemetry file
+typedef struct {
+    // Mapping of the file (NULL if the file is empty)
+    uint8_t *pMap;
+    size_t size;
+
+    // Is the container format or not
+    bool isContainer;
+
+    // Header and fields of the columnar layout (container format)
+    logTlmFileHeader_t header;
+    logTlmField_t *pFields;
+
+    // Size of the record header. 0 if the records have no header.
+    size_t sizeRecordHeader;
+
+    // Index of the blocks. It is copied from the file or built by the scan of
+    // blocks. In the raw format, the whole file is one block at offset 0.
+    logTlmIndexEntry_t *pIndex;
+    long numBlock;
+} logTlmReaderFile_t;
+
+// Type of value in the CSV export
+typedef enum {
+    LogTlmReaderType_Pad = 0,
+    LogTlmReaderType_I8,
+    LogTlmReaderType_U8,
+    LogTlmReaderType_I16,
+    LogTlmReaderType_U16,
+    LogTlmReaderType_I32,
+    LogTlmReaderType_U32,
+    LogTlmReaderType_I64,
+    LogTlmReaderType_U64,
+    LogTlmReaderType_F32,
+    LogTlmReaderType_F64,
+} LogTlmReaderType;
+
+// Value in the CSV export
+typedef struct {
+    LogTlmReaderType type;
+    size_t size;
+} logTlmReaderValue_t;
+
+struct logTlmReader_t {
+    // Files in the order of writing
+    logTlmReaderFile_t *pFiles;
+    int numFile;
+
+    // Size of record in bytes without the record header
+    size_t sizeElement;
+
+    // Any file has the record header or not
+    bool isRecordHeader;
+
+    // Filter of the records
+    int64_t timeStartNs;
+    int64_t timeEndNs;
+    int decimation;
+
+    // Current position. The "idxBlock" is -1 if the first block in the time
+    // range of current file is not searched yet.
+    int idxFile;
+    long idxBlock;
+    // Index of the next record in the current block
+    long idxRecord;
+    // Number of the records in the time range (for the decimation)
+    long countRecord;
+
+    // Records of the current block. NULL if the block is not loaded.
+    const uint8_t *pRecords;
+    // The current record has the time or not
+    bool isTimeValid;
+
+    // Header of the current record
+    logTlmRecordHeader_t header;
+    bool isHeaderValid;
+
+    // Number of the dropped records marked by the gap markers
+    long numDropped;
+    // Sequence number of the last gap marker
+    uint64_t sequenceGap;
+    bool isGap;
+
+    // Buffer of the decoded records and column
+    uint8_t *pDecoded;
+    size_t sizeDecoded;
+    uint8_t *pColumn;
+    size_t sizeColumn;
+};
+
+// Get the filename of the rotated file with "id". Use "id" < 0 to get the
+// filename itself. The user needs to free the returned memory.
+static char *logTlmReader_getFilename(const char *filename, int id) {
+    size_t size = strlen(filename) + 16;
+    char *pName = (char *)malloc(size);
+    if (pName == NULL) {
+        return NULL;
+    }
+
+    if (id < 0) {
+        snprintf(pName, size, "%s", filename);
+    } else {
+        snprintf(pName, size, "%s.%d", filename, id);
+    }
+
+    return pName;
+}
+
+// The file exists or not.
+static bool logTlmReader_isFileExist(const char *filename, int id) {
+    char *pName = logTlmReader_getFilename(filename, id);
+    if (pName == NULL) {
+        return false;
+    }
+
+    struct stat st;
+    bool isExist = (stat(pName, &st) == 0) && S_ISREG(st.st_mode);
+
+    free(pName);
+
+    return isExist;
+}
+
+// Get the ID of the oldest rotated file. The oldest files may be deleted by
+// the retention of logTlm, so the directory is searched for "filename.N".
+// Return the ID. Otherwise, -1 if there is no rotated file.
+static int logTlmReader_getOldestId(const char *filename) {
+
+    // Split the directory and base name
+    const char *pBase = strrchr(filename, '/');
+    char *pDir = NULL;
+    if (pBase == NULL) {
+        pBase = filename;
+        pDir = strdup(".");
+    } else {
+        pDir = strndup(filename, (pBase == filename) ? 1 : pBase - filename);
+        pBase++;
+    }
+
+    DIR *pDirStream = (pDir == NULL) ? NULL : opendir(pDir);
+    free(pDir);
+    if (pDirStream == NULL) {
+        return -1;
+    }
+
+    size_t sizeBase = strlen(pBase);
+    int idOldest = -1;
+
+    struct dirent *pEntry;
+    while ((pEntry = readdir(pDirStream)) != NULL) {
+        const char *pName = pEntry->d_name;
+        if ((strncmp(pName, pBase, sizeBase) != 0) ||
+            (pName[sizeBase] != '.')) {
+            continue;
+        }
+
+        // The extension should be the digits only
+        const char *pId = pName + sizeBase + 1;
+        char *pEnd = NULL;
+        long id = strtol(pId, &pEnd, 10);
+        if ((pEnd == pId) || (*pEnd != '\0') || (pId[0] < '0') ||
+            (pId[0] > '9')) {
+            continue;
+        }
+
+        if ((idOldest == -1) || (id < idOldest)) {
+            idOldest = id;
+        }
+    }
+
+    closedir(pDirStream);
+
+    return idOldest;
+}
+
+// Grow the buffer to have "size" bytes at least.
+// Return 0 if success. Otherwise, -1.
+static int logTlmReader_reserve(uint8_t **ppBuffer, size_t *pSize,
+                                size_t size) {
+    if (*pSize >= size) {
+        return 0;
+    }
+
+    uint8_t *pBuffer = (uint8_t *)realloc(*ppBuffer, size);
+    if (pBuffer == NULL) {
+        syslog(LOG_ERR, "Fail to allocate the buffer of telemetry reader.");
+        return -1;
+    }
+
+    *ppBuffer = pBuffer;
+    *pSize = size;
+
+    return 0;
+}
+
+// Append the entry to the index of blocks.
+// Return 0 if success. Otherwise, -1.
+static int logTlmReader_appendIndex(logTlmReaderFile_t *pFileTlm,
+                                    long *pNumMax,
+                                    logTlmIndexEntry_t *pEntry) {
+    if (pFileTlm->numBlock == *pNumMax) {
+        long numMax = (*pNumMax == 0) ? 64 : 2 * (*pNumMax);
+        logTlmIndexEntry_t *pIndex = (logTlmIndexEntry_t *)realloc(
+            pFileTlm->pIndex, numMax * sizeof(logTlmIndexEntry_t));
+        if (pIndex == NULL) {
+            return -1;
+        }
+
+        pFileTlm->pIndex = pIndex;
+        *pNumMax = numMax;
+    }
+
+    pFileTlm->pIndex[pFileTlm->numBlock] = *pEntry;
+    pFileTlm->numBlock += 1;
+
+    return 0;
+}
+
+// Read the index at the end of the container file.
+// Return 0 if success. Otherwise, -1 if there is no valid index.
+static int logTlmReader_readIndex(logTlmReaderFile_t *pFileTlm,
+                                  size_t offsetBlock) {
+
+    if (pFileTlm->size < offsetBlock + sizeof(logTlmFileFooter_t)) {
+        return -1;
+    }
+
+    logTlmFileFooter_t footer;
+    memcpy(&footer, pFileTlm->pMap + pFileTlm->size - sizeof(footer),
+           sizeof(footer));
+
+    size_t sizeIndex = footer.numBlock * sizeof(logTlmIndexEntry_t);
+    if ((memcmp(footer.magic, LOGTLM_INDEX_MAGIC, sizeof(footer.magic)) != 0) ||
+        (footer.offsetIndex < offsetBlock) ||
+        (footer.offsetIndex + sizeIndex + sizeof(footer) != pFileTlm->size)) {
+        return -1;
+    }
+
+    if (footer.numBlock > 0) {
+        pFileTlm->pIndex = (logTlmIndexEntry_t *)malloc(sizeIndex);
+        if (pFileTlm->pIndex == NULL) {
+            return -1;
+        }
+
+        memcpy(pFileTlm->pIndex, pFileTlm->pMap + footer.offsetIndex,
+               sizeIndex);
+    }
+    pFileTlm->numBlock = footer.numBlock;
+
+    // The blocks should be before the index
+    long idx;
+    for (idx = 0; idx < pFileTlm->numBlock; idx++) {
+        logTlmIndexEntry_t *pEntry = &pFileTlm->pIndex[idx];
+        if ((pEntry->offset < (int64_t)offsetBlock) ||
+            (pEntry->offset + sizeof(logTlmBlockHeader_t) >
+             footer.offsetIndex)) {
+            free(pFileTlm->pIndex);
+            pFileTlm->pIndex = NULL;
+            pFileTlm->numBlock = 0;
+
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Build the index by scanning the blocks of the container file. This is used
+// if the file is still written or not closed properly. The scan stops at the
+// incomplete block.
+// Return 0 if success. Otherwise, -1.
+static int logTlmReader_scanBlocks(logTlmReaderFile_t *pFileTlm,
+                                   size_t offsetBlock) {
+    long numMax = 0;
+    size_t offset = offsetBlock;
+    while (offset + sizeof(logTlmBlockHeader_t) <= pFileTlm->size) {
+        logTlmBlockHeader_t header;
+        memcpy(&header, pFileTlm->pMap + offset, sizeof(header));
+
+        // The preallocated space is zero
+        if ((header.numRecord == 0) && (header.sizeData == 0)) {
+            break;
+        }
+
+        size_t offsetNext = offset + sizeof(header) + header.sizeData;
+        if (offsetNext > pFileTlm->size) {
+            break;
+        }
+
+        logTlmIndexEntry_t entry = {0};
+        entry.offset = offset;
+        entry.timeMinNs = header.timeMinNs;
+        entry.timeMaxNs = header.timeMaxNs;
+        entry.numRecord = header.numRecord;
+        if (logTlmReader_appendIndex(pFileTlm, &numMax, &entry) != 0) {
+            syslog(LOG_ERR, "Fail to allocate the index of telemetry file.");
+            return -1;
+        }
+
+        offset = offsetNext;
+    }
+
+    return 0;
+}
+
+// Parse the header and index of the container file.
+// Return 0 if success. Otherwise, -1.
+static int logTlmReader_parseContainer(logTlmReaderFile_t *pFileTlm,
+                                       const char *filename) {
+    memcpy(&pFileTlm->header, pFileTlm->pMap, sizeof(logTlmFileHeader_t));
+
+    logTlmFileHeader_t *pHeader = &pFileTlm->header;
+    if (pHeader->flags & LOGTLM_FLAG_RECORD_HEADER) {
+        pFileTlm->sizeRecordHeader = sizeof(logTlmRecordHeader_t);
+    }
+
+    if ((pHeader->version != LOGTLM_FILE_VERSION) ||
+        (pHeader->sizeElement <= pFileTlm->sizeRecordHeader)) {
+        syslog(LOG_ERR, "Unsupported telemetry file: %s (version %u).",
+               filename, pHeader->version);
+        return -1;
+    }
+
+    size_t offsetBlock = sizeof(logTlmFileHeader_t);
+    if (pHeader->numField > 0) {
+        size_t sizeFields = pHeader->numField * sizeof(logTlmField_t);
+        if (offsetBlock + sizeFields > pFileTlm->size) {
+            syslog(LOG_ERR, "Corrupted fields in the telemetry file: %s.",
+                   filename);
+            return -1;
+        }
+
+        pFileTlm->pFields = (logTlmField_t *)malloc(sizeFields);
+        if (pFileTlm->pFields == NULL) {
+            return -1;
+        }
+        memcpy(pFileTlm->pFields, pFileTlm->pMap + offsetBlock, sizeFields);
+
+        uint32_t idx;
+        for (idx = 0; idx < pHeader->numField; idx++) {
+            logTlmField_t *pField = &pFileTlm->pFields[idx];
+            if ((pField->size == 0) ||
+                (pField->offset + pField->size > pHeader->sizeElement)) {
+                syslog(LOG_ERR, "Corrupted fields in the telemetry file: %s.",
+                       filename);
+                return -1;
+            }
+        }
+
+        offsetBlock += sizeFields;
+    }
+
+    if (logTlmReader_readIndex(pFileTlm, offsetBlock) == 0) {
+        return 0;
+    }
+
+    return logTlmReader_scanBlocks(pFileTlm, offsetBlock);
+}
+
+// Unmap the file and free the index.
+static void logTlmReader_unmapFile(logTlmReaderFile_t *pFileTlm) {
+    if (pFileTlm->pMap != NULL) {
+        munmap(pFileTlm->pMap, pFileTlm->size);
+        pFileTlm->pMap = NULL;
+    }
+
+    free(pFileTlm->pFields);
+    pFileTlm->pFields = NULL;
+
+    free(pFileTlm->pIndex);
+    pFileTlm->pIndex = NULL;
+    pFileTlm->numBlock = 0;
+}
+
+// Map the file and parse it. The "pSizeElement" is updated by the container
+// file if it is 0.
+// Return 0 if success. Otherwise, -1.
+static int logTlmReader_mapFile(logTlmReaderFile_t *pFileTlm,
+                                const char *filename, size_t *pSizeElement) {
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        syslog(LOG_ERR, "Fail to open the telemetry file: %s (%s).", filename,
+               strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    pFileTlm->size = st.st_size;
+    if (pFileTlm->size > 0) {
+        void *pMap =
+            mmap(NULL, pFileTlm->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pMap == MAP_FAILED) {
+            syslog(LOG_ERR, "Fail to map the telemetry file: %s (%s).",
+                   filename, strerror(errno));
+            close(fd);
+            return -1;
+        }
+
+        pFileTlm->pMap = (uint8_t *)pMap;
+        madvise(pMap, pFileTlm->size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping is kept after the close
+    close(fd);
+
+    pFileTlm->isContainer =
+        (pFileTlm->size >= sizeof(logTlmFileHeader_t)) &&
+        (memcmp(pFileTlm->pMap, LOGTLM_FILE_MAGIC,
+                sizeof(LOGTLM_FILE_MAGIC)) == 0);
+
+    if (pFileTlm->isContainer) {
+        if (logTlmReader_parseContainer(pFileTlm, filename) != 0) {
+            return -1;
+        }
+
+        // The user sees the record without the header
+        size_t sizeElement =
+            pFileTlm->header.sizeElement - pFileTlm->sizeRecordHeader;
+        if (*pSizeElement == 0) {
+            *pSizeElement = sizeElement;
+        }
+
+        if (*pSizeElement != sizeElement) {
+            syslog(LOG_ERR,
+                   "Different element size in the telemetry file: %s.",
+                   filename);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if (*pSizeElement == 0) {
+        syslog(LOG_ERR, "Unknown element size of the raw telemetry file: %s.",
+               filename);
+        return -1;
+    }
+
+    // The incomplete record at the end is ignored
+    logTlmIndexEntry_t entry = {0};
+    entry.numRecord = pFileTlm->size / (*pSizeElement);
+
+    long numMax = 0;
+    return logTlmReader_appendIndex(pFileTlm, &numMax, &entry);
+}
+
+logTlmReader_handle_t logTlmReader_open(const char *filename,
+                                        size_t sizeElement) {
+
+    // Count the rotated files from the oldest one
+    int idOldest = logTlmReader_getOldestId(filename);
+    int numRotated = 0;
+    while ((idOldest >= 0) &&
+           logTlmReader_isFileExist(filename, idOldest + numRotated)) {
+        numRotated++;
+    }
+
+    bool isCurrentExist = logTlmReader_isFileExist(filename, -1);
+    int numFile = numRotated + (isCurrentExist ? 1 : 0);
+    if (numFile == 0) {
+        syslog(LOG_ERR, "No telemetry file: %s.", filename);
+        return NULL;
+    }
+
+    logTlmReader_handle_t pReader =
+        (logTlmReader_handle_t)calloc(1, sizeof(struct logTlmReader_t));
+    if (pReader == NULL) {
+        return NULL;
+    }
+
+    pReader->pFiles =
+        (logTlmReaderFile_t *)calloc(numFile, sizeof(logTlmReaderFile_t));
+    if (pReader->pFiles == NULL) {
+        free(pReader);
+        return NULL;
+    }
+    pReader->numFile = numFile;
+    pReader->sizeElement = sizeElement;
+
+    pReader->timeStartNs = INT64_MIN;
+    pReader->timeEndNs = INT64_MAX;
+    pReader->decimation = 1;
+
+    // The current file is the newest one
+    int idx;
+    for (idx = 0; idx < numFile; idx++) {
+        int id = (idx < numRotated) ? (idOldest + idx) : -1;
+        char *pName = logTlmReader_getFilename(filename, id);
+        int status = (pName == NULL) ? -1
+                                     : logTlmReader_mapFile(
+                                           &pReader->pFiles[idx], pName,
+                                           &pReader->sizeElement);
+        free(pName);
+
+        if (status != 0) {
+            logTlmReader_close(pReader);
+            return NULL;
+        }
+
+        if (pReader->pFiles[idx].sizeRecordHeader > 0) {
+            pReader->isRecordHeader = true;
+        }
+    }
+
+    // The element size is unknown if all the files are empty
+    if (pReader->sizeElement == 0) {
+        syslog(LOG_ERR, "Unknown element size of the telemetry file: %s.",
+               filename);
+        logTlmReader_close(pReader);
+        return NULL;
+    }
+
+    logTlmReader_rewind(pReader);
+
+    return pReader;
+}
+
+void logTlmReader_close(logTlmReader_handle_t pReader) {
+    if (pReader == NULL) {
+        return;
+    }
+
+    int idx;
+    for (idx = 0; idx < pReader->numFile; idx++) {
+        logTlmReader_unmapFile(&pReader->pFiles[idx]);
+    }
+
+    free(pReader->pFiles);
+    free(pReader->pDecoded);
+    free(pReader->pColumn);
+    free(pReader);
+}
+
+size_t logTlmReader_getSizeElement(logTlmReader_handle_t pReader) {
+    return pReader->sizeElement;
+}
+
+int logTlmReader_getNumFile(logTlmReader_handle_t pReader) {
+    return pReader->numFile;
+}
+
+long logTlmReader_getNumRecord(logTlmReader_handle_t pReader) {
+    long numRecord = 0;
+
+    int idxFile;
+    long idxBlock;
+    for (idxFile = 0; idxFile < pReader->numFile; idxFile++) {
+        logTlmReaderFile_t *pFileTlm = &pReader->pFiles[idxFile];
+        for (idxBlock = 0; idxBlock < pFileTlm->numBlock; idxBlock++) {
+            numRecord += pFileTlm->pIndex[idxBlock].numRecord;
+        }
+    }
+
+    return numRecord;
+}
+
+void logTlmReader_setTimeRange(logTlmReader_handle_t pReader,
+                               int64_t timeStartNs, int64_t timeEndNs) {
+    pReader->timeStartNs = timeStartNs;
+    pReader->timeEndNs = timeEndNs;
+
+    logTlmReader_rewind(pReader);
+}
+
+void logTlmReader_setDecimation(logTlmReader_handle_t pReader,
+                                int decimation) {
+    pReader->decimation = (decimation > 1) ? decimation : 1;
+
+    logTlmReader_rewind(pReader);
+}
+
+void logTlmReader_rewind(logTlmReader_handle_t pReader) {
+    pReader->idxFile = 0;
+    pReader->idxBlock = -1;
+    pReader->idxRecord = 0;
+    pReader->countRecord = 0;
+    pReader->pRecords = NULL;
+    pReader->isTimeValid = false;
+    pReader->isHeaderValid = false;
+    pReader->numDropped = 0;
+    pReader->isGap = false;
+}
+
+int logTlmReader_getRecordHeader(logTlmReader_handle_t pReader,
+                                 logTlmRecordHeader_t *pHeader) {
+    if (!pReader->isHeaderValid) {
+        return -1;
+    }
+
+    *pHeader = pReader->header;
+
+    return 0;
+}
+
+long logTlmReader_getNumDropped(logTlmReader_handle_t pReader) {
+    return pReader->numDropped;
+}
+
+// Get the size of each record in the file including the record header.
+static inline size_t logTlmReader_getStride(logTlmReader_handle_t pReader,
+                                            logTlmReaderFile_t *pFileTlm) {
+    return pReader->sizeElement + pFileTlm->sizeRecordHeader;
+}
+
+// Search the first block that has the record at or after the start time.
+// Return the index of block.
+static long logTlmReader_searchBlock(logTlmReader_handle_t pReader,
+                                     logTlmReaderFile_t *pFileTlm) {
+    if (!pFileTlm->isContainer) {
+        return 0;
+    }
+
+    // The blocks are in the order of time
+    long low = 0;
+    long high = pFileTlm->numBlock;
+    while (low < high) {
+        long mid = low + (high - low) / 2;
+        if (pFileTlm->pIndex[mid].timeMaxNs < pReader->timeStartNs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+// Decode the columns of block to the records.
+// Return 0 if success. Otherwise, -1.
+static int logTlmReader_decodeColumns(logTlmReader_handle_t pReader,
+                                      logTlmReaderFile_t *pFileTlm,
+                                      const uint8_t *pData, size_t sizeData,
+                                      int numRecord) {
+
+    uint32_t numField = pFileTlm->header.numField;
+    size_t sizeDirectory = numField * sizeof(uint32_t);
+    if (sizeData < sizeDirectory) {
+        return -1;
+    }
+
+    // The bytes not in any field are zero
+    size_t stride = logTlmReader_getStride(pReader, pFileTlm);
+    memset(pReader->pDecoded, 0, numRecord * stride);
+
+    size_t offsetColumn = sizeDirectory;
+    uint32_t idxField;
+    int idxRecord;
+    for (idxField = 0; idxField < numField; idxField++) {
+        uint32_t sizeColumn;
+        memcpy(&sizeColumn, pData + idxField * sizeof(uint32_t),
+               sizeof(sizeColumn));
+
+        size_t offset = pFileTlm->pFields[idxField].offset;
+        size_t size = pFileTlm->pFields[idxField].size;
+        size_t sizeRaw = numRecord * size;
+        if ((sizeColumn > sizeRaw) ||
+            (offsetColumn + sizeColumn > sizeData)) {
+            return -1;
+        }
+
+        const uint8_t *pColumn = pData + offsetColumn;
+        if (sizeColumn < sizeRaw) {
+            if (logTlmReader_reserve(&pReader->pColumn, &pReader->sizeColumn,
+                                     sizeRaw) != 0) {
+                return -1;
+            }
+
+            if (logTlmCodec_decode((LogTlmCodec)pFileTlm->header.codec,
+                                   (void *)pColumn, sizeColumn, numRecord,
+                                   size, pReader->pColumn) != 0) {
+                return -1;
+            }
+            pColumn = pReader->pColumn;
+        }
+
+        for (idxRecord = 0; idxRecord < numRecord; idxRecord++) {
+            memcpy(pReader->pDecoded + idxRecord * stride + offset,
+                   pColumn + idxRecord * size, size);
+        }
+
+        offsetColumn += sizeColumn;
+    }
+
+    return (offsetColumn == sizeData) ? 0 : -1;
+}
+
+// Get the records of block. The records point to the mapped file if the block
+// is stored as it is. Otherwise, the block is decoded.
+// Return the records. Otherwise, NULL if the block is corrupted.
+static const uint8_t *logTlmReader_readBlock(logTlmReader_handle_t pReader,
+                                             logTlmReaderFile_t *pFileTlm,
+                                             logTlmIndexEntry_t *pEntry) {
+
+    size_t stride = logTlmReader_getStride(pReader, pFileTlm);
+    size_t sizeRaw = pEntry->numRecord * stride;
+    if (!pFileTlm->isContainer) {
+        return pFileTlm->pMap;
+    }
+
+    logTlmBlockHeader_t header;
+    memcpy(&header, pFileTlm->pMap + pEntry->offset, sizeof(header));
+
+    size_t offsetData = pEntry->offset + sizeof(header);
+    if ((header.numRecord != pEntry->numRecord) ||
+        (offsetData + header.sizeData > pFileTlm->size)) {
+        return NULL;
+    }
+
+    const uint8_t *pData = pFileTlm->pMap + offsetData;
+    if ((pFileTlm->header.numField == 0) && (header.sizeData == sizeRaw)) {
+        return pData;
+    }
+
+    if (logTlmReader_reserve(&pReader->pDecoded, &pReader->sizeDecoded,
+                             sizeRaw) != 0) {
+        return NULL;
+    }
+
+    int status = 0;
+    if (pFileTlm->header.numField > 0) {
+        status = logTlmReader_decodeColumns(pReader, pFileTlm, pData,
+                                            header.sizeData, header.numRecord);
+    } else if (header.sizeData < sizeRaw) {
+        status = logTlmCodec_decode((LogTlmCodec)pFileTlm->header.codec,
+                                    (void *)pData, header.sizeData,
+                                    header.numRecord, stride,
+                                    pReader->pDecoded);
+    } else {
+        status = -1;
+    }
+
+    return (status == 0) ? pReader->pDecoded : NULL;
+}
+
+// Load the next block in the time range.
+// Return 1 if success, 0 at the end, or -1 if the block is corrupted.
+static int logTlmReader_loadBlock(logTlmReader_handle_t pReader) {
+    while (pReader->idxFile < pReader->numFile) {
+        logTlmReaderFile_t *pFileTlm = &pReader->pFiles[pReader->idxFile];
+        if (pReader->idxBlock < 0) {
+            pReader->idxBlock = logTlmReader_searchBlock(pReader, pFileTlm);
+        }
+
+        if (pReader->idxBlock >= pFileTlm->numBlock) {
+            pReader->idxFile += 1;
+            pReader->idxBlock = -1;
+            continue;
+        }
+
+        logTlmIndexEntry_t *pEntry = &pFileTlm->pIndex[pReader->idxBlock];
+        if (pFileTlm->isContainer &&
+            (pEntry->timeMinNs > pReader->timeEndNs)) {
+            pReader->idxFile = pReader->numFile;
+            return 0;
+        }
+
+        if (pEntry->numRecord == 0) {
+            pReader->idxBlock += 1;
+            continue;
+        }
+
+        pReader->pRecords = logTlmReader_readBlock(pReader, pFileTlm, pEntry);
+        if (pReader->pRecords == NULL) {
+            syslog(LOG_ERR, "Corrupted block %ld in the telemetry file %d.",
+                   pReader->idxBlock, pReader->idxFile);
+            return -1;
+        }
+
+        pReader->idxRecord = 0;
+        return 1;
+    }
+
+    return 0;
+}
+
+int logTlmReader_next(logTlmReader_handle_t pReader, const void **ppRecord,
+                      int64_t *pTimeNs) {
+
+    while (true) {
+        if (pReader->pRecords == NULL) {
+            int status = logTlmReader_loadBlock(pReader);
+            if (status != 1) {
+                return status;
+            }
+        }
+
+        logTlmReaderFile_t *pFileTlm = &pReader->pFiles[pReader->idxFile];
+        logTlmIndexEntry_t *pEntry = &pFileTlm->pIndex[pReader->idxBlock];
+        long numRecord = pEntry->numRecord;
+
+        size_t stride = logTlmReader_getStride(pReader, pFileTlm);
+        while (pReader->idxRecord < numRecord) {
+            long idx = pReader->idxRecord;
+            pReader->idxRecord += 1;
+
+            const uint8_t *pRecord = pReader->pRecords + idx * stride;
+
+            // Use the time of record header if any. Otherwise, interpolate
+            // the time in the block.
+            int64_t timeNs = 0;
+            pReader->isHeaderValid = (pFileTlm->sizeRecordHeader > 0);
+            if (pReader->isHeaderValid) {
+                memcpy(&pReader->header, pRecord, sizeof(pReader->header));
+                pRecord += pFileTlm->sizeRecordHeader;
+
+                timeNs = pReader->header.timeNs;
+
+                // Count the dropped records by the gap marker
+                uint64_t sequence = pReader->header.sequence;
+                if (sequence & LOGTLM_SEQUENCE_GAP) {
+                    pReader->sequenceGap = sequence & ~LOGTLM_SEQUENCE_GAP;
+                    pReader->isGap = true;
+                    continue;
+                }
+
+                if (pReader->isGap && (sequence > pReader->sequenceGap)) {
+                    pReader->numDropped += sequence - pReader->sequenceGap;
+                }
+                pReader->isGap = false;
+
+            } else if (pFileTlm->isContainer) {
+                timeNs = pEntry->timeMinNs;
+                if (numRecord > 1) {
+                    timeNs += (pEntry->timeMaxNs - pEntry->timeMinNs) * idx /
+                              (numRecord - 1);
+                }
+            }
+
+            if (pFileTlm->isContainer) {
+                if (timeNs < pReader->timeStartNs) {
+                    continue;
+                }
+
+                if (timeNs > pReader->timeEndNs) {
+                    pReader->idxFile = pReader->numFile;
+                    pReader->pRecords = NULL;
+                    pReader->isHeaderValid = false;
+                    return 0;
+                }
+            }
+
+            long count = pReader->countRecord;
+            pReader->countRecord += 1;
+            if ((count % pReader->decimation) != 0) {
+                continue;
+            }
+
+            *ppRecord = pRecord;
+            if (pTimeNs != NULL) {
+                *pTimeNs = timeNs;
+            }
+            pReader->isTimeValid = pFileTlm->isContainer;
+
+            return 1;
+        }
+
+        pReader->pRecords = NULL;
+        pReader->idxBlock += 1;
+    }
+}
+
+// Parse the types of CSV export.
+// Return the number of values. Otherwise, -1 if the types are invalid or
+// longer than the record. The user needs to free "ppValues".
+static int logTlmReader_parseTypes(const char *pTypes, size_t sizeElement,
+                                   logTlmReaderValue_t **ppValues) {
+    static const struct {
+        const char *pName;
+        LogTlmReaderType type;
+        size_t size;
+    } types[] = {
+        {"i8", LogTlmReaderType_I8, 1},    {"u8", LogTlmReaderType_U8, 1},
+        {"i16", LogTlmReaderType_I16, 2},  {"u16", LogTlmReaderType_U16, 2},
+        {"i32", LogTlmReaderType_I32, 4},  {"u32", LogTlmReaderType_U32, 4},
+        {"i64", LogTlmReaderType_I64, 8},  {"u64", LogTlmReaderType_U64, 8},
+        {"f32", LogTlmReaderType_F32, 4},  {"f64", LogTlmReaderType_F64, 8},
+    };
+    const int numType = sizeof(types) / sizeof(types[0]);
+
+    char *pCopy = strdup(pTypes);
+    if (pCopy == NULL) {
+        return -1;
+    }
+
+    logTlmReaderValue_t *pValues = NULL;
+    int numValue = 0;
+    size_t sizeTotal = 0;
+
+    char *pSave = NULL;
+    char *pToken = strtok_r(pCopy, ",", &pSave);
+    while (pToken != NULL) {
+        logTlmReaderValue_t value = {LogTlmReaderType_Pad, 0};
+        long count = 1;
+        char *pEnd = NULL;
+
+        if (strncmp(pToken, "pad", 3) == 0) {
+            value.size = strtol(pToken + 3, &pEnd, 10);
+        } else {
+            int idx;
+            for (idx = 0; idx < numType; idx++) {
+                size_t length = strlen(types[idx].pName);
+                if ((strncmp(pToken, types[idx].pName, length) == 0) &&
+                    ((pToken[length] == '\0') || (pToken[length] == 'x'))) {
+                    value.type = types[idx].type;
+                    value.size = types[idx].size;
+                    pEnd = pToken + length;
+                    break;
+                }
+            }
+
+            if ((pEnd != NULL) && (*pEnd == 'x')) {
+                count = strtol(pEnd + 1, &pEnd, 10);
+            }
+        }
+
+        if ((pEnd == NULL) || (*pEnd != '\0') || (value.size == 0) ||
+            (count <= 0)) {
+            syslog(LOG_ERR, "Invalid type of the CSV export: %s.", pToken);
+            free(pValues);
+            free(pCopy);
+            return -1;
+        }
+
+        // The padding is one value
+        if (value.type == LogTlmReaderType_Pad) {
+            count = 1;
+        }
+
+        logTlmReaderValue_t *pValuesNew = (logTlmReaderValue_t *)realloc(
+            pValues, (numValue + count) * sizeof(logTlmReaderValue_t));
+        if (pValuesNew == NULL) {
+            free(pValues);
+            free(pCopy);
+            return -1;
+        }
+        pValues = pValuesNew;
+
+        long idx;
+        for (idx = 0; idx < count; idx++) {
+            pValues[numValue++] = value;
+        }
+        sizeTotal += count * value.size;
+
+        pToken = strtok_r(NULL, ",", &pSave);
+    }
+
+    free(pCopy);
+
+    if ((numValue == 0) || (sizeTotal > sizeElement)) {
+        syslog(LOG_ERR, "The types of the CSV export do not fit the record.");
+        free(pValues);
+        return -1;
+    }
+
+    *ppValues = pValues;
+
+    return numValue;
+}
+
+// Write the value of record to the CSV file.
+static void logTlmReader_writeValue(FILE *pFile, const uint8_t *pData,
+                                    LogTlmReaderType type) {
+    union {
+        int8_t i8;
+        uint8_t u8;
+        int16_t i16;
+        uint16_t u16;
+        int32_t i32;
+        uint32_t u32;
+        int64_t i64;
+        uint64_t u64;
+        float f32;
+        double f64;
+    } value;
+
+    switch (type) {
+    case LogTlmReaderType_I8:
+        memcpy(&value.i8, pData, sizeof(value.i8));
+        fprintf(pFile, ",%" PRId8, value.i8);
+        break;
+    case LogTlmReaderType_U8:
+        memcpy(&value.u8, pData, sizeof(value.u8));
+        fprintf(pFile, ",%" PRIu8, value.u8);
+        break;
+    case LogTlmReaderType_I16:
+        memcpy(&value.i16, pData, sizeof(value.i16));
+        fprintf(pFile, ",%" PRId16, value.i16);
+        break;
+    case LogTlmReaderType_U16:
+        memcpy(&value.u16, pData, sizeof(value.u16));
+        fprintf(pFile, ",%" PRIu16, value.u16);
+        break;
+    case LogTlmReaderType_I32:
+        memcpy(&value.i32, pData, sizeof(value.i32));
+        fprintf(pFile, ",%" PRId32, value.i32);
+        break;
+    case LogTlmReaderType_U32:
+        memcpy(&value.u32, pData, sizeof(value.u32));
+        fprintf(pFile, ",%" PRIu32, value.u32);
+        break;
+    case LogTlmReaderType_I64:
+        memcpy(&value.i64, pData, sizeof(value.i64));
+        fprintf(pFile, ",%" PRId64, value.i64);
+        break;
+    case LogTlmReaderType_U64:
+        memcpy(&value.u64, pData, sizeof(value.u64));
+        fprintf(pFile, ",%" PRIu64, value.u64);
+        break;
+    case LogTlmReaderType_F32:
+        memcpy(&value.f32, pData, sizeof(value.f32));
+        fprintf(pFile, ",%.9g", value.f32);
+        break;
+    case LogTlmReaderType_F64:
+        memcpy(&value.f64, pData, sizeof(value.f64));
+        fprintf(pFile, ",%.17g", value.f64);
+        break;
+    default:
+        break;
+    }
+}
+
+long logTlmReader_exportCsv(logTlmReader_handle_t pReader, FILE *pFile,
+                            const char *pTypes) {
+
+    logTlmReaderValue_t *pValues = NULL;
+    int numValue = 0;
+    if (pTypes != NULL) {
+        numValue =
+            logTlmReader_parseTypes(pTypes, pReader->sizeElement, &pValues);
+        if (numValue < 0) {
+            return -1;
+        }
+    }
+
+    // Header
+    fprintf(pFile, "time_ns");
+    if (pReader->isRecordHeader) {
+        fprintf(pFile, ",sequence");
+    }
+
+    if (pTypes == NULL) {
+        fprintf(pFile, ",data");
+    }
+
+    int idx, idxColumn = 0;
+    for (idx = 0; idx < numValue; idx++) {
+        if (pValues[idx].type != LogTlmReaderType_Pad) {
+            fprintf(pFile, ",value%d", idxColumn++);
+        }
+    }
+    fprintf(pFile, "\n");
+
+    long count = 0;
+    const void *pRecord = NULL;
+    int64_t timeNs = 0;
+    int status;
+    while ((status = logTlmReader_next(pReader, &pRecord, &timeNs)) == 1) {
+        const uint8_t *pData = (const uint8_t *)pRecord;
+        fprintf(pFile, "%" PRId64, timeNs);
+        if (pReader->isRecordHeader) {
+            if (pReader->isHeaderValid) {
+                fprintf(pFile, ",%" PRIu64, pReader->header.sequence);
+            } else {
+                fprintf(pFile, ",");
+            }
+        }
+
+        if (pTypes == NULL) {
+            fprintf(pFile, ",");
+
+            size_t idxByte;
+            for (idxByte = 0; idxByte < pReader->sizeElement; idxByte++) {
+                fprintf(pFile, "%02x", pData[idxByte]);
+            }
+        }
+
+        for (idx = 0; idx < numValue; idx++) {
+            logTlmReader_writeValue(pFile, pData, pValues[idx].type);
+            pData += pValues[idx].size;
+        }
+
+        fprintf(pFile, "\n");
+        count++;
+    }
+
+    free(pValues);
+
+    return (status == 0) ? count : -1;
+}
+
+long logTlmReader_replay(logTlmReader_handle_t pReader, double speed,
+                         long periodInNs, logTlmReaderSink_t sink,
+                         void *pUser) {
+
+    struct timespec timeStart;
+    clock_gettime(CLOCK_MONOTONIC, &timeStart);
+
+    long count = 0;
+    int64_t timeFirstNs = 0;
+    bool isFirst = true;
+
+    const void *pRecord = NULL;
+    int64_t timeNs = 0;
+    int status;
+    while ((status = logTlmReader_next(pReader, &pRecord, &timeNs)) == 1) {
+        if (speed > 0) {
+            if (isFirst) {
+                timeFirstNs = timeNs;
+                isFirst = false;
+            }
+
+            // Time from the start of replay
+            double delayNs = pReader->isTimeValid
+                                 ? (double)(timeNs - timeFirstNs)
+                                 : (double)count * periodInNs;
+            int64_t targetNs = timeStart.tv_sec * 1000000000LL +
+                               timeStart.tv_nsec + (int64_t)(delayNs / speed);
+
+            struct timespec timeTarget;
+            timeTarget.tv_sec = targetNs / 1000000000LL;
+            timeTarget.tv_nsec = targetNs % 1000000000LL;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &timeTarget,
+                                   NULL) == EINTR) {
+            }
+        }
+
+        if (sink(pUser, pRecord, pReader->sizeElement) != 0) {
+            syslog(LOG_ERR, "Fail to replay the telemetry record %ld.", count);
+            return -1;
+        }
+
+        count++;
+    }
+
+    return (status == 0) ? count : -1;
+}
@@ -0,0 +1,432 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logTlm.h"
+#include "logTlmRetention.h"
+
+// Rotated file in the retention
+typedef struct {
+    // The file exists or not
+    bool isExist;
+    int64_t size;
+    time_t timeModified;
+} logTlmRetentionFile_t;
+
+// Get the filename of the rotated file with "id". The user needs to free the
+// returned memory.
+static char *logTlmRetention_getFilename(const char *filename, int id) {
+    size_t size = strlen(filename) + 16;
+    char *pName = (char *)malloc(size);
+    if (pName != NULL) {
+        snprintf(pName, size, "%s.%d", filename, id);
+    }
+
+    return pName;
+}
+
+// Encode the "numRecord" values of "sizeElement" bytes in "pSrc" to "pDst" if
+// it becomes smaller. Otherwise, they are copied as they are.
+// Return the size of data in "pDst".
+static size_t logTlmRetention_encode(const uint8_t *pSrc, int numRecord,
+                                     size_t sizeElement, uint8_t *pDst) {
+    size_t sizeRaw = numRecord * sizeElement;
+    if (sizeRaw == 0) {
+        return 0;
+    }
+
+    long sizeEncoded = logTlmCodec_encode(LogTlmCodec_XorShuffle,
+                                          (void *)pSrc, numRecord,
+                                          sizeElement, pDst, sizeRaw - 1);
+    if (sizeEncoded >= 0) {
+        return sizeEncoded;
+    }
+
+    memcpy(pDst, pSrc, sizeRaw);
+
+    return sizeRaw;
+}
+
+// Encode the data of block. The data is not changed if it is encoded
+// already.
+// Return the size of encoded data in "pDst". Otherwise, 0 if the data is
+// corrupted.
+static size_t logTlmRetention_encodeBlock(const logTlmFileHeader_t *pHeader,
+                                          const logTlmField_t *pFields,
+                                          const logTlmBlockHeader_t *pBlock,
+                                          const uint8_t *pData,
+                                          uint8_t *pDst) {
+    // Row layout
+    if (pHeader->numField == 0) {
+        if (pBlock->sizeData != pBlock->numRecord * pHeader->sizeElement) {
+            memcpy(pDst, pData, pBlock->sizeData);
+            return pBlock->sizeData;
+        }
+
+        return logTlmRetention_encode(pData, pBlock->numRecord,
+                                      pHeader->sizeElement, pDst);
+    }
+
+    // Columnar layout with the size of each column at the beginning
+    size_t sizeSizes = pHeader->numField * sizeof(uint32_t);
+    if (pBlock->sizeData < sizeSizes) {
+        return 0;
+    }
+
+    size_t offsetSrc = sizeSizes;
+    size_t offsetDst = sizeSizes;
+    uint32_t idx;
+    for (idx = 0; idx < pHeader->numField; idx++) {
+        uint32_t sizeColumn;
+        memcpy(&sizeColumn, pData + idx * sizeof(uint32_t), sizeof(uint32_t));
+        if (offsetSrc + sizeColumn > pBlock->sizeData) {
+            return 0;
+        }
+
+        uint32_t sizeEncoded = sizeColumn;
+        if (sizeColumn == pBlock->numRecord * pFields[idx].size) {
+            sizeEncoded = logTlmRetention_encode(
+                pData + offsetSrc, pBlock->numRecord, pFields[idx].size,
+                pDst + offsetDst);
+        } else {
+            memcpy(pDst + offsetDst, pData + offsetSrc, sizeColumn);
+        }
+
+        memcpy(pDst + idx * sizeof(uint32_t), &sizeEncoded, sizeof(uint32_t));
+
+        offsetSrc += sizeColumn;
+        offsetDst += sizeEncoded;
+    }
+
+    return offsetDst;
+}
+
+// Write the compressed file of the mapped container file to "pFile".
+// Return 0 if success. Otherwise, -1.
+static int logTlmRetention_writeCompressed(const uint8_t *pMap,
+                                           size_t offsetBlock,
+                                           const logTlmFileFooter_t *pFooter,
+                                           FILE *pFile) {
+
+    logTlmFileHeader_t header;
+    memcpy(&header, pMap, sizeof(header));
+    const logTlmField_t *pFields =
+        (const logTlmField_t *)(pMap + sizeof(header));
+
+    // The fields are only in the columnar layout
+    header.codec = LogTlmCodec_XorShuffle;
+    if ((fwrite(&header, sizeof(header), 1, pFile) != 1) ||
+        ((header.numField > 0) &&
+         (fwrite(pFields, header.numField * sizeof(logTlmField_t), 1,
+                 pFile) != 1))) {
+        return -1;
+    }
+
+    logTlmIndexEntry_t *pIndex = (logTlmIndexEntry_t *)calloc(
+        pFooter->numBlock + 1, sizeof(logTlmIndexEntry_t));
+    uint8_t *pEncoded = NULL;
+    size_t sizeEncodedMax = 0;
+    if (pIndex == NULL) {
+        return -1;
+    }
+
+    int status = 0;
+    int64_t offset = offsetBlock;
+    uint64_t idx;
+    for (idx = 0; (status == 0) && (idx < pFooter->numBlock); idx++) {
+        memcpy(&pIndex[idx],
+               pMap + pFooter->offsetIndex + idx * sizeof(logTlmIndexEntry_t),
+               sizeof(logTlmIndexEntry_t));
+
+        // The block should be before the index
+        logTlmBlockHeader_t block;
+        if ((pIndex[idx].offset < (int64_t)offsetBlock) ||
+            (pIndex[idx].offset + sizeof(block) > pFooter->offsetIndex)) {
+            status = -1;
+            break;
+        }
+
+        memcpy(&block, pMap + pIndex[idx].offset, sizeof(block));
+        if (pIndex[idx].offset + sizeof(block) + block.sizeData >
+            pFooter->offsetIndex) {
+            status = -1;
+            break;
+        }
+
+        const uint8_t *pData = pMap + pIndex[idx].offset + sizeof(block);
+
+        // The encoded data is not larger than the original one
+        if (sizeEncodedMax < block.sizeData) {
+            free(pEncoded);
+            sizeEncodedMax = block.sizeData;
+            pEncoded = (uint8_t *)malloc(sizeEncodedMax);
+            if (pEncoded == NULL) {
+                status = -1;
+                break;
+            }
+        }
+
+        size_t sizeData = logTlmRetention_encodeBlock(&header, pFields,
+                                                      &block, pData, pEncoded);
+        if ((sizeData == 0) && (block.sizeData != 0)) {
+            status = -1;
+            break;
+        }
+
+        block.sizeData = sizeData;
+        pIndex[idx].offset = offset;
+        if ((fwrite(&block, sizeof(block), 1, pFile) != 1) ||
+            ((sizeData > 0) && (fwrite(pEncoded, sizeData, 1, pFile) != 1))) {
+            status = -1;
+        }
+
+        offset += sizeof(block) + sizeData;
+    }
+
+    logTlmFileFooter_t footer = *pFooter;
+    footer.offsetIndex = offset;
+    if ((status == 0) &&
+        (((footer.numBlock > 0) &&
+          (fwrite(pIndex, footer.numBlock * sizeof(logTlmIndexEntry_t), 1,
+                  pFile) != 1)) ||
+         (fwrite(&footer, sizeof(footer), 1, pFile) != 1))) {
+        status = -1;
+    }
+
+    free(pEncoded);
+    free(pIndex);
+
+    return status;
+}
+
+// Check the mapped file is a closed container file with LogTlmCodec_None.
+// Return the offset of the first block. Otherwise, 0.
+static size_t logTlmRetention_checkFile(const uint8_t *pMap, size_t size,
+                                        logTlmFileFooter_t *pFooter) {
+
+    logTlmFileHeader_t header;
+    if (size < sizeof(header) + sizeof(logTlmFileFooter_t)) {
+        return 0;
+    }
+
+    memcpy(&header, pMap, sizeof(header));
+    if ((memcmp(header.magic, LOGTLM_FILE_MAGIC, sizeof(header.magic)) != 0) ||
+        (header.version != LOGTLM_FILE_VERSION) ||
+        (header.codec != LogTlmCodec_None) || (header.sizeElement == 0)) {
+        return 0;
+    }
+
+    size_t offsetBlock =
+        sizeof(header) + header.numField * sizeof(logTlmField_t);
+
+    memcpy(pFooter, pMap + size - sizeof(logTlmFileFooter_t),
+           sizeof(logTlmFileFooter_t));
+
+    size_t sizeIndex = pFooter->numBlock * sizeof(logTlmIndexEntry_t);
+    if ((memcmp(pFooter->magic, LOGTLM_INDEX_MAGIC, sizeof(pFooter->magic)) !=
+         0) ||
+        (pFooter->offsetIndex < offsetBlock) ||
+        (pFooter->offsetIndex + sizeIndex + sizeof(logTlmFileFooter_t) !=
+         size)) {
+        return 0;
+    }
+
+    return offsetBlock;
+}
+
+int logTlmRetention_compressFile(const char *path) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat info;
+    memset(&info, 0, sizeof(info));
+
+    uint8_t *pMap = MAP_FAILED;
+    if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+        pMap = (uint8_t *)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd,
+                               0);
+    }
+    close(fd);
+
+    if (pMap == MAP_FAILED) {
+        return (info.st_size == 0) ? 1 : -1;
+    }
+
+    logTlmFileFooter_t footer;
+    size_t offsetBlock = logTlmRetention_checkFile(pMap, info.st_size, &footer);
+    if (offsetBlock == 0) {
+        munmap(pMap, info.st_size);
+        return 1;
+    }
+
+    size_t sizeName = strlen(path) + 8;
+    char *pNameTmp = (char *)malloc(sizeName);
+    FILE *pFile = NULL;
+    if (pNameTmp != NULL) {
+        snprintf(pNameTmp, sizeName, "%s.tmp", path);
+        pFile = fopen(pNameTmp, "w");
+    }
+
+    int status = -1;
+    if (pFile != NULL) {
+        status = logTlmRetention_writeCompressed(pMap, offsetBlock, &footer,
+                                                 pFile);
+
+        // The compressed file should be on the disk before the original one
+        // is replaced
+        if ((fflush(pFile) != 0) || (fdatasync(fileno(pFile)) != 0)) {
+            status = -1;
+        }
+
+        struct timespec times[2] = {info.st_atim, info.st_mtim};
+        futimens(fileno(pFile), times);
+
+        if (fclose(pFile) != 0) {
+            status = -1;
+        }
+
+        if ((status == 0) && (rename(pNameTmp, path) != 0)) {
+            status = -1;
+        }
+
+        if (status != 0) {
+            unlink(pNameTmp);
+        }
+    }
+
+    if (status != 0) {
+        syslog(LOG_ERR, "Failed to compress the telemetry file: %s.", path);
+    }
+
+    free(pNameTmp);
+    munmap(pMap, info.st_size);
+
+    return status;
+}
+
+// Delete the rotated file.
+static void logTlmRetention_deleteFile(const char *filename, int id,
+                                       logTlmRetentionFile_t *pFile,
+                                       logTlmRetentionAccount_t *pAccount) {
+    char *pName = logTlmRetention_getFilename(filename, id);
+    if ((pName == NULL) || (unlink(pName) != 0)) {
+        syslog(LOG_ERR, "Failed to delete the telemetry file: %s.%d.",
+               filename, id);
+    } else {
+        pFile->isExist = false;
+        pAccount->numFileDeleted += 1;
+    }
+
+    free(pName);
+}
+
+// Get the total size of the rotated files.
+static int64_t logTlmRetention_getSize(logTlmRetentionFile_t *pFiles,
+                                       int num) {
+    int64_t size = 0;
+    int idx;
+    for (idx = 0; idx < num; idx++) {
+        if (pFiles[idx].isExist) {
+            size += pFiles[idx].size;
+        }
+    }
+
+    return size;
+}
+
+int logTlmRetention_apply(const char *filename, int idOldest, int idNewest,
+                          const logTlmRetention_t *pRetention,
+                          logTlmRetentionAccount_t *pAccount) {
+
+    pAccount->numFile = 0;
+    pAccount->size = 0;
+
+    int num = idNewest - idOldest + 1;
+    if (num <= 0) {
+        return idOldest;
+    }
+
+    logTlmRetentionFile_t *pFiles =
+        (logTlmRetentionFile_t *)calloc(num, sizeof(logTlmRetentionFile_t));
+    if (pFiles == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the memory of telemetry "
+                        "retention.");
+        return idOldest;
+    }
+
+    int idx;
+    for (idx = 0; idx < num; idx++) {
+        char *pName = logTlmRetention_getFilename(filename, idOldest + idx);
+
+        struct stat info;
+        if ((pName != NULL) && (stat(pName, &info) == 0)) {
+            pFiles[idx].isExist = true;
+            pFiles[idx].size = info.st_size;
+            pFiles[idx].timeModified = info.st_mtime;
+        }
+
+        free(pName);
+    }
+
+    // Age
+    time_t timeCurrent = time(NULL);
+    for (idx = 0; (pRetention->ageMaxInSec > 0) && (idx < num); idx++) {
+        if (pFiles[idx].isExist && ((timeCurrent - pFiles[idx].timeModified) >
+                                    pRetention->ageMaxInSec)) {
+            logTlmRetention_deleteFile(filename, idOldest + idx, &pFiles[idx],
+                                       pAccount);
+        }
+    }
+
+    // Compress the oldest files first to keep the history
+    int64_t size = logTlmRetention_getSize(pFiles, num);
+    for (idx = 0; (pRetention->sizeMax > 0) && pRetention->isCompressed &&
+                  (size > pRetention->sizeMax) && (idx < num);
+         idx++) {
+        char *pName = logTlmRetention_getFilename(filename, idOldest + idx);
+
+        struct stat info;
+        if (pFiles[idx].isExist && (pName != NULL) &&
+            (logTlmRetention_compressFile(pName) == 0) &&
+            (stat(pName, &info) == 0)) {
+            size -= pFiles[idx].size - info.st_size;
+            pFiles[idx].size = info.st_size;
+            pAccount->numFileCompressed += 1;
+        }
+
+        free(pName);
+    }
+
+    // Delete the oldest files
+    for (idx = 0; (pRetention->sizeMax > 0) && (size > pRetention->sizeMax) &&
+                  (idx < num);
+         idx++) {
+        if (pFiles[idx].isExist) {
+            logTlmRetention_deleteFile(filename, idOldest + idx, &pFiles[idx],
+                                       pAccount);
+            size -= pFiles[idx].isExist ? 0 : pFiles[idx].size;
+        }
+    }
+
+    int idOldestLeft = idNewest + 1;
+    for (idx = num - 1; idx >= 0; idx--) {
+        if (pFiles[idx].isExist) {
+            pAccount->numFile += 1;
+            pAccount->size += pFiles[idx].size;
+            idOldestLeft = idOldest + idx;
+        }
+    }
+
+    free(pFiles);
+
+    return idOldestLeft;
+}
@@ -0,0 +1,341 @@
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "rtMemory.h"
+
+// Bit shift of the size of huge page in the flags of mmap()
+#define RTMEMORY_SHIFT_HUGEPAGE 21
+
+// Mapping of the pre-faulted and locked memory, or the heap memory
+typedef struct {
+    // Start of the heap memory or mapping
+    uint8_t *pBase;
+    // Size of the mapping in bytes. 0 if the memory is from the heap.
+    size_t sizeMap;
+    bool isHugepage;
+    bool isLocked;
+} rtMemoryMap_t;
+
+// Locked page shared by the small allocations, which is at the start of the
+// page. It is unmapped when all its allocations are freed.
+typedef struct {
+    rtMemoryMap_t map;
+    // Offset of the free space in bytes
+    size_t offset;
+    // Number of the allocations in use
+    int numAlloc;
+} rtMemoryArena_t;
+
+// Header before the allocated memory
+typedef struct {
+    // Memory of its own
+    rtMemoryMap_t map;
+    // Arena that has the memory. NULL if the memory has its own.
+    rtMemoryArena_t *pArena;
+} rtMemoryHeader_t;
+
+// Allocation policy of the process
+static atomic_int policyProcess = RtMemoryPolicy_Default;
+
+// Statistics of the allocator
+static atomic_llong sizeLocked = 0;
+static atomic_llong sizeHugepage = 0;
+static atomic_long numLockFailed = 0;
+
+// Arena of the next small allocation in the locked policy. NULL if there is
+// none. (critical section)
+static rtMemoryArena_t *pArenaCurrent = NULL;
+
+// Lock of the arenas
+static pthread_mutex_t lockArena = PTHREAD_MUTEX_INITIALIZER;
+
+int rtMemory_setPolicy(RtMemoryPolicy policy) {
+    if ((policy != RtMemoryPolicy_Default) &&
+        (policy != RtMemoryPolicy_Locked)) {
+        syslog(LOG_ERR, "Unknown policy of memory allocation: %d.", policy);
+        return -1;
+    }
+
+    atomic_store(&policyProcess, policy);
+
+    return 0;
+}
+
+RtMemoryPolicy rtMemory_getPolicy(void) {
+    return (RtMemoryPolicy)atomic_load(&policyProcess);
+}
+
+// Round up the size to the multiple of "unit".
+static size_t rtMemory_roundUp(size_t size, size_t unit) {
+    return (size + unit - 1) / unit * unit;
+}
+
+// Map the memory of at least "size" bytes on the huge pages if possible.
+// Otherwise, on the normal pages.
+// Return the mapping and the size of it in "pSizeMap". Otherwise, MAP_FAILED.
+static void *rtMemory_map(size_t size, size_t *pSizeMap, bool *pIsHugepage) {
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+    // The huge pages are only worth it for the big allocation
+    void *pMap = MAP_FAILED;
+    if (size >= RTMEMORY_SIZE_HUGEPAGE) {
+        *pSizeMap = rtMemory_roundUp(size, RTMEMORY_SIZE_HUGEPAGE);
+        pMap = mmap(NULL, *pSizeMap, PROT_READ | PROT_WRITE,
+                    flags | MAP_HUGETLB |
+                        (RTMEMORY_SHIFT_HUGEPAGE << MAP_HUGE_SHIFT),
+                    -1, 0);
+    }
+
+    *pIsHugepage = (pMap != MAP_FAILED);
+    if (*pIsHugepage) {
+        return pMap;
+    }
+
+    // No huge page is reserved
+    *pSizeMap = rtMemory_roundUp(size, sysconf(_SC_PAGESIZE));
+    pMap = mmap(NULL, *pSizeMap, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if ((pMap != MAP_FAILED) && (*pSizeMap >= RTMEMORY_SIZE_HUGEPAGE)) {
+        madvise(pMap, *pSizeMap, MADV_HUGEPAGE);
+    }
+
+    return pMap;
+}
+
+// Map the pre-faulted and locked memory of at least "size" bytes.
+// Return 0 and the mapping in "pMapLocked" if success. Otherwise, -1.
+static int rtMemory_mapLocked(size_t size, rtMemoryMap_t *pMapLocked) {
+
+    size_t sizeMap = 0;
+    bool isHugepage = false;
+    uint8_t *pMap = (uint8_t *)rtMemory_map(size, &sizeMap, &isHugepage);
+    if (pMap == MAP_FAILED) {
+        return -1;
+    }
+
+    // Place the pages on the NUMA node of the calling thread when they are
+    // faulted. This fails if the kernel does not support NUMA, which is fine.
+    syscall(SYS_mbind, pMap, sizeMap, MPOL_LOCAL, NULL, 0, 0);
+
+    // Write each page, so it is not the shared zero page
+    size_t sizePage = isHugepage ? RTMEMORY_SIZE_HUGEPAGE
+                                 : (size_t)sysconf(_SC_PAGESIZE);
+    size_t offset;
+    for (offset = 0; offset < sizeMap; offset += sizePage) {
+        ((volatile uint8_t *)pMap)[offset] = 0;
+    }
+
+    bool isLocked = (mlock(pMap, sizeMap) == 0);
+    if (isLocked) {
+        atomic_fetch_add(&sizeLocked, sizeMap);
+    } else {
+        atomic_fetch_add(&numLockFailed, 1);
+        syslog(LOG_WARNING, "Failed to lock the memory of %zu bytes. Check "
+                            "the RLIMIT_MEMLOCK.",
+               sizeMap);
+    }
+
+    if (isHugepage) {
+        atomic_fetch_add(&sizeHugepage, sizeMap);
+    }
+
+    pMapLocked->pBase = pMap;
+    pMapLocked->sizeMap = sizeMap;
+    pMapLocked->isHugepage = isHugepage;
+    pMapLocked->isLocked = isLocked;
+
+    return 0;
+}
+
+// Unmap the memory mapped by rtMemory_mapLocked().
+static void rtMemory_unmapLocked(rtMemoryMap_t *pMapLocked) {
+
+    if (pMapLocked->isLocked) {
+        atomic_fetch_sub(&sizeLocked, pMapLocked->sizeMap);
+    }
+
+    if (pMapLocked->isHugepage) {
+        atomic_fetch_sub(&sizeHugepage, pMapLocked->sizeMap);
+    }
+
+    // The memory is unlocked by the unmapping
+    munmap(pMapLocked->pBase, pMapLocked->sizeMap);
+}
+
+// Get the header before the memory aligned to "alignment" after "address".
+static rtMemoryHeader_t *rtMemory_getHeader(uintptr_t address,
+                                            size_t alignment) {
+    uintptr_t addressAligned =
+        rtMemory_roundUp(address + sizeof(rtMemoryHeader_t), alignment);
+
+    return (rtMemoryHeader_t *)(addressAligned - sizeof(rtMemoryHeader_t));
+}
+
+// Allocate the small memory from the arena, so the small objects share the
+// locked pages instead of locking a page each against the RLIMIT_MEMLOCK.
+// Return the header of memory. Otherwise, NULL.
+static rtMemoryHeader_t *rtMemory_allocArena(size_t size, size_t alignment) {
+
+    if (pthread_mutex_lock(&lockArena) != 0) {
+        return NULL;
+    }
+
+    // Use a new arena if there is no room
+    rtMemoryHeader_t *pHeader = NULL;
+    if (pArenaCurrent != NULL) {
+        pHeader = rtMemory_getHeader(
+            (uintptr_t)pArenaCurrent + pArenaCurrent->offset, alignment);
+        if (((uintptr_t)(pHeader + 1) + size) >
+            ((uintptr_t)pArenaCurrent + pArenaCurrent->map.sizeMap)) {
+            pHeader = NULL;
+        }
+    }
+
+    rtMemoryMap_t map;
+    if ((pHeader == NULL) &&
+        (rtMemory_mapLocked(sysconf(_SC_PAGESIZE), &map) == 0)) {
+        // The old arena is unmapped by the free of its last allocation
+        pArenaCurrent = (rtMemoryArena_t *)map.pBase;
+        pArenaCurrent->map = map;
+        pArenaCurrent->offset = sizeof(rtMemoryArena_t);
+        pArenaCurrent->numAlloc = 0;
+
+        pHeader = rtMemory_getHeader(
+            (uintptr_t)pArenaCurrent + pArenaCurrent->offset, alignment);
+    }
+
+    if (pHeader != NULL) {
+        memset(&pHeader->map, 0, sizeof(pHeader->map));
+        pHeader->pArena = pArenaCurrent;
+
+        pArenaCurrent->numAlloc += 1;
+        pArenaCurrent->offset =
+            (uintptr_t)(pHeader + 1) + size - (uintptr_t)pArenaCurrent;
+    }
+
+    pthread_mutex_unlock(&lockArena);
+
+    return pHeader;
+}
+
+// Free the memory in the arena. The arena is unmapped if it is empty.
+static void rtMemory_freeArena(rtMemoryArena_t *pArena) {
+
+    if (pthread_mutex_lock(&lockArena) != 0) {
+        return;
+    }
+
+    pArena->numAlloc -= 1;
+    if (pArena->numAlloc == 0) {
+        if (pArena == pArenaCurrent) {
+            pArenaCurrent = NULL;
+        }
+
+        // The arena is in the mapping
+        rtMemoryMap_t map = pArena->map;
+        rtMemory_unmapLocked(&map);
+    }
+
+    pthread_mutex_unlock(&lockArena);
+}
+
+// Allocate the pre-faulted and locked memory. The small memory that fits in
+// the half of a page is from the arena.
+// Return the header of memory. Otherwise, NULL.
+static rtMemoryHeader_t *rtMemory_allocLocked(size_t size, size_t alignment) {
+
+    size_t sizeAlloc = sizeof(rtMemoryHeader_t) + alignment - 1 + size;
+    if (sizeAlloc <= ((size_t)sysconf(_SC_PAGESIZE) / 2)) {
+        return rtMemory_allocArena(size, alignment);
+    }
+
+    rtMemoryMap_t map;
+    if (rtMemory_mapLocked(sizeAlloc, &map) != 0) {
+        return NULL;
+    }
+
+    rtMemoryHeader_t *pHeader =
+        rtMemory_getHeader((uintptr_t)map.pBase, alignment);
+    pHeader->map = map;
+    pHeader->pArena = NULL;
+
+    return pHeader;
+}
+
+// Allocate the memory from the heap.
+// Return the header of memory. Otherwise, NULL.
+static rtMemoryHeader_t *rtMemory_allocHeap(size_t size, size_t alignment) {
+
+    // Leave the room for the header and alignment
+    uint8_t *pBase =
+        (uint8_t *)calloc(1, sizeof(rtMemoryHeader_t) + alignment - 1 + size);
+    if (pBase == NULL) {
+        return NULL;
+    }
+
+    rtMemoryHeader_t *pHeader =
+        rtMemory_getHeader((uintptr_t)pBase, alignment);
+    memset(&pHeader->map, 0, sizeof(pHeader->map));
+    pHeader->map.pBase = pBase;
+    pHeader->pArena = NULL;
+
+    return pHeader;
+}
+
+void *rtMemory_alloc(size_t size) {
+    return rtMemory_allocAligned(size, RTMEMORY_ALIGNMENT);
+}
+
+void *rtMemory_allocAligned(size_t size, size_t alignment) {
+
+    if ((alignment < RTMEMORY_ALIGNMENT) ||
+        ((alignment & (alignment - 1)) != 0)) {
+        syslog(LOG_ERR, "Alignment of memory should be a power of 2 and >= "
+                        "%d: %zu.",
+               RTMEMORY_ALIGNMENT, alignment);
+        return NULL;
+    }
+
+    rtMemoryHeader_t *pHeader = NULL;
+    if (rtMemory_getPolicy() == RtMemoryPolicy_Locked) {
+        pHeader = rtMemory_allocLocked(size, alignment);
+    } else {
+        pHeader = rtMemory_allocHeap(size, alignment);
+    }
+
+    if (pHeader == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the memory of %zu bytes.", size);
+        return NULL;
+    }
+
+    return pHeader + 1;
+}
+
+void rtMemory_free(void *pMemory) {
+    if (pMemory == NULL) {
+        return;
+    }
+
+    rtMemoryHeader_t *pHeader = (rtMemoryHeader_t *)pMemory - 1;
+    if (pHeader->pArena != NULL) {
+        rtMemory_freeArena(pHeader->pArena);
+    } else if (pHeader->map.sizeMap == 0) {
+        free(pHeader->map.pBase);
+    } else {
+        rtMemory_unmapLocked(&pHeader->map);
+    }
+}
+
+void rtMemory_getStats(rtMemoryStats_t *pStats) {
+    pStats->sizeLocked = atomic_load(&sizeLocked);
+    pStats->sizeHugepage = atomic_load(&sizeHugepage);
+    pStats->numLockFailed = atomic_load(&numLockFailed);
+}
@@ -1,4 +1,7 @@
+#include <string>
+#include <string.h>
 #include <syslog.h>
+#include <time.h>
 
 #include "gtest/gtest.h"
 
@@ -6,13 +9,13 @@ extern "C" {
 #include "circular_buffer.h"
 }
 
-struct CircularBufferTest : testing::Test {
+struct CircularBufferTest : testing::TestWithParam<CircularBufMode> {
 
     int bufferSize = 5;
     cbuf_handle_t cbuf;
 
     CircularBufferTest() {
-        cbuf = circular_buf_init(bufferSize);
+        cbuf = circular_buf_init_mode(bufferSize, GetParam());
 
         openlog("CircularBuffer", LOG_CONS, LOG_SYSLOG);
     }
@@ -26,6 +29,18 @@ struct CircularBufferTest : testing::Test {
 
 TEST(CircularBuffer, circularBufInit) {
     EXPECT_EQ(nullptr, circular_buf_init(0));
+    EXPECT_EQ(nullptr, circular_buf_init_mode(0, CircularBufMode_Spsc));
+    EXPECT_EQ(nullptr, circular_buf_init_mode(1, (CircularBufMode)0));
+}
+
+TEST(CircularBuffer, circularBufMode) {
+    cbuf_handle_t cbuf = circular_buf_init(1);
+    EXPECT_EQ(CircularBufMode_Mutex, circular_buf_mode(cbuf));
+    circular_buf_free(cbuf);
+
+    cbuf = circular_buf_init_mode(1, CircularBufMode_Spsc);
+    EXPECT_EQ(CircularBufMode_Spsc, circular_buf_mode(cbuf));
+    circular_buf_free(cbuf);
 }
 
 TEST(CircularBuffer, circularBufInitSingleSlot) {
@@ -56,11 +71,82 @@ TEST(CircularBuffer, circularBufInitSingleSlot) {
     circular_buf_free(cbuf);
 }
 
-TEST_F(CircularBufferTest, circularBufCapacity) {
+TEST(CircularBuffer, circularBufIndependent) {
+
+    // Two buffers should not share the storage
+    cbuf_handle_t cbuf1 = circular_buf_init(2);
+    cbuf_handle_t cbuf2 = circular_buf_init(2);
+
+    commandStreamStructure_t data;
+    data.counter = 1;
+    circular_buf_put(cbuf1, data);
+    data.counter = 2;
+    circular_buf_put(cbuf2, data);
+
+    EXPECT_EQ(1, circular_buf_size(cbuf1));
+    EXPECT_EQ(1, circular_buf_size(cbuf2));
+
+    // Free one buffer should not affect the other one
+    circular_buf_free(cbuf1);
+
+    commandStreamStructure_t dataGet;
+    EXPECT_FALSE(circular_buf_get(cbuf2, &dataGet));
+    EXPECT_EQ(2, dataGet.counter);
+
+    circular_buf_free(cbuf2);
+}
+
+TEST(CircularBuffer, circularBufPeekSpscFull) {
+
+    int bufferSize = 3;
+    cbuf_handle_t cbuf =
+        circular_buf_init_mode(bufferSize, CircularBufMode_Spsc);
+
+    commandStreamStructure_t data;
+    int idx;
+    for (idx = 0; idx < bufferSize; idx++) {
+        data.counter = idx;
+        circular_buf_put(cbuf, data);
+    }
+
+    // Hold the oldest one and fill the buffer again
+    commandStreamStructure_t *pDataHeld =
+        (commandStreamStructure_t *)circular_buf_peek(cbuf);
+    EXPECT_EQ(0, pDataHeld->counter);
+
+    data.counter = bufferSize;
+    EXPECT_FALSE(circular_buf_put(cbuf, data));
+
+    // The new data is dropped instead of overwriting the held one
+    commandStreamStructure_t datas[2];
+    data.counter = 99;
+    EXPECT_TRUE(circular_buf_put(cbuf, data));
+    EXPECT_EQ(2, circular_buf_put_n(cbuf, datas, 2));
+    EXPECT_EQ(nullptr, circular_buf_reserve(cbuf));
+
+    EXPECT_EQ(0, pDataHeld->counter);
+    circular_buf_release(cbuf);
+
+    // The old data is dropped after the release
+    commandStreamStructure_t *pData =
+        (commandStreamStructure_t *)circular_buf_reserve(cbuf);
+    ASSERT_NE(nullptr, pData);
+    pData->counter = bufferSize + 1;
+    EXPECT_TRUE(circular_buf_commit(cbuf));
+
+    for (idx = 2; idx < bufferSize + 2; idx++) {
+        EXPECT_FALSE(circular_buf_get(cbuf, &data));
+        EXPECT_EQ(idx, data.counter);
+    }
+
+    circular_buf_free(cbuf);
+}
+
+TEST_P(CircularBufferTest, circularBufCapacity) {
     EXPECT_EQ(bufferSize, circular_buf_capacity(cbuf));
 }
 
-TEST_F(CircularBufferTest, circularBufPut) {
+TEST_P(CircularBufferTest, circularBufPut) {
 
     // There is no lost of data
     bool lostData = false;
@@ -87,7 +173,7 @@ TEST_F(CircularBufferTest, circularBufPut) {
     EXPECT_EQ(1, dataRead.counter);
 }
 
-TEST_F(CircularBufferTest, circularBufGet) {
+TEST_P(CircularBufferTest, circularBufGet) {
 
     // Put the data into buffer
     int idx;
@@ -111,7 +197,7 @@ TEST_F(CircularBufferTest, circularBufGet) {
     EXPECT_TRUE(status);
 }
 
-TEST_F(CircularBufferTest, circularBufSize) {
+TEST_P(CircularBufferTest, circularBufSize) {
 
     EXPECT_EQ(0, circular_buf_size(cbuf));
 
@@ -120,3 +206,397 @@ TEST_F(CircularBufferTest, circularBufSize) {
 
     EXPECT_EQ(1, circular_buf_size(cbuf));
 }
+
+TEST_P(CircularBufferTest, circularBufPutN) {
+
+    commandStreamStructure_t datas[7];
+    int idx;
+    for (idx = 0; idx < 7; idx++) {
+        datas[idx].counter = idx;
+    }
+
+    // No lost of data
+    EXPECT_EQ(0, circular_buf_put_n(cbuf, datas, 3));
+    EXPECT_EQ(3, circular_buf_size(cbuf));
+
+    // There is the lost of data with the wraparound
+    EXPECT_EQ(2, circular_buf_put_n(cbuf, &datas[3], 4));
+    EXPECT_EQ(bufferSize, circular_buf_size(cbuf));
+
+    commandStreamStructure_t dataRead;
+    for (idx = 2; idx < 7; idx++) {
+        circular_buf_get(cbuf, &dataRead);
+        EXPECT_EQ(idx, dataRead.counter);
+    }
+
+    // Put more data than the capacity, only the newest ones are kept
+    EXPECT_EQ(0, circular_buf_put_n(cbuf, datas, 0));
+    EXPECT_EQ(2, circular_buf_put_n(cbuf, datas, 7));
+    EXPECT_EQ(bufferSize, circular_buf_size(cbuf));
+
+    circular_buf_get(cbuf, &dataRead);
+    EXPECT_EQ(2, dataRead.counter);
+}
+
+TEST_P(CircularBufferTest, circularBufGetN) {
+
+    commandStreamStructure_t datasRead[10];
+    EXPECT_EQ(0, circular_buf_get_n(cbuf, datasRead, 10));
+
+    // Move the head and tail to have the wraparound
+    commandStreamStructure_t data;
+    int idx;
+    for (idx = 0; idx < 8; idx++) {
+        data.counter = idx;
+        circular_buf_put(cbuf, data);
+    }
+
+    EXPECT_EQ(0, circular_buf_get_n(cbuf, datasRead, 0));
+    EXPECT_EQ(2, circular_buf_get_n(cbuf, datasRead, 2));
+    EXPECT_EQ(3, datasRead[0].counter);
+    EXPECT_EQ(4, datasRead[1].counter);
+
+    EXPECT_EQ(3, circular_buf_get_n(cbuf, datasRead, 10));
+    for (idx = 0; idx < 3; idx++) {
+        EXPECT_EQ(idx + 5, datasRead[idx].counter);
+    }
+
+    EXPECT_EQ(0, circular_buf_size(cbuf));
+}
+
+TEST_P(CircularBufferTest, circularBufReserveAndCommit) {
+
+    // Write the data in place
+    int idx;
+    for (idx = 0; idx < bufferSize + 1; idx++) {
+        commandStreamStructure_t *pData =
+            (commandStreamStructure_t *)circular_buf_reserve(cbuf);
+        ASSERT_NE(nullptr, pData);
+
+        pData->counter = idx;
+        EXPECT_EQ(idx == bufferSize, circular_buf_commit(cbuf));
+    }
+
+    EXPECT_EQ(bufferSize, circular_buf_size(cbuf));
+
+    // The oldest one is overwritten
+    commandStreamStructure_t dataRead;
+    for (idx = 1; idx < bufferSize + 1; idx++) {
+        circular_buf_get(cbuf, &dataRead);
+        EXPECT_EQ(idx, dataRead.counter);
+    }
+}
+
+TEST_P(CircularBufferTest, circularBufPeekAndRelease) {
+
+    EXPECT_EQ(nullptr, circular_buf_peek(cbuf));
+
+    commandStreamStructure_t data;
+    int idx;
+    for (idx = 0; idx < 3; idx++) {
+        data.counter = idx;
+        circular_buf_put(cbuf, data);
+    }
+
+    // Read the data in place
+    for (idx = 0; idx < 3; idx++) {
+        commandStreamStructure_t *pData =
+            (commandStreamStructure_t *)circular_buf_peek(cbuf);
+        ASSERT_NE(nullptr, pData);
+        EXPECT_EQ(idx, pData->counter);
+
+        circular_buf_release(cbuf);
+    }
+
+    EXPECT_EQ(nullptr, circular_buf_peek(cbuf));
+    EXPECT_EQ(0, circular_buf_size(cbuf));
+}
+
+TEST_P(CircularBufferTest, circularBufPriorityLane) {
+
+    unsigned int cmdStop = 99;
+    EXPECT_EQ(-1, circular_buf_set_priority_lane(cbuf, 0, &cmdStop, 1));
+    EXPECT_EQ(-1, circular_buf_set_priority_lane(cbuf, 2, &cmdStop, 0));
+
+    cbuf_handle_t cbufStatus = circular_buf_init_element(
+        2, sizeof(commandStatusStructure_t), GetParam());
+    EXPECT_EQ(-1, circular_buf_set_priority_lane(cbufStatus, 2, &cmdStop, 1));
+    circular_buf_free(cbufStatus);
+
+    EXPECT_EQ(0, circular_buf_set_priority_lane(cbuf, 2, &cmdStop, 1));
+    EXPECT_EQ(-1, circular_buf_set_priority_lane(cbuf, 2, &cmdStop, 1));
+    EXPECT_EQ(bufferSize + 2, circular_buf_capacity(cbuf));
+
+    // Flood the buffer with the stop command in the middle
+    commandStreamStructure_t data;
+    data.cmd = 1;
+    int idx;
+    for (idx = 0; idx < 3; idx++) {
+        data.counter = idx;
+        circular_buf_put(cbuf, data);
+    }
+
+    data.cmd = cmdStop;
+    data.counter = 100;
+    EXPECT_FALSE(circular_buf_put(cbuf, data));
+
+    commandStreamStructure_t datas[10];
+    for (idx = 0; idx < 10; idx++) {
+        datas[idx].cmd = 1;
+        datas[idx].counter = idx + 3;
+    }
+    datas[4].cmd = cmdStop;
+    datas[4].counter = 101;
+    EXPECT_EQ(3 + 9 - bufferSize, circular_buf_put_n(cbuf, datas, 10));
+
+    EXPECT_EQ(bufferSize + 2, circular_buf_size(cbuf));
+
+    // The stop commands are not overwritten and come first
+    EXPECT_FALSE(circular_buf_get(cbuf, &data));
+    EXPECT_EQ(100, data.counter);
+
+    commandStreamStructure_t *pData =
+        (commandStreamStructure_t *)circular_buf_peek(cbuf);
+    ASSERT_NE(nullptr, pData);
+    EXPECT_EQ(101, pData->counter);
+    circular_buf_release(cbuf);
+
+    // Then the newest other commands
+    EXPECT_EQ(bufferSize, circular_buf_get_n(cbuf, datas, 10));
+    EXPECT_EQ(8, datas[0].counter);
+    EXPECT_EQ(12, datas[bufferSize - 1].counter);
+
+    // The reserved stop command goes to the lane as well
+    data.cmd = 1;
+    circular_buf_put(cbuf, data);
+
+    pData = (commandStreamStructure_t *)circular_buf_reserve(cbuf);
+    ASSERT_NE(nullptr, pData);
+    pData->cmd = cmdStop;
+    pData->counter = 102;
+    EXPECT_FALSE(circular_buf_commit(cbuf));
+
+    EXPECT_EQ(2, circular_buf_get_n(cbuf, datas, 10));
+    EXPECT_EQ(102, datas[0].counter);
+    EXPECT_EQ(1, datas[1].cmd);
+}
+
+TEST_P(CircularBufferTest, circularBufElement) {
+
+    EXPECT_EQ(nullptr, circular_buf_init_element(1, 0, GetParam()));
+    EXPECT_EQ(sizeof(commandStreamStructure_t),
+              circular_buf_element_size(cbuf));
+
+    // Use the command status as the element
+    cbuf_handle_t cbufStatus = circular_buf_init_element(
+        2, sizeof(commandStatusStructure_t), GetParam());
+    EXPECT_EQ(sizeof(commandStatusStructure_t),
+              circular_buf_element_size(cbufStatus));
+
+    commandStatusStructure_t cmdStatus;
+    int idx;
+    for (idx = 0; idx < 3; idx++) {
+        cmdStatus.header.counter = idx;
+        cmdStatus.duration = 0.5 * idx;
+        snprintf(cmdStatus.reason, LENGTH_CMD_STATUS_REASON, "reason %d", idx);
+        EXPECT_EQ(idx == 2, circular_buf_put_element(cbufStatus, &cmdStatus));
+    }
+
+    // The oldest one is overwritten
+    commandStatusStructure_t cmdStatusGet;
+    for (idx = 1; idx < 3; idx++) {
+        EXPECT_FALSE(circular_buf_get_element(cbufStatus, &cmdStatusGet));
+        EXPECT_EQ(idx, cmdStatusGet.header.counter);
+        EXPECT_DOUBLE_EQ(0.5 * idx, cmdStatusGet.duration);
+        EXPECT_EQ("reason " + std::to_string(idx),
+                  std::string(cmdStatusGet.reason));
+    }
+
+    EXPECT_TRUE(circular_buf_get_element(cbufStatus, &cmdStatusGet));
+
+    circular_buf_free(cbufStatus);
+}
+
+TEST_P(CircularBufferTest, circularBufAligned) {
+
+    EXPECT_EQ(nullptr, circular_buf_init_aligned(0, 1, GetParam()));
+
+    // The slots are rounded up to 8
+    cbuf_handle_t cbufAligned = circular_buf_init_aligned(
+        bufferSize, sizeof(commandStreamStructure_t), GetParam());
+    EXPECT_EQ(7, circular_buf_capacity(cbufAligned));
+
+    // Wrap around several times with the overwrite
+    commandStreamStructure_t data;
+    int idx;
+    for (idx = 0; idx < 20; idx++) {
+        data.counter = idx;
+        EXPECT_EQ(idx >= 7, circular_buf_put(cbufAligned, data));
+    }
+
+    commandStreamStructure_t datas[10];
+    EXPECT_EQ(7, circular_buf_get_n(cbufAligned, datas, 10));
+    for (idx = 0; idx < 7; idx++) {
+        EXPECT_EQ(13 + idx, datas[idx].counter);
+    }
+
+    // The lane has the same layout
+    unsigned int cmdStop = 99;
+    EXPECT_EQ(0,
+              circular_buf_set_priority_lane(cbufAligned, 2, &cmdStop, 1));
+    EXPECT_EQ(10, circular_buf_capacity(cbufAligned));
+
+    circular_buf_free(cbufAligned);
+}
+
+TEST(CircularBuffer, circularBufMpmc) {
+
+    // There is no wasted slot
+    cbuf_handle_t cbuf = circular_buf_init_mode(3, CircularBufMode_Mpmc);
+    EXPECT_EQ(CircularBufMode_Mpmc, circular_buf_mode(cbuf));
+    EXPECT_EQ(3, circular_buf_capacity(cbuf));
+
+    // The oldest data is dropped to make room
+    commandStreamStructure_t datas[10];
+    int idx;
+    for (idx = 0; idx < 10; idx++) {
+        datas[idx].cmd = 1;
+        datas[idx].counter = idx;
+    }
+    EXPECT_FALSE(circular_buf_put(cbuf, datas[0]));
+    EXPECT_EQ(7, circular_buf_put_n(cbuf, &datas[1], 9));
+    EXPECT_EQ(3, circular_buf_size(cbuf));
+
+    commandStreamStructure_t data;
+    EXPECT_FALSE(circular_buf_get(cbuf, &data));
+    EXPECT_EQ(7, data.counter);
+
+    EXPECT_EQ(2, circular_buf_get_n(cbuf, datas, 10));
+    EXPECT_EQ(8, datas[0].counter);
+    EXPECT_EQ(9, datas[1].counter);
+    EXPECT_TRUE(circular_buf_get(cbuf, &data));
+
+    // No zero-copy functions
+    EXPECT_EQ(nullptr, circular_buf_reserve(cbuf));
+    EXPECT_EQ(nullptr, circular_buf_peek(cbuf));
+
+    // The lane is in the same mode
+    unsigned int cmdStop = 99;
+    EXPECT_EQ(0, circular_buf_set_priority_lane(cbuf, 1, &cmdStop, 1));
+    EXPECT_EQ(0, circular_buf_enable_stats(cbuf));
+
+    circular_buf_put(cbuf, data);
+    data.cmd = cmdStop;
+    circular_buf_put(cbuf, data);
+
+    EXPECT_EQ(2, circular_buf_get_n(cbuf, datas, 10));
+    EXPECT_EQ(cmdStop, datas[0].cmd);
+
+    circular_buf_stats_t stats;
+    circular_buf_get_stats(cbuf, &stats);
+    EXPECT_EQ(7, stats.numOverwrite);
+    EXPECT_EQ(2, stats.numLatency);
+
+    circular_buf_free(cbuf);
+}
+
+// Get the monotonic time "ms" milliseconds ago
+static struct timespec getTimeBefore(long ms) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    long timeInNs = time.tv_sec * 1000000000L + time.tv_nsec - ms * 1000000L;
+    time.tv_sec = timeInNs / 1000000000L;
+    time.tv_nsec = timeInNs % 1000000000L;
+
+    return time;
+}
+
+TEST_P(CircularBufferTest, circularBufStats) {
+
+    // The overwrite is counted without the statistics enabled
+    commandStreamStructure_t data;
+    int idx;
+    for (idx = 0; idx < bufferSize + 2; idx++) {
+        data.counter = idx;
+        circular_buf_put(cbuf, data);
+    }
+
+    circular_buf_stats_t stats;
+    circular_buf_get_stats(cbuf, &stats);
+    EXPECT_EQ(2, stats.numOverwrite);
+    EXPECT_EQ(0, stats.numLatency);
+    EXPECT_EQ(0, stats.latencyMax);
+
+    commandStreamStructure_t datas[10];
+    circular_buf_get_n(cbuf, datas, 10);
+
+    // Record the latency from the receive time
+    EXPECT_FALSE(circular_buf_is_stats_enabled(cbuf));
+    EXPECT_EQ(0, circular_buf_enable_stats(cbuf));
+    EXPECT_EQ(0, circular_buf_enable_stats(cbuf));
+    EXPECT_TRUE(circular_buf_is_stats_enabled(cbuf));
+
+    struct timespec timeRecv = getTimeBefore(1);
+    for (idx = 0; idx < bufferSize - 1; idx++) {
+        EXPECT_FALSE(circular_buf_put_stamped(cbuf, data, &timeRecv));
+    }
+
+    timeRecv = getTimeBefore(20);
+    EXPECT_FALSE(circular_buf_put_stamped(cbuf, data, &timeRecv));
+
+    EXPECT_EQ(bufferSize, circular_buf_get_n(cbuf, datas, 10));
+
+    circular_buf_get_stats(cbuf, &stats);
+    EXPECT_EQ(2, stats.numOverwrite);
+    EXPECT_EQ(bufferSize, stats.numLatency);
+    EXPECT_GE(stats.latencyP50, 1000000);
+    EXPECT_LT(stats.latencyP50, 20000000);
+    EXPECT_GE(stats.latencyP99, 20000000);
+    EXPECT_GE(stats.latencyMax, stats.latencyP99);
+
+    // The peek and zero-copy put are recorded as well
+    void *pData = circular_buf_reserve(cbuf);
+    ASSERT_NE(nullptr, pData);
+    memcpy(pData, &data, sizeof(data));
+    EXPECT_FALSE(circular_buf_commit(cbuf));
+
+    ASSERT_NE(nullptr, circular_buf_peek(cbuf));
+    circular_buf_release(cbuf);
+
+    circular_buf_get_stats(cbuf, &stats);
+    EXPECT_EQ(bufferSize + 1, stats.numLatency);
+}
+
+TEST(CircularBuffer, circularBufStatsPriorityLane) {
+
+    cbuf_handle_t cbuf = circular_buf_init_mode(2, CircularBufMode_Spsc);
+    EXPECT_EQ(0, circular_buf_enable_stats(cbuf));
+
+    unsigned int cmdStop = 99;
+    EXPECT_EQ(0, circular_buf_set_priority_lane(cbuf, 1, &cmdStop, 1));
+
+    commandStreamStructure_t data;
+    data.cmd = cmdStop;
+    circular_buf_put(cbuf, data);
+    circular_buf_put(cbuf, data);
+
+    data.cmd = 1;
+    circular_buf_put(cbuf, data);
+
+    // The lane is merged
+    commandStreamStructure_t datas[3];
+    EXPECT_EQ(2, circular_buf_get_n(cbuf, datas, 3));
+
+    circular_buf_stats_t stats;
+    circular_buf_get_stats(cbuf, &stats);
+    EXPECT_EQ(1, stats.numOverwrite);
+    EXPECT_EQ(2, stats.numLatency);
+    EXPECT_LE(stats.latencyP50, stats.latencyMax);
+
+    circular_buf_free(cbuf);
+}
+
+INSTANTIATE_TEST_SUITE_P(CircularBufferMode, CircularBufferTest,
+                         testing::Values(CircularBufMode_Mutex,
+                                         CircularBufMode_Spsc));
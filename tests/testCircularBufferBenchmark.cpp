@@ -0,0 +1,240 @@
+#include <pthread.h>
+#include <time.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "circular_buffer.h"
+}
+
+// Number of commands to put in each benchmark
+static const int NUM_CMD_BENCHMARK = 200000;
+
+// Get the current monotonic time in nanosecond
+static long nowInNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+struct circular_buf_bench_t {
+    cbuf_handle_t cbuf;
+    int numProc;
+    bool isDone;
+};
+
+static void *producerBench(void *pBenchInput) {
+
+    circular_buf_bench_t *pBench = (circular_buf_bench_t *)pBenchInput;
+
+    int idx;
+    for (idx = 0; idx < pBench->numProc; idx++) {
+        commandStreamStructure_t data;
+        data.counter = idx;
+        circular_buf_put(pBench->cbuf, data);
+    }
+
+    __atomic_store_n(&pBench->isDone, true, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// Run one producer thread against the consumer (this thread), which is the
+// setup of the network thread and control loop. Print the time per command and
+// the worst time the consumer spent in a single get.
+static void runContentionBenchmark(cbuf_handle_t cbuf, const char *pName) {
+
+    struct circular_buf_bench_t bench;
+    bench.cbuf = cbuf;
+    bench.numProc = NUM_CMD_BENCHMARK;
+    bench.isDone = false;
+
+    long timeStart = nowInNs();
+
+    pthread_t threadId;
+    int error = pthread_create(&threadId, NULL, producerBench, (void *)&bench);
+    if (error) {
+        printf("Thread creation failed: %d (benchmark).\n", error);
+        exit(1);
+    }
+
+    long timeGetMax = 0;
+    int numGetData = 0;
+    commandStreamStructure_t data;
+    while (true) {
+        bool isDone = __atomic_load_n(&bench.isDone, __ATOMIC_ACQUIRE);
+
+        long timeGet = nowInNs();
+        bool isBufEmpty = circular_buf_get(cbuf, &data);
+        timeGet = nowInNs() - timeGet;
+
+        if (timeGet > timeGetMax) {
+            timeGetMax = timeGet;
+        }
+
+        if (!isBufEmpty) {
+            numGetData++;
+        } else if (isDone) {
+            break;
+        }
+    }
+
+    pthread_join(threadId, NULL);
+
+    long timeTotal = nowInNs() - timeStart;
+    printf("[%s] %.1f ns/command, %d received, max get time: %ld ns.\n",
+           pName, (double)timeTotal / NUM_CMD_BENCHMARK, numGetData,
+           timeGetMax);
+
+    EXPECT_GT(numGetData, 0);
+
+    circular_buf_free(cbuf);
+}
+
+TEST(CircularBufferBenchmark, contention) {
+    runContentionBenchmark(circular_buf_init_mode(64, CircularBufMode_Mutex),
+                           "mutex");
+    runContentionBenchmark(circular_buf_init_mode(64, CircularBufMode_Spsc),
+                           "spsc");
+}
+
+struct circular_buf_stress_t {
+    cbuf_handle_t cbuf;
+    int numProc;
+    int numGetData;
+};
+
+static void *putAndGetStress(void *pStressInput) {
+
+    circular_buf_stress_t *pStress = (circular_buf_stress_t *)pStressInput;
+
+    int numGetData = 0;
+    commandStreamStructure_t data;
+    int idx;
+    for (idx = 0; idx < pStress->numProc; idx++) {
+        data.counter = idx;
+        circular_buf_put(pStress->cbuf, data);
+        if (!circular_buf_get(pStress->cbuf, &data)) {
+            numGetData++;
+        }
+    }
+
+    pStress->numGetData = numGetData;
+
+    return 0;
+}
+
+// Each thread uses its own buffer. The throughput should scale with the number
+// of buffers (and cores) because the buffers do not share any lock.
+TEST(CircularBufferBenchmark, multiBufferStress) {
+
+    const int NUM_BUFFER_MAX = 8;
+
+    int numBuffer;
+    for (numBuffer = 1; numBuffer <= NUM_BUFFER_MAX; numBuffer *= 2) {
+
+        struct circular_buf_stress_t stress[NUM_BUFFER_MAX];
+        pthread_t threadIds[NUM_BUFFER_MAX];
+
+        long timeStart = nowInNs();
+
+        int idx;
+        for (idx = 0; idx < numBuffer; idx++) {
+            stress[idx].cbuf = circular_buf_init(64);
+            stress[idx].numProc = NUM_CMD_BENCHMARK;
+            stress[idx].numGetData = 0;
+
+            int error = pthread_create(&threadIds[idx], NULL, putAndGetStress,
+                                       (void *)&stress[idx]);
+            if (error) {
+                printf("Thread creation failed: %d (stress).\n", error);
+                exit(1);
+            }
+        }
+
+        for (idx = 0; idx < numBuffer; idx++) {
+            pthread_join(threadIds[idx], NULL);
+
+            EXPECT_EQ(NUM_CMD_BENCHMARK, stress[idx].numGetData);
+            EXPECT_EQ(0, circular_buf_size(stress[idx].cbuf));
+
+            circular_buf_free(stress[idx].cbuf);
+        }
+
+        long timeTotal = nowInNs() - timeStart;
+        printf("[%d buffer(s)] %.2f million put/get pairs per second.\n",
+               numBuffer,
+               (double)numBuffer * NUM_CMD_BENCHMARK * 1e3 / timeTotal);
+    }
+}
+
+// Compare the per-element cost of the batch and single calls. This is the
+// pattern of the control loop that drains the command buffer once per cycle.
+static void runBatchBenchmark(cbuf_handle_t cbuf, const char *pName) {
+
+    const int NUM_BATCH = 32;
+
+    commandStreamStructure_t datas[NUM_BATCH];
+    int idx;
+    for (idx = 0; idx < NUM_BATCH; idx++) {
+        datas[idx].counter = idx;
+    }
+
+    int numCycle = NUM_CMD_BENCHMARK / NUM_BATCH;
+    int cycle;
+
+    // Single calls
+    long timeStart = nowInNs();
+    for (cycle = 0; cycle < numCycle; cycle++) {
+        for (idx = 0; idx < NUM_BATCH; idx++) {
+            circular_buf_put(cbuf, datas[idx]);
+        }
+
+        for (idx = 0; idx < NUM_BATCH; idx++) {
+            circular_buf_get(cbuf, &datas[idx]);
+        }
+    }
+    long timeSingle = nowInNs() - timeStart;
+
+    // Batch calls
+    int numGetData = 0;
+    timeStart = nowInNs();
+    for (cycle = 0; cycle < numCycle; cycle++) {
+        circular_buf_put_n(cbuf, datas, NUM_BATCH);
+        numGetData += circular_buf_get_n(cbuf, datas, NUM_BATCH);
+    }
+    long timeBatch = nowInNs() - timeStart;
+
+    EXPECT_EQ(numCycle * NUM_BATCH, numGetData);
+
+    long numElement = (long)numCycle * NUM_BATCH;
+    printf("[%s] single: %.1f ns/element, batch of %d: %.1f ns/element.\n",
+           pName, (double)timeSingle / numElement, NUM_BATCH,
+           (double)timeBatch / numElement);
+
+    circular_buf_free(cbuf);
+}
+
+TEST(CircularBufferBenchmark, batch) {
+    runBatchBenchmark(circular_buf_init_mode(32, CircularBufMode_Mutex),
+                      "mutex");
+    runBatchBenchmark(circular_buf_init_mode(32, CircularBufMode_Spsc),
+                      "spsc");
+}
+
+// Compare the modulo (compact) and mask (aligned) rings. The capacity is 63 for
+// both, so the aligned one has 64 slots.
+TEST(CircularBufferBenchmark, layout) {
+    runContentionBenchmark(circular_buf_init_mode(63, CircularBufMode_Spsc),
+                           "spsc, compact");
+    runContentionBenchmark(
+        circular_buf_init_aligned(63, sizeof(commandStreamStructure_t),
+                                  CircularBufMode_Spsc),
+        "spsc, aligned");
+    runBatchBenchmark(circular_buf_init_mode(63, CircularBufMode_Spsc),
+                      "spsc, compact");
+    runBatchBenchmark(
+        circular_buf_init_aligned(63, sizeof(commandStreamStructure_t),
+                                  CircularBufMode_Spsc),
+        "spsc, aligned");
+}
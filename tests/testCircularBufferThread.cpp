@@ -207,3 +207,467 @@ TEST_F(CircularBufferThreadTest, circularBufGet) {
     pthread_join(threadId2, NULL);
     printf("Finish the waiting of producer threads (test get).\n");
 }
+
+struct circular_buf_spsc_test_t {
+    cbuf_handle_t cbuf;
+    int numProc;
+    int numBatch;
+    int numLostData;
+    bool isDone;
+};
+
+void *producerSpsc(void *pBufTestInput) {
+
+    circular_buf_spsc_test_t *pCbufTest =
+        (circular_buf_spsc_test_t *)pBufTestInput;
+
+    // Put the data as fast as possible to have the overwrite
+    int numLostData = 0;
+    commandStreamStructure_t datas[pCbufTest->numBatch];
+    int idx = 0;
+    while (idx < pCbufTest->numProc) {
+        int numPut = 0;
+        while ((numPut < pCbufTest->numBatch) && (idx < pCbufTest->numProc)) {
+            datas[numPut++].counter = idx++;
+        }
+
+        if (numPut == 1) {
+            numLostData += circular_buf_put(pCbufTest->cbuf, datas[0]) ? 1 : 0;
+        } else {
+            numLostData += circular_buf_put_n(pCbufTest->cbuf, datas, numPut);
+        }
+    }
+
+    pCbufTest->numLostData = numLostData;
+    __atomic_store_n(&pCbufTest->isDone, true, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// Single producer and single consumer without the lock. The producer puts
+// "numBatch" data at a time and the consumer gets "numGet" data at a time.
+static void runSpsc(int numBatch, int numGet) {
+
+    int bufferSize = 16;
+    cbuf_handle_t cbuf =
+        circular_buf_init_mode(bufferSize, CircularBufMode_Spsc);
+
+    struct circular_buf_spsc_test_t cbufTest;
+    cbufTest.cbuf = cbuf;
+    cbufTest.numProc = 200000;
+    cbufTest.numBatch = numBatch;
+    cbufTest.numLostData = 0;
+    cbufTest.isDone = false;
+
+    pthread_t threadId;
+    int error =
+        pthread_create(&threadId, NULL, producerSpsc, (void *)&cbufTest);
+    if (error) {
+        printf("Thread creation failed: %d (test spsc).\n", error);
+        exit(1);
+    }
+
+    // Main thread as the consumer. The counters should be in order even
+    // though some of them are overwritten.
+    int numGetData = 0;
+    int counterLast = -1;
+    bool isInOrder = true;
+    commandStreamStructure_t datas[numGet];
+    while (true) {
+        bool isDone = __atomic_load_n(&cbufTest.isDone, __ATOMIC_ACQUIRE);
+        int num = circular_buf_get_n(cbuf, datas, numGet);
+        int idx;
+        for (idx = 0; idx < num; idx++) {
+            isInOrder = isInOrder && ((int)datas[idx].counter > counterLast);
+            counterLast = datas[idx].counter;
+        }
+        numGetData += num;
+
+        if ((num == 0) && isDone) {
+            break;
+        }
+    }
+
+    pthread_join(threadId, NULL);
+
+    EXPECT_TRUE(isInOrder);
+    EXPECT_EQ(cbufTest.numProc - 1, counterLast);
+    EXPECT_EQ(cbufTest.numProc, numGetData + cbufTest.numLostData);
+    EXPECT_EQ(0, circular_buf_size(cbuf));
+
+    circular_buf_free(cbuf);
+}
+
+TEST(CircularBufferThread, circularBufSpsc) { runSpsc(1, 1); }
+
+TEST(CircularBufferThread, circularBufSpscBatch) { runSpsc(7, 4); }
+
+void *producerSpscReserve(void *pBufTestInput) {
+
+    circular_buf_spsc_test_t *pCbufTest =
+        (circular_buf_spsc_test_t *)pBufTestInput;
+
+    // Write the data in place as fast as possible
+    int numLostData = 0;
+    int idx;
+    for (idx = 0; idx < pCbufTest->numProc; idx++) {
+        commandStreamStructure_t *pData =
+            (commandStreamStructure_t *)circular_buf_reserve(pCbufTest->cbuf);
+        if (pData == NULL) {
+            numLostData++;
+            continue;
+        }
+
+        pData->counter = idx;
+        if (circular_buf_commit(pCbufTest->cbuf)) {
+            numLostData++;
+        }
+    }
+
+    pCbufTest->numLostData = numLostData;
+    __atomic_store_n(&pCbufTest->isDone, true, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// Single producer and single consumer with the zero-copy functions
+TEST(CircularBufferThread, circularBufSpscZeroCopy) {
+
+    cbuf_handle_t cbuf = circular_buf_init_mode(16, CircularBufMode_Spsc);
+
+    struct circular_buf_spsc_test_t cbufTest;
+    cbufTest.cbuf = cbuf;
+    cbufTest.numProc = 200000;
+    cbufTest.numBatch = 1;
+    cbufTest.numLostData = 0;
+    cbufTest.isDone = false;
+
+    pthread_t threadId;
+    int error = pthread_create(&threadId, NULL, producerSpscReserve,
+                               (void *)&cbufTest);
+    if (error) {
+        printf("Thread creation failed: %d (test zero-copy).\n", error);
+        exit(1);
+    }
+
+    // Main thread as the consumer. The held data should not be changed.
+    int numGetData = 0;
+    int counterLast = -1;
+    bool isInOrder = true;
+    bool isUnchanged = true;
+    while (true) {
+        bool isDone = __atomic_load_n(&cbufTest.isDone, __ATOMIC_ACQUIRE);
+        commandStreamStructure_t *pData =
+            (commandStreamStructure_t *)circular_buf_peek(cbuf);
+        if (pData != NULL) {
+            int counter = pData->counter;
+            isInOrder = isInOrder && (counter > counterLast);
+            counterLast = counter;
+
+            sched_yield();
+            isUnchanged = isUnchanged && ((int)pData->counter == counter);
+
+            circular_buf_release(cbuf);
+            numGetData++;
+        } else if (isDone) {
+            break;
+        }
+    }
+
+    pthread_join(threadId, NULL);
+
+    EXPECT_TRUE(isInOrder);
+    EXPECT_TRUE(isUnchanged);
+    EXPECT_EQ(cbufTest.numProc, numGetData + cbufTest.numLostData);
+
+    circular_buf_free(cbuf);
+}
+
+// Get the absolute deadline of CLOCK_MONOTONIC after the time in ms
+static struct timespec getDeadline(long timeInMs) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    deadline.tv_nsec += (timeInMs % 1000) * 1000000;
+    deadline.tv_sec += timeInMs / 1000 + deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+
+    return deadline;
+}
+
+void *producerDelayed(void *pBufTestInput) {
+
+    circular_buf_test_t *pCbufTest = (circular_buf_test_t *)pBufTestInput;
+
+    // Sleep 0.05 sec
+    struct timespec sleepTime;
+    sleepTime.tv_sec = 0;
+    sleepTime.tv_nsec = 50000000;
+
+    int idx;
+    for (idx = 0; idx < pCbufTest->numProc; idx++) {
+        nanosleep(&sleepTime, NULL);
+
+        commandStreamStructure_t data;
+        data.counter = pCbufTest->idxStart + idx;
+        circular_buf_put(pCbufTest->cbuf, data);
+    }
+
+    return 0;
+}
+
+struct CircularBufferTimedTest : testing::TestWithParam<CircularBufMode> {};
+
+TEST_P(CircularBufferTimedTest, circularBufGetTimed) {
+
+    cbuf_handle_t cbuf = circular_buf_init_mode(5, GetParam());
+
+    // Timeout if there is no data
+    commandStreamStructure_t data;
+    struct timespec deadline = getDeadline(20);
+    EXPECT_TRUE(circular_buf_get_timed(cbuf, &data, &deadline));
+
+    struct timespec timeNow;
+    clock_gettime(CLOCK_MONOTONIC, &timeNow);
+    EXPECT_TRUE((timeNow.tv_sec > deadline.tv_sec) ||
+                ((timeNow.tv_sec == deadline.tv_sec) &&
+                 (timeNow.tv_nsec >= deadline.tv_nsec)));
+
+    // Wake up when the data arrives
+    struct circular_buf_test_t cbufTest;
+    cbufTest.cbuf = cbuf;
+    cbufTest.idxStart = 10;
+    cbufTest.numProc = 3;
+
+    pthread_t threadId;
+    int error =
+        pthread_create(&threadId, NULL, producerDelayed, (void *)&cbufTest);
+    if (error) {
+        printf("Thread creation failed: %d (test get timed).\n", error);
+        exit(1);
+    }
+
+    int idx;
+    for (idx = 0; idx < cbufTest.numProc; idx++) {
+        deadline = getDeadline(5000);
+        EXPECT_FALSE(circular_buf_get_timed(cbuf, &data, &deadline));
+        EXPECT_EQ(cbufTest.idxStart + idx, data.counter);
+
+        // Should not wait until the deadline
+        clock_gettime(CLOCK_MONOTONIC, &timeNow);
+        EXPECT_LT(timeNow.tv_sec, deadline.tv_sec);
+    }
+
+    pthread_join(threadId, NULL);
+
+    circular_buf_free(cbuf);
+}
+
+INSTANTIATE_TEST_SUITE_P(CircularBufferMode, CircularBufferTimedTest,
+                         testing::Values(CircularBufMode_Mutex,
+                                         CircularBufMode_Spsc,
+                                         CircularBufMode_Mpmc));
+
+// Get the current monotonic time in nanosecond
+static long nowInNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+struct circular_buf_mpmc_test_t {
+    cbuf_handle_t cbuf;
+    // Producer ID, which is put to the command name
+    unsigned int id;
+    int numProc;
+    int numLostData;
+    int *pNumDone;
+};
+
+void *producerMpmc(void *pBufTestInput) {
+
+    circular_buf_mpmc_test_t *pCbufTest =
+        (circular_buf_mpmc_test_t *)pBufTestInput;
+
+    int numLostData = 0;
+    commandStreamStructure_t data;
+    data.cmd = pCbufTest->id;
+    int idx;
+    for (idx = 0; idx < pCbufTest->numProc; idx++) {
+        data.counter = idx;
+        // One put might drop more than one data when the producers race
+        numLostData += circular_buf_put_n(pCbufTest->cbuf, &data, 1);
+    }
+
+    pCbufTest->numLostData = numLostData;
+    __atomic_fetch_add(pCbufTest->pNumDone, 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// Several producers (such as the GUI and CSC servers) put to one buffer, which
+// is drained by the consumer (this thread). Each producer's data should be in
+// order and nothing is lost silently.
+// Return the time per command in nanosecond.
+static double runMultiProducer(CircularBufMode mode, int numProducer) {
+
+    const int NUM_PRODUCER_MAX = 8;
+    const int NUM_PROC = 100000;
+
+    cbuf_handle_t cbuf = circular_buf_init_mode(64, mode);
+
+    int numDone = 0;
+    struct circular_buf_mpmc_test_t cbufTests[NUM_PRODUCER_MAX];
+    pthread_t threadIds[NUM_PRODUCER_MAX];
+
+    long timeStart = nowInNs();
+
+    int idx;
+    for (idx = 0; idx < numProducer; idx++) {
+        cbufTests[idx].cbuf = cbuf;
+        cbufTests[idx].id = idx;
+        cbufTests[idx].numProc = NUM_PROC;
+        cbufTests[idx].numLostData = 0;
+        cbufTests[idx].pNumDone = &numDone;
+
+        int error = pthread_create(&threadIds[idx], NULL, producerMpmc,
+                                   (void *)&cbufTests[idx]);
+        if (error) {
+            printf("Thread creation failed: %d (test mpmc).\n", error);
+            exit(1);
+        }
+    }
+
+    int counterLast[NUM_PRODUCER_MAX];
+    for (idx = 0; idx < numProducer; idx++) {
+        counterLast[idx] = -1;
+    }
+
+    int numGetData = 0;
+    bool isInOrder = true;
+    commandStreamStructure_t datas[16];
+    while (true) {
+        bool isDone =
+            (__atomic_load_n(&numDone, __ATOMIC_ACQUIRE) == numProducer);
+        int num = circular_buf_get_n(cbuf, datas, 16);
+        int idxData;
+        for (idxData = 0; idxData < num; idxData++) {
+            int id = datas[idxData].cmd;
+            isInOrder =
+                isInOrder && ((int)datas[idxData].counter > counterLast[id]);
+            counterLast[id] = datas[idxData].counter;
+        }
+        numGetData += num;
+
+        if ((num == 0) && isDone) {
+            break;
+        }
+    }
+
+    long timeTotal = nowInNs() - timeStart;
+
+    int numLostData = 0;
+    for (idx = 0; idx < numProducer; idx++) {
+        pthread_join(threadIds[idx], NULL);
+        numLostData += cbufTests[idx].numLostData;
+    }
+
+    EXPECT_TRUE(isInOrder);
+    EXPECT_EQ(numProducer * NUM_PROC, numGetData + numLostData);
+    EXPECT_EQ(0, circular_buf_size(cbuf));
+
+    circular_buf_free(cbuf);
+
+    return (double)timeTotal / (numProducer * NUM_PROC);
+}
+
+TEST(CircularBufferThread, circularBufMpmc) {
+    runMultiProducer(CircularBufMode_Mpmc, 4);
+}
+
+// Compare the mutex and MPMC modes with the number of producers
+TEST(CircularBufferThread, circularBufMultiProducerScaling) {
+    int numProducer;
+    for (numProducer = 1; numProducer <= 8; numProducer *= 2) {
+        double timeMutex = runMultiProducer(CircularBufMode_Mutex, numProducer);
+        double timeMpmc = runMultiProducer(CircularBufMode_Mpmc, numProducer);
+        printf("[%d producer(s)] mutex: %.1f ns/command, mpmc: %.1f "
+               "ns/command.\n",
+               numProducer, timeMutex, timeMpmc);
+    }
+}
+
+void *consumerMpmc(void *pBufTestInput) {
+
+    circular_buf_mpmc_test_t *pCbufTest =
+        (circular_buf_mpmc_test_t *)pBufTestInput;
+
+    // Count the data received until all the producers are done
+    int numGetData = 0;
+    commandStreamStructure_t data;
+    while (true) {
+        bool isDone = (__atomic_load_n(pCbufTest->pNumDone, __ATOMIC_ACQUIRE) ==
+                       (int)pCbufTest->id);
+        if (!circular_buf_get(pCbufTest->cbuf, &data)) {
+            numGetData++;
+        } else if (isDone) {
+            break;
+        }
+    }
+
+    pCbufTest->numProc = numGetData;
+
+    return 0;
+}
+
+// Several producers and consumers at the same time
+TEST(CircularBufferThread, circularBufMpmcMultiConsumer) {
+
+    const int NUM_THREAD = 3;
+    const int NUM_PROC = 100000;
+
+    cbuf_handle_t cbuf = circular_buf_init_mode(16, CircularBufMode_Mpmc);
+
+    int numDone = 0;
+    struct circular_buf_mpmc_test_t producers[NUM_THREAD];
+    struct circular_buf_mpmc_test_t consumers[NUM_THREAD];
+    pthread_t threadIds[2 * NUM_THREAD];
+
+    int idx;
+    for (idx = 0; idx < NUM_THREAD; idx++) {
+        producers[idx].cbuf = cbuf;
+        producers[idx].id = idx;
+        producers[idx].numProc = NUM_PROC;
+        producers[idx].numLostData = 0;
+        producers[idx].pNumDone = &numDone;
+
+        // The consumer stops when this number of producers are done
+        consumers[idx].cbuf = cbuf;
+        consumers[idx].id = NUM_THREAD;
+        consumers[idx].numProc = 0;
+        consumers[idx].pNumDone = &numDone;
+
+        if ((pthread_create(&threadIds[idx], NULL, producerMpmc,
+                            (void *)&producers[idx]) != 0) ||
+            (pthread_create(&threadIds[NUM_THREAD + idx], NULL, consumerMpmc,
+                            (void *)&consumers[idx]) != 0)) {
+            printf("Thread creation failed (test mpmc multi-consumer).\n");
+            exit(1);
+        }
+    }
+
+    int numGetData = 0;
+    int numLostData = 0;
+    for (idx = 0; idx < NUM_THREAD; idx++) {
+        pthread_join(threadIds[idx], NULL);
+        pthread_join(threadIds[NUM_THREAD + idx], NULL);
+
+        numLostData += producers[idx].numLostData;
+        numGetData += consumers[idx].numProc;
+    }
+
+    EXPECT_EQ(NUM_THREAD * NUM_PROC, numGetData + numLostData);
+    EXPECT_EQ(0, circular_buf_size(cbuf));
+
+    circular_buf_free(cbuf);
+}
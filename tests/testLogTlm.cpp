@@ -1,9 +1,11 @@
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
 extern "C" {
+#include "ds402.h"
 #include "logTlm.h"
 }
 
@@ -12,6 +14,30 @@ struct Data {
     uint value;
 };
 
+struct DataCapture {
+    uint idx;
+    ds402_status_word statusWord;
+    double value;
+};
+
+// Trigger the full-rate capture by the fault bit of status word.
+static bool isFault(void *pUser, const void *pData) {
+    return ((const DataCapture *)pData)->statusWord.fault;
+}
+
+// Read the records in the raw file.
+static std::vector<DataCapture> readCapture(std::string filename) {
+    std::ifstream file(filename, std::ifstream::binary);
+
+    std::vector<DataCapture> records;
+    DataCapture data;
+    while (file.read((char *)&data, sizeof(data))) {
+        records.push_back(data);
+    }
+
+    return records;
+}
+
 struct LogTlmTest : testing::Test {
 
     char *pathDir = "./";
@@ -124,3 +150,1071 @@ TEST_F(LogTlmTest, logTlmWrite) {
         EXPECT_EQ(10 * idxExpect, dataDecode[idx].value);
     }
 }
+
+TEST(LogTlm, logTlmHandle) {
+
+    char *pathDir = "./";
+
+    // Two streams with the different record sizes
+    logTlm_handle_t pLogFast = logTlmHandle_init();
+    logTlm_handle_t pLogSlow = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLogFast);
+    ASSERT_NE(nullptr, pLogSlow);
+    EXPECT_NE(logTlm_getDefaultHandle(), pLogFast);
+
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLogFast, 3, 4, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLogSlow, 4, 2, sizeof(uint)));
+
+    EXPECT_EQ(0, logTlmHandle_open(pLogFast, pathDir,
+                                   "tlmFast_%m_%d_%Y_%H_%M_%S.log", 100));
+    EXPECT_EQ(0, logTlmHandle_open(pLogSlow, pathDir,
+                                   "tlmSlow_%m_%d_%Y_%H_%M_%S.log", 100));
+    EXPECT_NE(std::string(logTlmHandle_getFilename(pLogFast)),
+              std::string(logTlmHandle_getFilename(pLogSlow)));
+
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLogFast, &timeInMs));
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLogSlow, &timeInMs));
+
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 8; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        logTlmHandle_write(pLogFast, &data);
+        logTlmHandle_write(pLogSlow, &idx);
+    }
+
+    // The default logger is not touched
+    EXPECT_EQ(nullptr, logTlm_getBuffer(1));
+
+    sleep(1);
+    EXPECT_FALSE(logTlmHandle_isFlushing(pLogFast));
+    EXPECT_FALSE(logTlmHandle_isFlushing(pLogSlow));
+
+    std::string filenameFast = logTlmHandle_getFilename(pLogFast);
+    std::string filenameSlow = logTlmHandle_getFilename(pLogSlow);
+
+    logTlmHandle_free(pLogFast);
+    logTlmHandle_free(pLogSlow);
+
+    std::ifstream fileFast(filenameFast, std::ifstream::binary);
+    struct Data datas[8];
+    fileFast.read((char *)datas, sizeof(datas));
+    EXPECT_EQ(sizeof(datas), fileFast.gcount());
+    EXPECT_EQ(70, datas[7].value);
+
+    std::ifstream fileSlow(filenameSlow, std::ifstream::binary);
+    uint values[8];
+    fileSlow.read((char *)values, sizeof(values));
+    EXPECT_EQ(sizeof(values), fileSlow.gcount());
+    EXPECT_EQ(7, values[7]);
+}
+
+TEST(LogTlm, logTlmDirect) {
+
+    char *pathDir = "./";
+    uint recordPerFile = 1000;
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(-1, logTlmHandle_setBackend(pLog, (LogTlmBackend)0));
+    EXPECT_EQ(0, logTlmHandle_setBackend(pLog, LogTlmBackend_Direct));
+
+    // The buffer and file sizes are not the multiple of block size
+    EXPECT_EQ(0, logTlmHandle_createBuffer(pLog, 300, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmDirect_%m_%d_%Y_%H_%M_%S.log",
+                                   recordPerFile));
+
+    EXPECT_EQ(-1, logTlmHandle_setBackend(pLog, LogTlmBackend_Stream));
+
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 2500; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+    }
+
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    // The padding of last block is truncated
+    uint numRecords[3] = {recordPerFile, recordPerFile, 500};
+    std::string filenames[3] = {fileCurrent + ".0", fileCurrent + ".1",
+                                fileCurrent};
+
+    uint idxExpect = 0;
+    int idxFile;
+    for (idxFile = 0; idxFile < 3; idxFile++) {
+        std::ifstream file(filenames[idxFile],
+                           std::ifstream::binary | std::ifstream::ate);
+        ASSERT_TRUE(file.good());
+        EXPECT_EQ(numRecords[idxFile] * sizeof(Data), file.tellg());
+
+        std::vector<Data> datas(numRecords[idxFile]);
+        file.seekg(0);
+        file.read((char *)datas.data(), numRecords[idxFile] * sizeof(Data));
+
+        for (idx = 0; idx < numRecords[idxFile]; idx++) {
+            EXPECT_EQ(idxExpect, datas[idx].idx);
+            EXPECT_EQ(10 * idxExpect, datas[idx].value);
+
+            idxExpect += 1;
+        }
+    }
+}
+
+TEST(LogTlm, logTlmDirectInBackground) {
+
+    char *pathDir = "./";
+    uint recordPerFile = 2048;
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_setBackend(pLog, LogTlmBackend_Direct));
+    EXPECT_EQ(0, logTlmHandle_setDurability(pLog, LogTlmDurability_Bytes,
+                                            4096));
+
+    // The buffer is a block, so it is written without the copy
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 8, 4096 / sizeof(Data),
+                                               sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmDirectQueue_%m_%d_%Y_%H_%M_%S.log",
+                                   recordPerFile));
+
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 5000; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+
+        if ((idx % 256) == 255) {
+            usleep(1000);
+        }
+    }
+
+    // The queued writes are done before the thread is closed
+    logTlmHandle_closeThread(pLog);
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(0, stats.numRecordDropped);
+    EXPECT_EQ(0, stats.numSyncFailed);
+    EXPECT_GT(stats.numSync, 0);
+
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    uint numRecords[3] = {recordPerFile, recordPerFile, 904};
+    std::string filenames[3] = {fileCurrent + ".0", fileCurrent + ".1",
+                                fileCurrent};
+
+    uint idxExpect = 0;
+    int idxFile;
+    for (idxFile = 0; idxFile < 3; idxFile++) {
+        std::ifstream file(filenames[idxFile],
+                           std::ifstream::binary | std::ifstream::ate);
+        ASSERT_TRUE(file.good());
+        EXPECT_EQ(numRecords[idxFile] * sizeof(Data), file.tellg());
+
+        std::vector<Data> datas(numRecords[idxFile]);
+        file.seekg(0);
+        file.read((char *)datas.data(), numRecords[idxFile] * sizeof(Data));
+
+        for (idx = 0; idx < numRecords[idxFile]; idx++) {
+            EXPECT_EQ(idxExpect, datas[idx].idx);
+            EXPECT_EQ(10 * idxExpect, datas[idx].value);
+
+            idxExpect += 1;
+        }
+    }
+}
+
+TEST(LogTlm, logTlmMmap) {
+
+    char *pathDir = "./";
+    uint recordPerFile = 4;
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    // The buffer only gives the element size
+    EXPECT_EQ(0, logTlmHandle_setBackend(pLog, LogTlmBackend_Mmap));
+    EXPECT_EQ(0, logTlmHandle_createBuffer(pLog, 1, sizeof(Data)));
+    EXPECT_EQ(0,
+              logTlmHandle_open(pLog, pathDir, "tlmMmap_%m_%d_%Y_%H_%M_%S.log",
+                                recordPerFile));
+
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+
+    // Without the housekeeping thread, the flush renames the old file and
+    // prepares the next one
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 10; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+        EXPECT_EQ(0, logTlmHandle_flush(pLog));
+    }
+
+    EXPECT_FALSE(logTlmHandle_isFlushing(pLog));
+
+    // The current file is preallocated and the records can be read while it
+    // is written
+    struct Data datas[4];
+    std::ifstream fileOpened(fileCurrent, std::ifstream::binary);
+    fileOpened.read((char *)datas, sizeof(datas));
+    EXPECT_EQ(sizeof(datas), fileOpened.gcount());
+    EXPECT_EQ(9, datas[1].idx);
+    EXPECT_EQ(90, datas[1].value);
+
+    logTlmHandle_free(pLog);
+
+    // The file is truncated to the written records when closed
+    uint numRecords[3] = {recordPerFile, recordPerFile, 2};
+    std::string filenames[3] = {fileCurrent + ".0", fileCurrent + ".1",
+                                fileCurrent};
+
+    uint idxExpect = 0;
+    int idxFile;
+    for (idxFile = 0; idxFile < 3; idxFile++) {
+        std::ifstream file(filenames[idxFile],
+                           std::ifstream::binary | std::ifstream::ate);
+        ASSERT_TRUE(file.good());
+        EXPECT_EQ(numRecords[idxFile] * sizeof(Data), file.tellg());
+
+        file.seekg(0);
+        file.read((char *)datas, numRecords[idxFile] * sizeof(Data));
+
+        for (idx = 0; idx < numRecords[idxFile]; idx++) {
+            EXPECT_EQ(idxExpect, datas[idx].idx);
+            EXPECT_EQ(10 * idxExpect, datas[idx].value);
+
+            idxExpect += 1;
+        }
+    }
+}
+
+TEST(LogTlm, logTlmMmapNextFileNotReady) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_setBackend(pLog, LogTlmBackend_Mmap));
+    EXPECT_EQ(0, logTlmHandle_setRecordHeader(pLog, true));
+    EXPECT_EQ(0, logTlmHandle_createBuffer(pLog, 1, sizeof(Data)));
+    EXPECT_EQ(0,
+              logTlmHandle_open(pLog, pathDir, "tlmMmap_%m_%d_%Y_%H_%M_%S.log",
+                                4));
+
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+
+    // The second rotation has no next file because there is no flush
+    struct Data data = {0, 0};
+    uint idx;
+    for (idx = 0; idx < 10; idx++) {
+        data.idx = idx;
+        EXPECT_EQ((idx < 8) ? 0 : -2, logTlmHandle_write(pLog, &data));
+    }
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(2, stats.numRecordDropped);
+
+    // The gap marker is written before the next record in the new file
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    data.idx = 10;
+    EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+
+    logTlmHandle_free(pLog);
+
+    struct DataWithHeader {
+        logTlmRecordHeader_t header;
+        Data data;
+    } records[2];
+
+    std::ifstream file(fileCurrent, std::ifstream::binary | std::ifstream::ate);
+    ASSERT_TRUE(file.good());
+    EXPECT_EQ(sizeof(records), file.tellg());
+
+    file.seekg(0);
+    file.read((char *)records, sizeof(records));
+
+    EXPECT_EQ(8 | LOGTLM_SEQUENCE_GAP, records[0].header.sequence);
+    EXPECT_EQ(10, records[1].header.sequence);
+    EXPECT_EQ(10, records[1].data.idx);
+
+    EXPECT_EQ(0, access((fileCurrent + ".1").c_str(), F_OK));
+    remove((fileCurrent + ".0").c_str());
+    remove((fileCurrent + ".1").c_str());
+}
+
+TEST(LogTlm, logTlmMmapRotateInBackground) {
+
+    char *pathDir = "./";
+    uint recordPerFile = 4;
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_setBackend(pLog, LogTlmBackend_Mmap));
+    EXPECT_EQ(0, logTlmHandle_createBuffer(pLog, 1, sizeof(Data)));
+    EXPECT_EQ(0,
+              logTlmHandle_open(pLog, pathDir, "tlmMmap_%m_%d_%Y_%H_%M_%S.log",
+                                recordPerFile));
+
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+
+    // The housekeeping thread prepares the next file without the flush
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 18; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+
+        if ((idx % 4) == 3) {
+            usleep(100000);
+        }
+    }
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(0, stats.numRecordDropped);
+
+    logTlmHandle_free(pLog);
+
+    uint numRecords[5] = {4, 4, 4, 4, 2};
+    std::string filenames[5] = {fileCurrent + ".0", fileCurrent + ".1",
+                                fileCurrent + ".2", fileCurrent + ".3",
+                                fileCurrent};
+
+    struct Data datas[4];
+    uint idxExpect = 0;
+    int idxFile;
+    for (idxFile = 0; idxFile < 5; idxFile++) {
+        std::ifstream file(filenames[idxFile],
+                           std::ifstream::binary | std::ifstream::ate);
+        ASSERT_TRUE(file.good());
+        EXPECT_EQ(numRecords[idxFile] * sizeof(Data), file.tellg());
+
+        file.seekg(0);
+        file.read((char *)datas, numRecords[idxFile] * sizeof(Data));
+
+        for (idx = 0; idx < numRecords[idxFile]; idx++) {
+            EXPECT_EQ(idxExpect, datas[idx].idx);
+            idxExpect += 1;
+        }
+    }
+}
+
+TEST(LogTlm, logTlmRotateInBackground) {
+
+    char *pathDir = "./";
+    uint recordPerFile = 4;
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 3, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmRotate_%m_%d_%Y_%H_%M_%S.log",
+                                   recordPerFile));
+
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    // The next file is prepared ahead of the rotation
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+    std::string fileNext = fileCurrent + ".next";
+
+    sleep(1);
+    EXPECT_EQ(0, access(fileNext.c_str(), F_OK));
+
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 18; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        logTlmHandle_write(pLog, &data);
+
+        // Let the flush thread keep up
+        if ((idx % 3) == 2) {
+            usleep(100000);
+        }
+    }
+
+    sleep(1);
+    EXPECT_FALSE(logTlmHandle_isFlushing(pLog));
+
+    logTlmHandle_free(pLog);
+
+    // The next file is removed when closing
+    EXPECT_NE(0, access(fileNext.c_str(), F_OK));
+
+    uint numRecords[5] = {4, 4, 4, 4, 2};
+    std::string filenames[5] = {fileCurrent + ".0", fileCurrent + ".1",
+                                fileCurrent + ".2", fileCurrent + ".3",
+                                fileCurrent};
+
+    struct Data datas[4];
+    uint idxExpect = 0;
+    int idxFile;
+    for (idxFile = 0; idxFile < 5; idxFile++) {
+        std::ifstream file(filenames[idxFile],
+                           std::ifstream::binary | std::ifstream::ate);
+        ASSERT_TRUE(file.good());
+        EXPECT_EQ(numRecords[idxFile] * sizeof(Data), file.tellg());
+
+        file.seekg(0);
+        file.read((char *)datas, numRecords[idxFile] * sizeof(Data));
+
+        for (idx = 0; idx < numRecords[idxFile]; idx++) {
+            EXPECT_EQ(idxExpect, datas[idx].idx);
+            idxExpect += 1;
+        }
+    }
+}
+
+// Check the container file and its index. The "idxExpect" is the index of the
+// first record in the file and is updated to the next one.
+static void checkContainerFile(std::string filename, uint &idxExpect,
+                               std::vector<uint> numRecordsInBlock,
+                               LogTlmCodec codec = LogTlmCodec_None) {
+
+    std::ifstream file(filename, std::ifstream::binary);
+    ASSERT_TRUE(file.good());
+
+    logTlmFileHeader_t header;
+    file.read((char *)&header, sizeof(header));
+    EXPECT_STREQ(LOGTLM_FILE_MAGIC, header.magic);
+    EXPECT_EQ(LOGTLM_FILE_VERSION, header.version);
+    EXPECT_EQ(sizeof(Data), header.sizeElement);
+    EXPECT_EQ(7, header.schemaId);
+    EXPECT_EQ(3, header.recordPerBlock);
+    EXPECT_EQ(codec, header.codec);
+
+    logTlmFileFooter_t footer;
+    file.seekg(-(int)sizeof(footer), std::ifstream::end);
+    file.read((char *)&footer, sizeof(footer));
+    EXPECT_STREQ(LOGTLM_INDEX_MAGIC, footer.magic);
+    ASSERT_EQ(numRecordsInBlock.size(), footer.numBlock);
+
+    std::vector<logTlmIndexEntry_t> index(footer.numBlock);
+    file.seekg(footer.offsetIndex);
+    file.read((char *)index.data(),
+              footer.numBlock * sizeof(logTlmIndexEntry_t));
+
+    uint idxBlock;
+    for (idxBlock = 0; idxBlock < footer.numBlock; idxBlock++) {
+        EXPECT_EQ(numRecordsInBlock[idxBlock], index[idxBlock].numRecord);
+        EXPECT_LE(index[idxBlock].timeMinNs, index[idxBlock].timeMaxNs);
+
+        logTlmBlockHeader_t headerBlock;
+        file.seekg(index[idxBlock].offset);
+        file.read((char *)&headerBlock, sizeof(headerBlock));
+        EXPECT_EQ(index[idxBlock].numRecord, headerBlock.numRecord);
+        EXPECT_EQ(index[idxBlock].timeMaxNs, headerBlock.timeMaxNs);
+
+        // The block is stored as it is if the encoding is not smaller
+        size_t sizeRaw = headerBlock.numRecord * sizeof(Data);
+        EXPECT_LE(headerBlock.sizeData, sizeRaw);
+
+        LogTlmCodec codec = (headerBlock.sizeData < sizeRaw)
+                                ? (LogTlmCodec)header.codec
+                                : LogTlmCodec_None;
+        std::vector<uint8_t> payload(headerBlock.sizeData);
+        file.read((char *)payload.data(), payload.size());
+
+        std::vector<Data> datas(headerBlock.numRecord);
+        EXPECT_EQ(0, logTlmCodec_decode(codec, payload.data(), payload.size(),
+                                        headerBlock.numRecord, sizeof(Data),
+                                        datas.data()));
+
+        uint idx;
+        for (idx = 0; idx < headerBlock.numRecord; idx++) {
+            EXPECT_EQ(idxExpect, datas[idx].idx);
+            EXPECT_EQ(10 * idxExpect, datas[idx].value);
+
+            idxExpect += 1;
+        }
+    }
+}
+
+TEST(LogTlm, logTlmContainer) {
+
+    char *pathDir = "./";
+
+    LogTlmBackend backends[2] = {LogTlmBackend_Stream, LogTlmBackend_Direct};
+    int idxBackend;
+    for (idxBackend = 0; idxBackend < 2; idxBackend++) {
+        logTlm_handle_t pLog = logTlmHandle_init();
+        ASSERT_NE(nullptr, pLog);
+
+        EXPECT_EQ(-1, logTlmHandle_setFormat(pLog, (LogTlmFormat)0, 7));
+        EXPECT_EQ(0, logTlmHandle_setFormat(pLog, LogTlmFormat_Container, 7));
+        EXPECT_EQ(-1, logTlmHandle_setBackend(pLog, LogTlmBackend_Mmap));
+        EXPECT_EQ(0, logTlmHandle_setBackend(pLog, backends[idxBackend]));
+
+        EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 3, sizeof(Data)));
+        EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                       "tlmContainer_%m_%d_%Y_%H_%M_%S.log",
+                                       4));
+
+        struct Data data;
+        uint idx;
+        for (idx = 0; idx < 10; idx++) {
+            data.idx = idx;
+            data.value = 10 * idx;
+            logTlmHandle_write(pLog, &data);
+        }
+
+        EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+        std::string fileCurrent = logTlmHandle_getFilename(pLog);
+        logTlmHandle_free(pLog);
+
+        // The buffer is split into 2 blocks when the file is rotated
+        uint idxExpect = 0;
+        checkContainerFile(fileCurrent + ".0", idxExpect, {3, 1});
+        checkContainerFile(fileCurrent + ".1", idxExpect, {2, 2});
+        checkContainerFile(fileCurrent, idxExpect, {1, 1});
+        EXPECT_EQ(10, idxExpect);
+    }
+}
+
+TEST(LogTlm, logTlmContainerCodec) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(-1, logTlmHandle_setCodec(pLog, LogTlmCodec_XorShuffle));
+    EXPECT_EQ(0, logTlmHandle_setFormat(pLog, LogTlmFormat_Container, 7));
+    EXPECT_EQ(-1, logTlmHandle_setCodec(pLog, (LogTlmCodec)0));
+    EXPECT_EQ(0, logTlmHandle_setCodec(pLog, LogTlmCodec_XorShuffle));
+
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 3, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmCodec_%m_%d_%Y_%H_%M_%S.log", 4));
+
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 10; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        logTlmHandle_write(pLog, &data);
+    }
+
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    std::string fileCurrent = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    uint idxExpect = 0;
+    checkContainerFile(fileCurrent + ".0", idxExpect, {3, 1},
+                       LogTlmCodec_XorShuffle);
+    checkContainerFile(fileCurrent + ".1", idxExpect, {2, 2},
+                       LogTlmCodec_XorShuffle);
+    checkContainerFile(fileCurrent, idxExpect, {1, 1},
+                       LogTlmCodec_XorShuffle);
+    EXPECT_EQ(10, idxExpect);
+
+    // The blocks of 3 records are smaller than the raw data
+    std::ifstream file(fileCurrent + ".0",
+                       std::ifstream::binary | std::ifstream::ate);
+    EXPECT_LT(file.tellg(), sizeof(logTlmFileHeader_t) +
+                                2 * sizeof(logTlmBlockHeader_t) +
+                                4 * sizeof(Data) +
+                                2 * sizeof(logTlmIndexEntry_t) +
+                                sizeof(logTlmFileFooter_t));
+}
+
+TEST(LogTlm, logTlmContainerColumns) {
+
+    char *pathDir = "./";
+
+    logTlmField_t fields[2] = {{offsetof(Data, value), sizeof(uint)},
+                               {offsetof(Data, idx), sizeof(uint)}};
+
+    LogTlmCodec codecs[2] = {LogTlmCodec_None, LogTlmCodec_XorShuffle};
+    int idxCodec;
+    for (idxCodec = 0; idxCodec < 2; idxCodec++) {
+        logTlm_handle_t pLog = logTlmHandle_init();
+        ASSERT_NE(nullptr, pLog);
+
+        EXPECT_EQ(-1, logTlmHandle_setColumns(pLog, fields, 2));
+        EXPECT_EQ(0, logTlmHandle_setFormat(pLog, LogTlmFormat_Container, 7));
+        EXPECT_EQ(0, logTlmHandle_setCodec(pLog, codecs[idxCodec]));
+        EXPECT_EQ(0, logTlmHandle_setColumns(pLog, fields, 2));
+
+        EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 5, sizeof(Data)));
+        EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                       "tlmColumns_%m_%d_%Y_%H_%M_%S.log",
+                                       100));
+
+        struct Data data;
+        uint idx;
+        for (idx = 0; idx < 10; idx++) {
+            data.idx = idx;
+            data.value = 10 * idx;
+            logTlmHandle_write(pLog, &data);
+        }
+
+        std::string filename = logTlmHandle_getFilename(pLog);
+        logTlmHandle_free(pLog);
+
+        std::ifstream file(filename, std::ifstream::binary);
+        ASSERT_TRUE(file.good());
+
+        logTlmFileHeader_t header;
+        file.read((char *)&header, sizeof(header));
+        EXPECT_EQ(2, header.numField);
+        EXPECT_EQ(codecs[idxCodec], header.codec);
+
+        logTlmField_t fieldsInFile[2];
+        file.read((char *)fieldsInFile, sizeof(fieldsInFile));
+        EXPECT_EQ(offsetof(Data, value), fieldsInFile[0].offset);
+        EXPECT_EQ(offsetof(Data, idx), fieldsInFile[1].offset);
+
+        // Read the column of "idx" of each block only
+        uint idxExpect = 0;
+        int idxBlock;
+        for (idxBlock = 0; idxBlock < 2; idxBlock++) {
+            logTlmBlockHeader_t headerBlock;
+            file.read((char *)&headerBlock, sizeof(headerBlock));
+            EXPECT_EQ(5, headerBlock.numRecord);
+
+            uint32_t sizeColumns[2];
+            file.read((char *)sizeColumns, sizeof(sizeColumns));
+            EXPECT_EQ(sizeof(sizeColumns) + sizeColumns[0] + sizeColumns[1],
+                      headerBlock.sizeData);
+
+            size_t sizeRaw = headerBlock.numRecord * sizeof(uint);
+            if (codecs[idxCodec] == LogTlmCodec_None) {
+                EXPECT_EQ(sizeRaw, sizeColumns[1]);
+            } else {
+                EXPECT_LT(sizeColumns[1], sizeRaw);
+            }
+
+            file.seekg(sizeColumns[0], std::ifstream::cur);
+
+            std::vector<uint8_t> column(sizeColumns[1]);
+            file.read((char *)column.data(), column.size());
+
+            uint values[5];
+            LogTlmCodec codec = (sizeColumns[1] < sizeRaw)
+                                    ? (LogTlmCodec)header.codec
+                                    : LogTlmCodec_None;
+            EXPECT_EQ(0, logTlmCodec_decode(codec, column.data(),
+                                            column.size(), 5, sizeof(uint),
+                                            values));
+
+            for (idx = 0; idx < 5; idx++) {
+                EXPECT_EQ(idxExpect, values[idx]);
+                idxExpect += 1;
+            }
+        }
+    }
+}
+
+TEST(LogTlm, logTlmRecordHeader) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_setFormat(pLog, LogTlmFormat_Container, 1));
+    EXPECT_EQ(0, logTlmHandle_setRecordHeader(pLog, true));
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 5, sizeof(Data)));
+
+    // The buffers are created already
+    EXPECT_EQ(-1, logTlmHandle_setRecordHeader(pLog, false));
+
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmRecordHeader_%m_%d_%Y_%H_%M_%S.log",
+                                   100));
+
+    struct timespec timeTai;
+    clock_gettime(CLOCK_TAI, &timeTai);
+    int64_t timeStartNs = timeTai.tv_sec * 1000000000LL + timeTai.tv_nsec;
+
+    struct Data data;
+    uint idx;
+    for (idx = 0; idx < 10; idx++) {
+        data.idx = idx;
+        data.value = 10 * idx;
+        logTlmHandle_write(pLog, &data);
+    }
+
+    clock_gettime(CLOCK_TAI, &timeTai);
+    int64_t timeEndNs = timeTai.tv_sec * 1000000000LL + timeTai.tv_nsec;
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    std::ifstream file(filename, std::ifstream::binary);
+    ASSERT_TRUE(file.good());
+
+    logTlmFileHeader_t header;
+    file.read((char *)&header, sizeof(header));
+    EXPECT_EQ(LOGTLM_FLAG_RECORD_HEADER, header.flags);
+    EXPECT_EQ(sizeof(logTlmRecordHeader_t) + sizeof(Data), header.sizeElement);
+
+    // Each record has the sequence number and TAI time
+    int64_t timeLastNs = timeStartNs;
+    idx = 0;
+    int idxBlock;
+    for (idxBlock = 0; idxBlock < 2; idxBlock++) {
+        logTlmBlockHeader_t headerBlock;
+        file.read((char *)&headerBlock, sizeof(headerBlock));
+        ASSERT_EQ(5, headerBlock.numRecord);
+
+        int idxRecord;
+        for (idxRecord = 0; idxRecord < 5; idxRecord++) {
+            logTlmRecordHeader_t headerRecord;
+            file.read((char *)&headerRecord, sizeof(headerRecord));
+            file.read((char *)&data, sizeof(data));
+
+            EXPECT_EQ(idx, headerRecord.sequence);
+            EXPECT_EQ(idx, data.idx);
+
+            // The offset of TAI time is updated in the flush
+            EXPECT_GE(headerRecord.timeNs, timeLastNs - 1000000);
+            EXPECT_LE(headerRecord.timeNs, timeEndNs + 1000000);
+            timeLastNs = headerRecord.timeNs;
+
+            if (idxRecord == 0) {
+                EXPECT_EQ(headerRecord.timeNs, headerBlock.timeMinNs);
+            }
+
+            idx++;
+        }
+    }
+}
+
+TEST(LogTlm, logTlmDurability) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(-1, logTlmHandle_setDurability(pLog, (LogTlmDurability)0, 1));
+    EXPECT_EQ(-1, logTlmHandle_setDurability(pLog, LogTlmDurability_Bytes, 0));
+    EXPECT_EQ(-1, logTlmHandle_setDurability(pLog, LogTlmDurability_Time, -1));
+
+    // Synchronize every 2 records
+    EXPECT_EQ(0, logTlmHandle_setDurability(pLog, LogTlmDurability_Bytes,
+                                            2 * sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 3, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmDurability_%m_%d_%Y_%H_%M_%S.log",
+                                   100));
+
+    // The file is opened already
+    EXPECT_EQ(-1,
+              logTlmHandle_setDurability(pLog, LogTlmDurability_None, 0));
+
+    // Without the flush thread, fdatasync() is called in the flush
+    struct Data data = {1, 10};
+    logTlmHandle_write(pLog, &data);
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(0, stats.numSync);
+
+    logTlmHandle_write(pLog, &data);
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(1, stats.numSync);
+    EXPECT_EQ(0, stats.numSyncFailed);
+    EXPECT_GE(stats.timeSyncMaxNs, 0);
+    EXPECT_GE(stats.timeSyncTotalNs, stats.timeSyncMaxNs);
+
+    // The housekeeping thread calls fdatasync() of the full buffers
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    uint idx;
+    for (idx = 0; idx < 6; idx++) {
+        logTlmHandle_write(pLog, &data);
+        usleep(10000);
+    }
+
+    sleep(1);
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_GE(stats.numSync, 2);
+
+    // The file is synchronized when closing
+    long numSync = stats.numSync;
+    logTlmHandle_closeThread(pLog);
+    EXPECT_EQ(0, logTlmHandle_close(pLog));
+
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(numSync + 1, stats.numSync);
+
+    logTlmHandle_free(pLog);
+}
+
+TEST(LogTlm, logTlmDurabilityRotation) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    // Synchronize every buffer and rotate every 2 buffers
+    EXPECT_EQ(0, logTlmHandle_setDurability(pLog, LogTlmDurability_Bytes,
+                                            sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 4, 2, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmDurability_%m_%d_%Y_%H_%M_%S.log", 4));
+
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    // The synchronization of each file is not skipped or done on the closed
+    // file after the rotation
+    struct Data data = {1, 10};
+    uint idx;
+    for (idx = 0; idx < 40; idx++) {
+        logTlmHandle_write(pLog, &data);
+        if ((idx % 2) == 1) {
+            usleep(1000);
+        }
+    }
+
+    logTlmHandle_closeThread(pLog);
+    EXPECT_EQ(0, logTlmHandle_close(pLog));
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+
+    EXPECT_EQ(0, stats.numSyncFailed);
+    EXPECT_GE(stats.numSync, 10);
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    for (idx = 0; idx < 10; idx++) {
+        remove((filename + "." + std::to_string(idx)).c_str());
+    }
+}
+
+TEST(LogTlm, logTlmDecimation) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    // The buffers are needed
+    EXPECT_EQ(-1, logTlmHandle_setDecimation(pLog, LogTlmDecimation_Sample, 2,
+                                             NULL, 0));
+
+    EXPECT_EQ(0,
+              logTlmHandle_createBufferPool(pLog, 2, 5, sizeof(DataCapture)));
+
+    EXPECT_EQ(-1, logTlmHandle_setDecimation(pLog, LogTlmDecimation_Sample, 0,
+                                             NULL, 0));
+
+    // The field should be an array of double
+    logTlmField_t fieldIdx = {offsetof(DataCapture, idx), sizeof(uint)};
+    EXPECT_EQ(-1, logTlmHandle_setDecimation(
+                      pLog, LogTlmDecimation_MinMaxMean, 4, &fieldIdx, 1));
+
+    logTlmField_t field = {offsetof(DataCapture, value), sizeof(double)};
+    EXPECT_EQ(0, logTlmHandle_setDecimation(pLog, LogTlmDecimation_MinMaxMean,
+                                            4, &field, 1));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmDecimation_%m_%d_%Y_%H_%M_%S.log",
+                                   100));
+
+    struct DataCapture data = {};
+    uint idx;
+    for (idx = 0; idx < 10; idx++) {
+        data.idx = idx;
+        data.value = idx;
+        EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+    }
+
+    // The partial window of the last 2 records
+    EXPECT_EQ(0, logTlmHandle_flushCapture(pLog));
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    std::vector<DataCapture> records = readCapture(filename);
+    ASSERT_EQ(9, records.size());
+
+    double values[9] = {0, 3, 1.5, 4, 7, 5.5, 8, 9, 8.5};
+    uint indexes[3] = {3, 7, 9};
+    for (idx = 0; idx < 9; idx++) {
+        EXPECT_DOUBLE_EQ(values[idx], records[idx].value);
+        EXPECT_EQ(indexes[idx / 3], records[idx].idx);
+    }
+}
+
+TEST(LogTlm, logTlmTrigger) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0,
+              logTlmHandle_createBufferPool(pLog, 2, 5, sizeof(DataCapture)));
+
+    EXPECT_EQ(-1, logTlmHandle_setTrigger(pLog, isFault, NULL, -1, 1));
+
+    // Keep 2 records before the fault and write 1 record after it
+    EXPECT_EQ(0, logTlmHandle_setDecimation(pLog, LogTlmDecimation_Sample, 3,
+                                            NULL, 0));
+    EXPECT_EQ(0, logTlmHandle_setTrigger(pLog, isFault, NULL, 2, 1));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmTrigger_%m_%d_%Y_%H_%M_%S.log", 100));
+
+    struct DataCapture data = {};
+    uint idx;
+    for (idx = 0; idx < 20; idx++) {
+        data.idx = idx;
+        data.statusWord.fault = (idx == 10);
+        logTlmHandle_write(pLog, &data);
+    }
+
+    logTlmHandle_flushCapture(pLog);
+    logTlmHandle_flush(pLog);
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(1, stats.numTrigger);
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    // One of 3 records is written except the 2 records before the fault, the
+    // fault, and 1 record after it
+    std::vector<uint> indexes;
+    for (const DataCapture &record : readCapture(filename)) {
+        indexes.push_back(record.idx);
+    }
+
+    EXPECT_EQ(std::vector<uint>({0, 3, 6, 8, 9, 10, 11, 13, 16, 19}),
+              indexes);
+}
+
+TEST(LogTlm, logTlmRetention) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    logTlmRetention_t retention = {-1, 0, false};
+    EXPECT_EQ(-1, logTlmHandle_setRetention(pLog, &retention));
+
+    // Keep 2 rotated files of 4 records
+    retention.sizeMax = 2 * 4 * sizeof(Data);
+    EXPECT_EQ(0, logTlmHandle_setRetention(pLog, &retention));
+
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 4, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmRetention_%m_%d_%Y_%H_%M_%S.log", 4));
+
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    struct Data data = {1, 10};
+    uint idx;
+    for (idx = 0; idx < 24; idx++) {
+        logTlmHandle_write(pLog, &data);
+        usleep(10000);
+    }
+
+    sleep(1);
+
+    // Only the newest 2 rotated files are left
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(2, stats.accountRetention.numFile);
+    EXPECT_EQ(retention.sizeMax, stats.accountRetention.size);
+    EXPECT_GE(stats.accountRetention.numFileDeleted, 3);
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    long idOldest = stats.accountRetention.numFileDeleted;
+    std::string fileDeleted = filename + "." + std::to_string(idOldest - 1);
+    std::string fileOldest = filename + "." + std::to_string(idOldest);
+    EXPECT_NE(0, access(fileDeleted.c_str(), F_OK));
+    EXPECT_EQ(0, access(fileOldest.c_str(), F_OK));
+
+    // Stop the retention
+    EXPECT_EQ(0, logTlmHandle_setRetention(pLog, NULL));
+
+    logTlmHandle_free(pLog);
+}
+
+TEST(LogTlm, logTlmRetentionAfterThreadRestart) {
+
+    char *pathDir = "./";
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    // Keep 2 rotated files of 4 records
+    logTlmRetention_t retention = {2 * 4 * sizeof(Data), 0, false};
+    EXPECT_EQ(0, logTlmHandle_setRetention(pLog, &retention));
+
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 4, sizeof(Data)));
+    EXPECT_EQ(0, logTlmHandle_open(pLog, pathDir,
+                                   "tlmRetentionRestart_%m_%d_%Y_%H_%M_%S.log",
+                                   4));
+
+    // The retention keeps working after the flush thread is restarted
+    int timeInMs = 10;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+    logTlmHandle_closeThread(pLog);
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    struct Data data = {1, 10};
+    uint idx;
+    for (idx = 0; idx < 24; idx++) {
+        logTlmHandle_write(pLog, &data);
+        usleep(10000);
+    }
+
+    sleep(1);
+
+    logTlmStats_t stats;
+    logTlmHandle_getStats(pLog, &stats);
+    EXPECT_EQ(2, stats.accountRetention.numFile);
+    EXPECT_GE(stats.accountRetention.numFileDeleted, 3);
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    EXPECT_NE(0, access((filename + ".0").c_str(), F_OK));
+
+    logTlmHandle_free(pLog);
+}
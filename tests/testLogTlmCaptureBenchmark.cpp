@@ -0,0 +1,128 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "ds402.h"
+#include "logTlm.h"
+}
+
+// Number of records in a buffer
+static const int NUM_RECORD_BUFFER = 1000;
+
+// Number of records to write in each benchmark, which is 100 s at 1 kHz
+static const int NUM_RECORD_BENCHMARK = 100000;
+
+// Get the current monotonic time in nanosecond
+static long nowInNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Telemetry of a hexapod at 1 kHz with the status word of drive
+struct DataCaptureBench {
+    uint idx;
+    ds402_status_word statusWord;
+    double positionCommand[6];
+    double positionActual[6];
+    double current[6];
+    double timestamp;
+};
+
+// Trigger the full-rate capture by the fault bit of status word.
+static bool isFaultBench(void *pUser, const void *pData) {
+    return ((const DataCaptureBench *)pData)->statusWord.fault;
+}
+
+// Write the records with the decimation and trigger, and print the throughput
+// and disk usage. The drive has a fault in 10 records of every 10000 if
+// "isTrigger" is true.
+// Return the size of file in bytes.
+static long runCaptureBenchmark(LogTlmDecimation decimation, bool isTrigger,
+                                const char *pName) {
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    EXPECT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, NUM_RECORD_BUFFER,
+                                               sizeof(DataCaptureBench)));
+
+    logTlmField_t field = {offsetof(DataCaptureBench, positionCommand),
+                           18 * sizeof(double)};
+    EXPECT_EQ(0, logTlmHandle_setDecimation(pLog, decimation, 10, &field, 1));
+
+    if (isTrigger) {
+        EXPECT_EQ(0, logTlmHandle_setTrigger(pLog, isFaultBench, NULL, 500,
+                                             500));
+    }
+
+    // No rotation in the benchmark
+    EXPECT_EQ(0, logTlmHandle_open(pLog, "./", "tlmCaptureBench.log",
+                                   2 * NUM_RECORD_BENCHMARK));
+
+    DataCaptureBench data = {};
+    srand(1);
+
+    long timeStart = nowInNs();
+
+    int idx, axis;
+    for (idx = 0; idx < NUM_RECORD_BENCHMARK; idx++) {
+        data.idx = idx;
+        data.statusWord.fault = isTrigger && ((idx % 10000) >= 9990);
+        data.timestamp = 1.7e9 + 0.001 * idx;
+
+        for (axis = 0; axis < 6; axis++) {
+            double position = 1000.0 * axis + 0.05 * idx;
+            data.positionCommand[axis] = position;
+            data.positionActual[axis] = std::round(position * 100) / 100;
+            data.current[axis] = 1.5 + 0.001 * (rand() % 20);
+        }
+
+        logTlmHandle_write(pLog, &data);
+    }
+
+    logTlmHandle_flushCapture(pLog);
+    logTlmHandle_flush(pLog);
+
+    long timeWrite = nowInNs() - timeStart;
+
+    std::string filename = logTlmHandle_getFilename(pLog);
+    logTlmHandle_free(pLog);
+
+    struct stat info;
+    EXPECT_EQ(0, stat(filename.c_str(), &info));
+    remove(filename.c_str());
+
+    printf("%s: %.2f M records/s, %.2f MB on disk\n", pName,
+           1e-6 * NUM_RECORD_BENCHMARK / (1e-9 * timeWrite),
+           1e-6 * info.st_size);
+
+    return info.st_size;
+}
+
+TEST(LogTlmCaptureBenchmark, captureThroughputAndDiskUsage) {
+
+    long sizeFull = runCaptureBenchmark(LogTlmDecimation_None, false,
+                                        "Full rate");
+    EXPECT_EQ(NUM_RECORD_BENCHMARK * sizeof(DataCaptureBench), sizeFull);
+
+    long sizeSample = runCaptureBenchmark(LogTlmDecimation_Sample, false,
+                                          "One of 10 records");
+    EXPECT_EQ(sizeFull / 10, sizeSample);
+
+    long sizeWindow = runCaptureBenchmark(LogTlmDecimation_MinMaxMean, false,
+                                          "Min/max/mean of 10 records");
+    EXPECT_EQ(3 * sizeSample, sizeWindow);
+
+    // The full-rate capture of about 1000 records around each fault
+    long sizeTrigger =
+        runCaptureBenchmark(LogTlmDecimation_MinMaxMean, true,
+                            "Min/max/mean with the triggered capture");
+    EXPECT_GT(sizeTrigger, sizeWindow);
+    EXPECT_LT(sizeTrigger, sizeFull / 2);
+}
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "logTlmCodec.h"
+}
+
+struct DataCodec {
+    uint idx;
+    uint state;
+    double position[3];
+    double current;
+};
+
+// Fill the records that change slowly with the constant state.
+static void fillRecords(std::vector<DataCodec> &records) {
+    uint idx;
+    for (idx = 0; idx < records.size(); idx++) {
+        records[idx].idx = idx;
+        records[idx].state = 3;
+        records[idx].position[0] = 1000.0 + 0.25 * (idx / 10);
+        records[idx].position[1] = -20.0;
+        records[idx].position[2] = 0.5;
+        records[idx].current = std::round(100 * std::sin(0.001 * idx)) / 100;
+    }
+}
+
+TEST(LogTlmCodec, encodeDecode) {
+
+    std::vector<DataCodec> records(500);
+    fillRecords(records);
+
+    size_t sizeRecords = records.size() * sizeof(DataCodec);
+    std::vector<uint8_t> encoded(sizeRecords);
+    std::vector<DataCodec> decoded(records.size());
+
+    long sizeEncoded = logTlmCodec_encode(
+        LogTlmCodec_XorShuffle, records.data(), records.size(),
+        sizeof(DataCodec), encoded.data(), encoded.size());
+    ASSERT_GT(sizeEncoded, 0);
+    EXPECT_LT(sizeEncoded, sizeRecords / 4);
+
+    EXPECT_EQ(0, logTlmCodec_decode(LogTlmCodec_XorShuffle, encoded.data(),
+                                    sizeEncoded, records.size(),
+                                    sizeof(DataCodec), decoded.data()));
+    EXPECT_EQ(0, memcmp(records.data(), decoded.data(), sizeRecords));
+
+    // The corrupted data is detected
+    EXPECT_EQ(-1, logTlmCodec_decode(LogTlmCodec_XorShuffle, encoded.data(),
+                                     sizeEncoded - 1, records.size(),
+                                     sizeof(DataCodec), decoded.data()));
+}
+
+TEST(LogTlmCodec, encodeRandom) {
+
+    // The random data does not fit in the size of raw data
+    std::vector<uint8_t> records(1000);
+    srand(1);
+
+    uint idx;
+    for (idx = 0; idx < records.size(); idx++) {
+        records[idx] = rand() % 255 + 1;
+    }
+
+    std::vector<uint8_t> encoded(records.size());
+    EXPECT_EQ(-1, logTlmCodec_encode(LogTlmCodec_XorShuffle, records.data(),
+                                     records.size() / 8, 8, encoded.data(),
+                                     encoded.size()));
+
+    // No encoding
+    EXPECT_EQ(records.size(),
+              logTlmCodec_encode(LogTlmCodec_None, records.data(),
+                                 records.size() / 8, 8, encoded.data(),
+                                 encoded.size()));
+    EXPECT_EQ(-1, logTlmCodec_encode((LogTlmCodec)0, records.data(),
+                                     records.size() / 8, 8, encoded.data(),
+                                     encoded.size()));
+}
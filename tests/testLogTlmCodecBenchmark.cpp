@@ -0,0 +1,118 @@
+#include <cmath>
+#include <time.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "logTlmCodec.h"
+}
+
+// Number of records in a block, which is the size of a buffer in logTlm
+static const int NUM_RECORD_BLOCK = 1000;
+
+// Number of blocks to encode in each benchmark
+static const int NUM_BLOCK_BENCHMARK = 200;
+
+// Get the current monotonic time in nanosecond
+static long nowInNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Telemetry of a hexapod at 1 kHz: the states and commands are constant, the
+// encoder positions are quantized, and the currents are noisy.
+struct DataBench {
+    uint idx;
+    uint state;
+    uint mode;
+    uint faults;
+    double positionCommand[6];
+    double positionActual[6];
+    double current[6];
+    double timestamp;
+};
+
+// Encode and decode the block and print the ratio and throughput.
+// Return the compression ratio.
+static double runCodecBenchmark(std::vector<DataBench> &records,
+                                const char *pName) {
+
+    size_t sizeRecords = records.size() * sizeof(DataBench);
+    std::vector<uint8_t> encoded(sizeRecords);
+    std::vector<DataBench> decoded(records.size());
+
+    long sizeEncoded = 0;
+    long timeStart = nowInNs();
+
+    int idx;
+    for (idx = 0; idx < NUM_BLOCK_BENCHMARK; idx++) {
+        sizeEncoded = logTlmCodec_encode(
+            LogTlmCodec_XorShuffle, records.data(), records.size(),
+            sizeof(DataBench), encoded.data(), encoded.size());
+    }
+
+    long timeEncode = nowInNs() - timeStart;
+
+    // The raw data is stored if the encoding is not smaller
+    if (sizeEncoded < 0) {
+        sizeEncoded = sizeRecords;
+    }
+
+    timeStart = nowInNs();
+    for (idx = 0; idx < NUM_BLOCK_BENCHMARK; idx++) {
+        logTlmCodec_decode(LogTlmCodec_XorShuffle, encoded.data(), sizeEncoded,
+                           records.size(), sizeof(DataBench), decoded.data());
+    }
+
+    long timeDecode = nowInNs() - timeStart;
+
+    double sizeTotalMb = 1e-6 * sizeRecords * NUM_BLOCK_BENCHMARK;
+    double ratio = (double)sizeRecords / sizeEncoded;
+    printf("%s: ratio %.2f, encode %.1f MB/s, decode %.1f MB/s\n", pName,
+           ratio, sizeTotalMb / (1e-9 * timeEncode),
+           sizeTotalMb / (1e-9 * timeDecode));
+
+    return ratio;
+}
+
+TEST(LogTlmCodecBenchmark, codecRatioAndThroughput) {
+
+    std::vector<DataBench> records(NUM_RECORD_BLOCK);
+    srand(1);
+
+    int idx, axis;
+    for (idx = 0; idx < NUM_RECORD_BLOCK; idx++) {
+        DataBench &record = records[idx];
+        record.idx = idx;
+        record.state = 2;
+        record.mode = 1;
+        record.faults = 0;
+        record.timestamp = 1.7e9 + 0.001 * idx;
+
+        for (axis = 0; axis < 6; axis++) {
+            // Slow move with the encoder resolution of 0.01 um
+            double position = 1000.0 * axis + 0.05 * idx;
+            record.positionCommand[axis] = position;
+            record.positionActual[axis] = std::round(position * 100) / 100;
+
+            // Current in mA with the noise
+            record.current[axis] = 1.5 + 0.001 * (rand() % 20);
+        }
+    }
+
+    double ratio = runCodecBenchmark(records, "Hexapod telemetry");
+    EXPECT_GT(ratio, 1.0);
+
+    // The records while the hexapod is standing still
+    for (idx = 0; idx < NUM_RECORD_BLOCK; idx++) {
+        for (axis = 0; axis < 6; axis++) {
+            records[idx].positionCommand[axis] = 1000.0 * axis;
+            records[idx].positionActual[axis] = 1000.0 * axis;
+        }
+    }
+
+    EXPECT_GT(runCodecBenchmark(records, "Hexapod telemetry in standstill"),
+              ratio);
+}
@@ -0,0 +1,347 @@
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "logTlmReader.h"
+}
+
+struct DataReader {
+    uint idx;
+    uint value;
+};
+
+struct LogTlmReaderTest : testing::Test {
+
+    char *pathDir = "./";
+
+    std::string filename;
+
+    // Write 10 records in 2 blocks of 5 records. There is a gap of time
+    // between the blocks.
+    void writeRecords(LogTlmFormat format, LogTlmCodec codec, bool isColumnar,
+                      int recordPerFile, bool isRecordHeader = false) {
+        logTlm_handle_t pLog = logTlmHandle_init();
+        ASSERT_NE(nullptr, pLog);
+
+        ASSERT_EQ(0, logTlmHandle_setRecordHeader(pLog, isRecordHeader));
+
+        ASSERT_EQ(0, logTlmHandle_setFormat(pLog, format, 1));
+        if (format == LogTlmFormat_Container) {
+            ASSERT_EQ(0, logTlmHandle_setCodec(pLog, codec));
+        }
+
+        if (isColumnar) {
+            logTlmField_t fields[2] = {
+                {offsetof(DataReader, value), sizeof(uint)},
+                {offsetof(DataReader, idx), sizeof(uint)}};
+            ASSERT_EQ(0, logTlmHandle_setColumns(pLog, fields, 2));
+        }
+
+        ASSERT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 5,
+                                                   sizeof(DataReader)));
+        ASSERT_EQ(0, logTlmHandle_open(pLog, pathDir, "tlmReader.log",
+                                       recordPerFile));
+
+        struct DataReader data;
+        uint idx;
+        for (idx = 0; idx < 10; idx++) {
+            if (idx == 5) {
+                usleep(10000);
+            }
+
+            data.idx = idx;
+            data.value = 10 * idx;
+            logTlmHandle_write(pLog, &data);
+        }
+
+        filename = logTlmHandle_getFilename(pLog);
+        logTlmHandle_free(pLog);
+    }
+
+    ~LogTlmReaderTest() {
+        if (!filename.empty()) {
+            remove(filename.c_str());
+
+            int id;
+            for (id = 0; id < 10; id++) {
+                remove((filename + "." + std::to_string(id)).c_str());
+            }
+        }
+    }
+};
+
+// Read all the records and check the values.
+// Return the times of records.
+static std::vector<int64_t> readAll(logTlmReader_handle_t pReader) {
+    std::vector<int64_t> times;
+
+    const void *pRecord = NULL;
+    int64_t timeNs = 0;
+    while (logTlmReader_next(pReader, &pRecord, &timeNs) == 1) {
+        const DataReader *pData = (const DataReader *)pRecord;
+        EXPECT_EQ(10 * pData->idx, pData->value);
+        EXPECT_EQ(times.size(), pData->idx);
+
+        times.push_back(timeNs);
+    }
+
+    return times;
+}
+
+static int countRecord(void *pUser, const void *pRecord, size_t sizeRecord) {
+    EXPECT_EQ(sizeof(DataReader), sizeRecord);
+    *(int *)pUser += 1;
+
+    return 0;
+}
+
+static int failRecord(void *pUser, const void *pRecord, size_t sizeRecord) {
+    return -1;
+}
+
+TEST(LogTlmReader, open) {
+
+    EXPECT_EQ(nullptr, logTlmReader_open("tlmReaderNoFile.log", 8));
+}
+
+TEST_F(LogTlmReaderTest, readRaw) {
+
+    writeRecords(LogTlmFormat_Raw, LogTlmCodec_None, false, 5);
+
+    // The raw file needs the element size
+    EXPECT_EQ(nullptr, logTlmReader_open(filename.c_str(), 0));
+
+    logTlmReader_handle_t pReader =
+        logTlmReader_open(filename.c_str(), sizeof(DataReader));
+    ASSERT_NE(nullptr, pReader);
+
+    // Rotated files of "file.0", "file.1", and "file"
+    EXPECT_EQ(3, logTlmReader_getNumFile(pReader));
+    EXPECT_EQ(10, logTlmReader_getNumRecord(pReader));
+    EXPECT_EQ(sizeof(DataReader), logTlmReader_getSizeElement(pReader));
+
+    std::vector<int64_t> times = readAll(pReader);
+    EXPECT_EQ(10, times.size());
+    EXPECT_EQ(0, times[0]);
+
+    // Decimation
+    logTlmReader_setDecimation(pReader, 3);
+
+    std::vector<uint> indexes;
+    const void *pRecord = NULL;
+    while (logTlmReader_next(pReader, &pRecord, NULL) == 1) {
+        indexes.push_back(((const DataReader *)pRecord)->idx);
+    }
+    EXPECT_EQ(std::vector<uint>({0, 3, 6, 9}), indexes);
+
+    logTlmReader_close(pReader);
+}
+
+TEST_F(LogTlmReaderTest, readWithoutOldestFile) {
+
+    writeRecords(LogTlmFormat_Raw, LogTlmCodec_None, false, 5);
+
+    // Deleted by the retention
+    remove((filename + ".0").c_str());
+
+    logTlmReader_handle_t pReader =
+        logTlmReader_open(filename.c_str(), sizeof(DataReader));
+    ASSERT_NE(nullptr, pReader);
+
+    EXPECT_EQ(2, logTlmReader_getNumFile(pReader));
+
+    const void *pRecord = NULL;
+    ASSERT_EQ(1, logTlmReader_next(pReader, &pRecord, NULL));
+    EXPECT_EQ(5, ((const DataReader *)pRecord)->idx);
+
+    logTlmReader_close(pReader);
+}
+
+TEST_F(LogTlmReaderTest, readContainer) {
+
+    LogTlmCodec codecs[2] = {LogTlmCodec_None, LogTlmCodec_XorShuffle};
+    int idxCodec, idxLayout;
+    for (idxCodec = 0; idxCodec < 2; idxCodec++) {
+        for (idxLayout = 0; idxLayout < 2; idxLayout++) {
+            writeRecords(LogTlmFormat_Container, codecs[idxCodec],
+                         (idxLayout == 1), 100);
+
+            logTlmReader_handle_t pReader =
+                logTlmReader_open(filename.c_str(), 0);
+            ASSERT_NE(nullptr, pReader);
+
+            EXPECT_EQ(1, logTlmReader_getNumFile(pReader));
+            EXPECT_EQ(sizeof(DataReader),
+                      logTlmReader_getSizeElement(pReader));
+
+            std::vector<int64_t> times = readAll(pReader);
+            ASSERT_EQ(10, times.size());
+
+            int idx;
+            for (idx = 1; idx < 10; idx++) {
+                EXPECT_LE(times[idx - 1], times[idx]);
+            }
+
+            // Time range of the second block
+            logTlmReader_setTimeRange(pReader, times[5], INT64_MAX);
+
+            const void *pRecord = NULL;
+            int64_t timeNs = 0;
+            ASSERT_EQ(1, logTlmReader_next(pReader, &pRecord, &timeNs));
+            EXPECT_EQ(5, ((const DataReader *)pRecord)->idx);
+            EXPECT_EQ(times[5], timeNs);
+
+            // No record after the last one
+            logTlmReader_setTimeRange(pReader, times[9] + 1, INT64_MAX);
+            EXPECT_EQ(0, logTlmReader_next(pReader, &pRecord, &timeNs));
+
+            logTlmReader_close(pReader);
+
+            remove(filename.c_str());
+        }
+    }
+}
+
+TEST_F(LogTlmReaderTest, readRecordHeader) {
+
+    writeRecords(LogTlmFormat_Container, LogTlmCodec_XorShuffle, false, 100,
+                 true);
+
+    logTlmReader_handle_t pReader = logTlmReader_open(filename.c_str(), 0);
+    ASSERT_NE(nullptr, pReader);
+
+    // The record header is not a part of the record
+    EXPECT_EQ(sizeof(DataReader), logTlmReader_getSizeElement(pReader));
+
+    logTlmRecordHeader_t header;
+    EXPECT_EQ(-1, logTlmReader_getRecordHeader(pReader, &header));
+
+    std::vector<int64_t> times;
+    const void *pRecord = NULL;
+    int64_t timeNs = 0;
+    while (logTlmReader_next(pReader, &pRecord, &timeNs) == 1) {
+        ASSERT_EQ(0, logTlmReader_getRecordHeader(pReader, &header));
+
+        const DataReader *pData = (const DataReader *)pRecord;
+        EXPECT_EQ(times.size(), pData->idx);
+        EXPECT_EQ(times.size(), header.sequence);
+        EXPECT_EQ(header.timeNs, timeNs);
+
+        times.push_back(timeNs);
+    }
+
+    ASSERT_EQ(10, times.size());
+    EXPECT_EQ(0, logTlmReader_getNumDropped(pReader));
+
+    // The time range uses the time of record header
+    logTlmReader_setTimeRange(pReader, times[3], times[6]);
+
+    long count = 0;
+    while (logTlmReader_next(pReader, &pRecord, &timeNs) == 1) {
+        EXPECT_GE(timeNs, times[3]);
+        EXPECT_LE(timeNs, times[6]);
+        count++;
+    }
+    EXPECT_GE(count, 4);
+
+    logTlmReader_close(pReader);
+}
+
+TEST_F(LogTlmReaderTest, readContainerWithoutIndex) {
+
+    writeRecords(LogTlmFormat_Container, LogTlmCodec_XorShuffle, false, 100);
+
+    // Remove the index and footer to simulate the file not closed properly
+    FILE *pFile = fopen(filename.c_str(), "r+b");
+    ASSERT_NE(nullptr, pFile);
+
+    fseek(pFile, -(long)sizeof(logTlmFileFooter_t), SEEK_END);
+    logTlmFileFooter_t footer;
+    ASSERT_EQ(1, fread(&footer, sizeof(footer), 1, pFile));
+    fclose(pFile);
+
+    ASSERT_EQ(0, truncate(filename.c_str(), footer.offsetIndex));
+
+    logTlmReader_handle_t pReader = logTlmReader_open(filename.c_str(), 0);
+    ASSERT_NE(nullptr, pReader);
+
+    EXPECT_EQ(10, logTlmReader_getNumRecord(pReader));
+    EXPECT_EQ(10, readAll(pReader).size());
+
+    logTlmReader_close(pReader);
+}
+
+TEST_F(LogTlmReaderTest, exportCsv) {
+
+    writeRecords(LogTlmFormat_Container, LogTlmCodec_None, false, 100);
+
+    logTlmReader_handle_t pReader = logTlmReader_open(filename.c_str(), 0);
+    ASSERT_NE(nullptr, pReader);
+
+    FILE *pFile = tmpfile();
+    ASSERT_NE(nullptr, pFile);
+
+    EXPECT_EQ(-1, logTlmReader_exportCsv(pReader, pFile, "u32x3"));
+    EXPECT_EQ(-1, logTlmReader_exportCsv(pReader, pFile, "u33"));
+
+    logTlmReader_setDecimation(pReader, 5);
+    EXPECT_EQ(2, logTlmReader_exportCsv(pReader, pFile, "pad4,u32"));
+
+    rewind(pFile);
+
+    char line[100];
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), pFile));
+    EXPECT_STREQ("time_ns,value0\n", line);
+
+    long long timeNs = 0;
+    uint value = 0;
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), pFile));
+    ASSERT_EQ(2, sscanf(line, "%lld,%u", &timeNs, &value));
+    EXPECT_GT(timeNs, 0);
+    EXPECT_EQ(0, value);
+
+    ASSERT_NE(nullptr, fgets(line, sizeof(line), pFile));
+    ASSERT_EQ(2, sscanf(line, "%lld,%u", &timeNs, &value));
+    EXPECT_EQ(50, value);
+
+    fclose(pFile);
+
+    logTlmReader_close(pReader);
+}
+
+TEST_F(LogTlmReaderTest, replay) {
+
+    writeRecords(LogTlmFormat_Raw, LogTlmCodec_None, false, 100);
+
+    logTlmReader_handle_t pReader =
+        logTlmReader_open(filename.c_str(), sizeof(DataReader));
+    ASSERT_NE(nullptr, pReader);
+
+    // As fast as possible
+    int count = 0;
+    EXPECT_EQ(10, logTlmReader_replay(pReader, 0, 0, countRecord, &count));
+    EXPECT_EQ(10, count);
+
+    // Paced by the period of 2 ms with 2 times faster
+    logTlmReader_rewind(pReader);
+
+    struct timespec timeStart, timeEnd;
+    clock_gettime(CLOCK_MONOTONIC, &timeStart);
+    EXPECT_EQ(10,
+              logTlmReader_replay(pReader, 2, 2000000, countRecord, &count));
+    clock_gettime(CLOCK_MONOTONIC, &timeEnd);
+
+    double timeDiff = (timeEnd.tv_sec - timeStart.tv_sec) +
+                      (timeEnd.tv_nsec - timeStart.tv_nsec) * 1e-9;
+    EXPECT_GE(timeDiff, 0.009);
+
+    // Stop if the sink fails
+    logTlmReader_rewind(pReader);
+    EXPECT_EQ(-1, logTlmReader_replay(pReader, 0, 0, failRecord, NULL));
+
+    logTlmReader_close(pReader);
+}
@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "logTlmReader.h"
+#include "logTlmRetention.h"
+}
+
+struct DataRetention {
+    uint idx;
+    uint state;
+    double position;
+};
+
+struct LogTlmRetentionTest : testing::Test {
+
+    std::string filename = "./tlmRetention.log";
+
+    // Write the rotated file with "id" that has "size" bytes and was modified
+    // "age" seconds ago.
+    void writeFile(int id, long size, long age) {
+        std::string name = filename + "." + std::to_string(id);
+        FILE *pFile = fopen(name.c_str(), "w");
+        ASSERT_NE(nullptr, pFile);
+
+        std::vector<char> data(size, 1);
+        fwrite(data.data(), size, 1, pFile);
+        fclose(pFile);
+
+        struct timeval times[2];
+        gettimeofday(&times[0], NULL);
+        times[0].tv_sec -= age;
+        times[1] = times[0];
+        ASSERT_EQ(0, utimes(name.c_str(), times));
+    }
+
+    // The rotated file with "id" exists or not.
+    bool isExist(int id) {
+        struct stat info;
+        return stat((filename + "." + std::to_string(id)).c_str(), &info) ==
+               0;
+    }
+
+    ~LogTlmRetentionTest() {
+        remove(filename.c_str());
+
+        int id;
+        for (id = 0; id < 10; id++) {
+            remove((filename + "." + std::to_string(id)).c_str());
+        }
+    }
+};
+
+TEST_F(LogTlmRetentionTest, apply) {
+
+    int id;
+    for (id = 0; id < 5; id++) {
+        writeFile(id, 1000, 100 * (5 - id));
+    }
+
+    // No budget
+    logTlmRetention_t retention = {0, 0, false};
+    logTlmRetentionAccount_t account = {};
+    EXPECT_EQ(0, logTlmRetention_apply(filename.c_str(), 0, 4, &retention,
+                                       &account));
+    EXPECT_EQ(5, account.numFile);
+    EXPECT_EQ(5000, account.size);
+
+    // The file older than 450 s
+    retention.ageMaxInSec = 450;
+    EXPECT_EQ(1, logTlmRetention_apply(filename.c_str(), 0, 4, &retention,
+                                       &account));
+    EXPECT_FALSE(isExist(0));
+    EXPECT_EQ(4, account.numFile);
+    EXPECT_EQ(1, account.numFileDeleted);
+
+    // The oldest files to meet the size. The files can not be compressed.
+    retention.sizeMax = 2500;
+    retention.isCompressed = true;
+    EXPECT_EQ(3, logTlmRetention_apply(filename.c_str(), 1, 4, &retention,
+                                       &account));
+    EXPECT_FALSE(isExist(1));
+    EXPECT_FALSE(isExist(2));
+    EXPECT_TRUE(isExist(3));
+    EXPECT_EQ(2, account.numFile);
+    EXPECT_EQ(2000, account.size);
+    EXPECT_EQ(3, account.numFileDeleted);
+    EXPECT_EQ(0, account.numFileCompressed);
+
+    // No file left
+    retention.sizeMax = 1;
+    EXPECT_EQ(5, logTlmRetention_apply(filename.c_str(), 3, 4, &retention,
+                                       &account));
+    EXPECT_EQ(0, account.numFile);
+}
+
+TEST_F(LogTlmRetentionTest, compressFile) {
+
+    // Container file of 2 blocks with the slowly changing records
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    ASSERT_EQ(0, logTlmHandle_setFormat(pLog, LogTlmFormat_Container, 1));
+    ASSERT_EQ(0, logTlmHandle_createBufferPool(pLog, 2, 100,
+                                               sizeof(DataRetention)));
+    ASSERT_EQ(0, logTlmHandle_open(pLog, "./", "tlmRetention.log", 200));
+
+    DataRetention data = {0, 2, 0.0};
+    uint idx;
+    for (idx = 0; idx < 150; idx++) {
+        data.idx = idx;
+        data.position = 0.5 * idx;
+        logTlmHandle_write(pLog, &data);
+    }
+    logTlmHandle_flush(pLog);
+    logTlmHandle_free(pLog);
+
+    std::string name = filename + ".0";
+    ASSERT_EQ(0, rename(filename.c_str(), name.c_str()));
+
+    struct stat infoBefore, infoAfter;
+    ASSERT_EQ(0, stat(name.c_str(), &infoBefore));
+
+    EXPECT_EQ(0, logTlmRetention_compressFile(name.c_str()));
+
+    ASSERT_EQ(0, stat(name.c_str(), &infoAfter));
+    EXPECT_LT(infoAfter.st_size, infoBefore.st_size);
+    EXPECT_EQ(infoBefore.st_mtime, infoAfter.st_mtime);
+
+    // Compressed already
+    EXPECT_EQ(1, logTlmRetention_compressFile(name.c_str()));
+    EXPECT_EQ(-1, logTlmRetention_compressFile("tlmRetentionNoFile.log"));
+
+    // The records are the same
+    logTlmReader_handle_t pReader = logTlmReader_open(filename.c_str(), 0);
+    ASSERT_NE(nullptr, pReader);
+
+    const void *pRecord = NULL;
+    idx = 0;
+    while (logTlmReader_next(pReader, &pRecord, NULL) == 1) {
+        const DataRetention *pData = (const DataRetention *)pRecord;
+        EXPECT_EQ(idx, pData->idx);
+        EXPECT_DOUBLE_EQ(0.5 * idx, pData->position);
+        idx++;
+    }
+    EXPECT_EQ(150, idx);
+
+    logTlmReader_close(pReader);
+}
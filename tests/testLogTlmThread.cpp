@@ -1,5 +1,10 @@
+#include <fcntl.h>
 #include <fstream>
+#include <pthread.h>
 #include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -13,6 +18,11 @@ struct DataThread {
     double valueSingle;
 };
 
+struct DataThreadWithHeader {
+    logTlmRecordHeader_t header;
+    DataThread data;
+};
+
 struct LogTlmThreadTest : testing::Test {
 
     char *pathDir = "./";
@@ -60,8 +70,8 @@ static void *startWriter(void *pData) {
         data.valueSingle = 10 * idx + 0.3;
         if (logTlm_write(&data) == -1) {
             EXPECT_EQ(nullptr, logTlm_getBuffer(0));
-            printf(
-                "Both buffers are full. I should see this just for 1 time.\n");
+            printf("Both buffers are full. I should see this at most 1 "
+                   "time.\n");
 
             timesBothBuffersAreFull += 1;
 
@@ -118,7 +128,9 @@ static void *startWriter(void *pData) {
     }
 
     EXPECT_EQ(logTlm_getBuffer(1), logTlm_getBuffer(0));
-    EXPECT_EQ(1, timesBothBuffersAreFull);
+    // The thread flushes a full buffer immediately. Both buffers can only be
+    // full if 2 buffers are filled before the thread has a chance to run.
+    EXPECT_LE(timesBothBuffersAreFull, 1);
 
     // Flush the final data. Wait for a short time to make sure the running
     // thread is done.
@@ -202,3 +214,175 @@ TEST_F(LogTlmThreadTest, logTlmRunFlushInNewThread) {
         EXPECT_DOUBLE_EQ(10 * idxExpect + 0.3, dataDecode[idx].valueSingle);
     }
 }
+
+static void *startFifoReader(void *pData) {
+
+    // Read the records from the FIFO until the writer closes it
+    std::vector<DataThread> *pRecords = (std::vector<DataThread> *)pData;
+    std::ifstream file("./tlmPool.fifo", std::ifstream::binary);
+    struct DataThread data;
+    while (file.read((char *)&data, sizeof(data))) {
+        pRecords->push_back(data);
+    }
+
+    return 0;
+}
+
+TEST(LogTlmThread, logTlmBufferPool) {
+
+    char *pathDir = "./";
+    char *formatFilename = "tlmPool.fifo";
+
+    uint sizeBuffer = 1000;
+
+    EXPECT_EQ(-1, logTlm_createBufferPool(0, sizeBuffer, sizeof(DataThread)));
+    EXPECT_EQ(0, logTlm_createBufferPool(3, sizeBuffer, sizeof(DataThread)));
+
+    // Use a small FIFO as the telemetry file. The flush of one buffer is
+    // larger than the pipe and the stream buffer, and blocks until the FIFO
+    // is read, which is like a disk stall.
+    unlink("./tlmPool.fifo");
+    ASSERT_EQ(0, mkfifo("./tlmPool.fifo", 0666));
+
+    int fdHold = open("./tlmPool.fifo", O_RDONLY | O_NONBLOCK);
+    ASSERT_NE(-1, fdHold);
+    fcntl(fdHold, F_SETPIPE_SZ, 4096);
+
+    EXPECT_EQ(0, logTlm_open(pathDir, formatFilename, 10000));
+    EXPECT_NE(nullptr, logTlm_getBuffer(3));
+    EXPECT_EQ(nullptr, logTlm_getBuffer(4));
+
+    int timeInMs = 500;
+    EXPECT_EQ(0, logTlm_runFlushInNewThread(&timeInMs));
+
+    // Fill all the buffers while the thread is stalled by the first one. The
+    // records after that are dropped.
+    struct DataThread data;
+    int numFail = 0;
+    int numDrop = 0;
+    uint idx;
+    for (idx = 0; idx < 4 * sizeBuffer; idx++) {
+        data.idx = idx;
+        int status = logTlm_write(&data);
+        numFail += (status == -1) ? 1 : 0;
+        numDrop += (status == -2) ? 1 : 0;
+    }
+
+    EXPECT_EQ(1, numFail);
+    EXPECT_EQ(sizeBuffer, numDrop);
+    EXPECT_TRUE(logTlm_isFlushing());
+
+    logTlmStats_t stats;
+    logTlm_getStats(&stats);
+    EXPECT_EQ(sizeBuffer, stats.numRecordDropped);
+    EXPECT_EQ(3, stats.numBufferFull);
+    EXPECT_EQ(3, stats.numBufferFullMax);
+
+    // Drain the FIFO. The buffers are flushed in order and freed.
+    std::vector<DataThread> records;
+    pthread_t threadReader;
+    pthread_create(&threadReader, NULL, startFifoReader, &records);
+
+    sleep(1);
+    EXPECT_FALSE(logTlm_isFlushing());
+    EXPECT_NE(nullptr, logTlm_getBuffer(0));
+
+    logTlm_getStats(&stats);
+    EXPECT_EQ(0, stats.numBufferFull);
+    EXPECT_EQ(3, stats.numBufferFullMax);
+
+    logTlm_closeThread();
+    logTlm_close();
+
+    pthread_join(threadReader, NULL);
+    close(fdHold);
+    unlink("./tlmPool.fifo");
+
+    ASSERT_EQ(3 * sizeBuffer, records.size());
+    for (idx = 0; idx < 3 * sizeBuffer; idx++) {
+        EXPECT_EQ(idx, records[idx].idx);
+    }
+
+    logTlm_freeBuffer();
+}
+
+static void *startFifoReaderWithHeader(void *pData) {
+
+    // Read the records with the header from the FIFO until the writer closes
+    // it
+    std::vector<DataThreadWithHeader> *pRecords =
+        (std::vector<DataThreadWithHeader> *)pData;
+    std::ifstream file("./tlmGap.fifo", std::ifstream::binary);
+    struct DataThreadWithHeader data;
+    while (file.read((char *)&data, sizeof(data))) {
+        pRecords->push_back(data);
+    }
+
+    return 0;
+}
+
+TEST(LogTlmThread, logTlmGapMarker) {
+
+    uint sizeBuffer = 1000;
+
+    logTlm_handle_t pLog = logTlmHandle_init();
+    ASSERT_NE(nullptr, pLog);
+
+    EXPECT_EQ(0, logTlmHandle_setRecordHeader(pLog, true));
+    EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, 3, sizeBuffer,
+                                               sizeof(DataThread)));
+
+    // Stall the flush by a small FIFO as logTlmBufferPool
+    unlink("./tlmGap.fifo");
+    ASSERT_EQ(0, mkfifo("./tlmGap.fifo", 0666));
+
+    int fdHold = open("./tlmGap.fifo", O_RDONLY | O_NONBLOCK);
+    ASSERT_NE(-1, fdHold);
+    fcntl(fdHold, F_SETPIPE_SZ, 4096);
+
+    EXPECT_EQ(0, logTlmHandle_open(pLog, "./", "tlmGap.fifo", 10000));
+
+    int timeInMs = 500;
+    EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+    // The records after the 3 buffers are dropped
+    struct DataThread data;
+    uint idx;
+    for (idx = 0; idx < 4 * sizeBuffer; idx++) {
+        data.idx = idx;
+        logTlmHandle_write(pLog, &data);
+    }
+
+    std::vector<DataThreadWithHeader> records;
+    pthread_t threadReader;
+    pthread_create(&threadReader, NULL, startFifoReaderWithHeader, &records);
+
+    sleep(1);
+
+    // The gap marker is written before the next record
+    data.idx = 4 * sizeBuffer;
+    EXPECT_EQ(0, logTlmHandle_write(pLog, &data));
+    EXPECT_EQ(0, logTlmHandle_flush(pLog));
+
+    logTlmHandle_free(pLog);
+
+    pthread_join(threadReader, NULL);
+    close(fdHold);
+    unlink("./tlmGap.fifo");
+
+    ASSERT_EQ(3 * sizeBuffer + 2, records.size());
+    for (idx = 0; idx < 3 * sizeBuffer; idx++) {
+        EXPECT_EQ(idx, records[idx].header.sequence);
+        EXPECT_EQ(idx, records[idx].data.idx);
+    }
+
+    DataThreadWithHeader *pMarker = &records[3 * sizeBuffer];
+    EXPECT_EQ((3 * sizeBuffer) | LOGTLM_SEQUENCE_GAP, pMarker->header.sequence);
+    EXPECT_EQ(0, pMarker->data.idx);
+
+    DataThreadWithHeader *pRecord = &records[3 * sizeBuffer + 1];
+    EXPECT_EQ(4 * sizeBuffer, pRecord->header.sequence);
+    EXPECT_EQ(4 * sizeBuffer, pRecord->data.idx);
+    EXPECT_EQ(pRecord->header.timeNs, pMarker->header.timeNs);
+    EXPECT_GT(pRecord->header.timeNs, records[0].header.timeNs);
+}
@@ -0,0 +1,273 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "circular_buffer.h"
+#include "logTlm.h"
+#include "rtMemory.h"
+}
+
+// Telemetry of 64 bytes
+struct DataRtMemory {
+    uint idx;
+    uint state;
+    double position[7];
+};
+
+// Get the number of page faults (minor + major) of the calling thread.
+static long getNumPageFault(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+// Get the current monotonic time in nanosecond
+static long nowInNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+struct RtMemoryTest : testing::Test {
+
+    ~RtMemoryTest() { rtMemory_setPolicy(RtMemoryPolicy_Default); }
+
+    // Write the records through all the buffers of logger in the steady state,
+    // which has the first touch of each buffer.
+    // Return the number of page faults in the writes.
+    long writeTelemetry(long *pTimeMaxNs) {
+
+        logTlm_handle_t pLog = logTlmHandle_init();
+        EXPECT_NE(nullptr, pLog);
+
+        const int numBuffer = 4;
+        const int sizeBuffer = 1000;
+        EXPECT_EQ(0, logTlmHandle_createBufferPool(pLog, numBuffer, sizeBuffer,
+                                                   sizeof(DataRtMemory)));
+        EXPECT_EQ(0, logTlmHandle_open(pLog, "./", "tlmRtMemory.log",
+                                       2 * numBuffer * sizeBuffer));
+
+        int timeInMs = 10;
+        EXPECT_EQ(0, logTlmHandle_runFlushInNewThread(pLog, &timeInMs));
+
+        // Fault the code and stack of the write path
+        DataRtMemory data = {};
+        logTlmHandle_write(pLog, &data);
+
+        long numPageFault = getNumPageFault();
+        *pTimeMaxNs = 0;
+
+        int idx;
+        for (idx = 1; idx < numBuffer * sizeBuffer; idx++) {
+            data.idx = idx;
+
+            long timeStart = nowInNs();
+            logTlmHandle_write(pLog, &data);
+            long timeWrite = nowInNs() - timeStart;
+            if (timeWrite > *pTimeMaxNs) {
+                *pTimeMaxNs = timeWrite;
+            }
+
+            // Let the flush thread keep up
+            if ((idx % 100) == 0) {
+                usleep(1000);
+            }
+        }
+
+        numPageFault = getNumPageFault() - numPageFault;
+
+        std::string filename = logTlmHandle_getFilename(pLog);
+        logTlmHandle_free(pLog);
+        remove(filename.c_str());
+
+        return numPageFault;
+    }
+};
+
+TEST_F(RtMemoryTest, setPolicy) {
+
+    EXPECT_EQ(RtMemoryPolicy_Default, rtMemory_getPolicy());
+
+    EXPECT_EQ(-1, rtMemory_setPolicy((RtMemoryPolicy)0));
+    EXPECT_EQ(RtMemoryPolicy_Default, rtMemory_getPolicy());
+
+    EXPECT_EQ(0, rtMemory_setPolicy(RtMemoryPolicy_Locked));
+    EXPECT_EQ(RtMemoryPolicy_Locked, rtMemory_getPolicy());
+}
+
+TEST_F(RtMemoryTest, allocDefault) {
+
+    uint8_t *pMemory = (uint8_t *)rtMemory_alloc(1000);
+    ASSERT_NE(nullptr, pMemory);
+
+    EXPECT_EQ(0, (uintptr_t)pMemory % RTMEMORY_ALIGNMENT);
+
+    int idx;
+    for (idx = 0; idx < 1000; idx++) {
+        EXPECT_EQ(0, pMemory[idx]);
+    }
+
+    rtMemoryStats_t stats;
+    rtMemory_getStats(&stats);
+    EXPECT_EQ(0, stats.sizeLocked);
+
+    rtMemory_free(pMemory);
+    rtMemory_free(NULL);
+}
+
+TEST_F(RtMemoryTest, allocLocked) {
+
+    rtMemory_setPolicy(RtMemoryPolicy_Locked);
+
+    // Small allocation on the normal pages
+    uint8_t *pMemory = (uint8_t *)rtMemory_alloc(1000);
+    ASSERT_NE(nullptr, pMemory);
+
+    EXPECT_EQ(0, (uintptr_t)pMemory % RTMEMORY_ALIGNMENT);
+    EXPECT_EQ(0, pMemory[0]);
+    EXPECT_EQ(0, pMemory[999]);
+
+    rtMemoryStats_t stats;
+    rtMemory_getStats(&stats);
+    if (stats.numLockFailed == 0) {
+        EXPECT_EQ(sysconf(_SC_PAGESIZE), stats.sizeLocked);
+    }
+    EXPECT_EQ(0, stats.sizeHugepage);
+
+    // Big allocation on the huge pages if they are reserved
+    uint8_t *pMemoryBig = (uint8_t *)rtMemory_alloc(3 * 1024 * 1024);
+    ASSERT_NE(nullptr, pMemoryBig);
+
+    memset(pMemoryBig, 1, 3 * 1024 * 1024);
+
+    rtMemory_getStats(&stats);
+    EXPECT_EQ(0, stats.sizeHugepage % RTMEMORY_SIZE_HUGEPAGE);
+
+    // The memory allocated in the locked policy is freed after the change
+    rtMemory_setPolicy(RtMemoryPolicy_Default);
+
+    rtMemory_free(pMemory);
+    rtMemory_free(pMemoryBig);
+
+    rtMemory_getStats(&stats);
+    EXPECT_EQ(0, stats.sizeLocked);
+    EXPECT_EQ(0, stats.sizeHugepage);
+}
+
+TEST_F(RtMemoryTest, allocLockedSmall) {
+
+    rtMemory_setPolicy(RtMemoryPolicy_Locked);
+
+    rtMemoryStats_t statsStart;
+    rtMemory_getStats(&statsStart);
+
+    // The small allocations share a locked page
+    uint8_t *pMemories[3];
+    int idx;
+    for (idx = 0; idx < 3; idx++) {
+        pMemories[idx] = (uint8_t *)rtMemory_alloc(100);
+        ASSERT_NE(nullptr, pMemories[idx]);
+
+        EXPECT_EQ(0, (uintptr_t)pMemories[idx] % RTMEMORY_ALIGNMENT);
+        EXPECT_EQ(0, pMemories[idx][99]);
+        memset(pMemories[idx], 1, 100);
+    }
+
+    uintptr_t sizePage = sysconf(_SC_PAGESIZE);
+    EXPECT_EQ((uintptr_t)pMemories[0] / sizePage,
+              (uintptr_t)pMemories[2] / sizePage);
+
+    rtMemoryStats_t stats;
+    rtMemory_getStats(&stats);
+    if (stats.numLockFailed == statsStart.numLockFailed) {
+        EXPECT_EQ(sizePage, stats.sizeLocked);
+    }
+
+    // The page is released with the last allocation
+    rtMemory_free(pMemories[1]);
+    rtMemory_free(pMemories[0]);
+    rtMemory_free(pMemories[2]);
+
+    rtMemory_getStats(&stats);
+    EXPECT_EQ(0, stats.sizeLocked);
+}
+
+TEST_F(RtMemoryTest, allocAligned) {
+
+    EXPECT_EQ(nullptr, rtMemory_allocAligned(1000, 32));
+    EXPECT_EQ(nullptr, rtMemory_allocAligned(1000, 1000));
+
+    RtMemoryPolicy policies[2] = {RtMemoryPolicy_Default,
+                                  RtMemoryPolicy_Locked};
+    int idx;
+    for (idx = 0; idx < 2; idx++) {
+        rtMemory_setPolicy(policies[idx]);
+
+        uint8_t *pMemory = (uint8_t *)rtMemory_allocAligned(5000, 4096);
+        ASSERT_NE(nullptr, pMemory);
+
+        EXPECT_EQ(0, (uintptr_t)pMemory % 4096);
+        EXPECT_EQ(0, pMemory[0]);
+        EXPECT_EQ(0, pMemory[4999]);
+
+        rtMemory_free(pMemory);
+    }
+
+    rtMemoryStats_t stats;
+    rtMemory_getStats(&stats);
+    EXPECT_EQ(0, stats.sizeLocked);
+}
+
+TEST_F(RtMemoryTest, circularBufferWithoutPageFault) {
+
+    rtMemory_setPolicy(RtMemoryPolicy_Locked);
+
+    // 256 KB of buffer
+    cbuf_handle_t cbuf =
+        circular_buf_init_aligned(1023, 256, CircularBufMode_Spsc);
+    ASSERT_NE(nullptr, cbuf);
+    EXPECT_EQ(0, circular_buf_enable_stats(cbuf));
+
+    uint8_t data[256] = {};
+    circular_buf_put_element(cbuf, data);
+    circular_buf_get_element(cbuf, data);
+
+    // Go through all the slots in the steady state
+    long numPageFault = getNumPageFault();
+
+    int idx;
+    for (idx = 0; idx < 4096; idx++) {
+        data[0] = idx;
+        circular_buf_put_element(cbuf, data);
+        if ((idx % 2) == 1) {
+            circular_buf_get_element(cbuf, data);
+        }
+    }
+
+    numPageFault = getNumPageFault() - numPageFault;
+
+    EXPECT_EQ(0, numPageFault);
+
+    circular_buf_free(cbuf);
+}
+
+TEST_F(RtMemoryTest, logTlmWithoutPageFault) {
+
+    long timeMaxNs = 0;
+    long numPageFaultDefault = writeTelemetry(&timeMaxNs);
+    printf("Default policy: %ld page faults, maximum write latency: %ld ns\n",
+           numPageFaultDefault, timeMaxNs);
+
+    rtMemory_setPolicy(RtMemoryPolicy_Locked);
+
+    long numPageFault = writeTelemetry(&timeMaxNs);
+    printf("Locked policy: %ld page faults, maximum write latency: %ld ns\n",
+           numPageFault, timeMaxNs);
+
+    EXPECT_EQ(0, numPageFault);
+}
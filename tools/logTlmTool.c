@@ -0,0 +1,238 @@
+#include <inttypes.h>
+#include <mqueue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "circular_buffer.h"
+#include "cmdTlmServer.h"
+#include "logTlmReader.h"
+
+// Command line tool to read the telemetry files written by logTlm.
+
+// Maximum number of telemetry messages queued in the replay. This should not
+// be larger than /proc/sys/fs/mqueue/msg_max (10 by default).
+#define LOGTLMTOOL_MAX_NUM_QUEUE_TLM 10
+
+// Timeout of the server in milliseconds
+#define LOGTLMTOOL_TIMEOUT_SERVER 100
+
+// Number of the telemetry messages dropped because the queue is full
+static long numDropped = 0;
+
+// Print the usage.
+static void logTlmTool_printUsage(const char *pName) {
+    fprintf(stderr,
+            "Usage: %s [options] <file>\n"
+            "Read the rotated telemetry files (file.0, file.1, ..., file).\n"
+            "The summary is printed if -c and -r are not given.\n\n"
+            "Options:\n"
+            "  -s <bytes>  size of record for the raw format\n"
+            "  -b <ns>     start time in nanoseconds since the epoch\n"
+            "  -e <ns>     end time in nanoseconds since the epoch\n"
+            "  -d <n>      read one of n records\n"
+            "  -c <types>  export CSV to stdout, such as \"u32,pad4,f64x6\"\n"
+            "              (use \"hex\" for the hexadecimal bytes)\n"
+            "  -r <port>   replay to the telemetry server on the port\n"
+            "  -x <speed>  replay speed (default: 1, 0 as fast as "
+            "possible)\n"
+            "  -p <us>     period of records in the raw format (default: "
+            "1000)\n",
+            pName);
+}
+
+// Print the summary of files.
+static void logTlmTool_printSummary(logTlmReader_handle_t pReader) {
+    printf("Files: %d\n", logTlmReader_getNumFile(pReader));
+    printf("Record size: %zu bytes\n", logTlmReader_getSizeElement(pReader));
+    printf("Records: %ld\n", logTlmReader_getNumRecord(pReader));
+
+    long count = 0;
+    int64_t timeFirstNs = 0, timeLastNs = 0;
+
+    const void *pRecord = NULL;
+    int64_t timeNs = 0;
+    while (logTlmReader_next(pReader, &pRecord, &timeNs) == 1) {
+        if (count == 0) {
+            timeFirstNs = timeNs;
+        }
+        timeLastNs = timeNs;
+        count++;
+    }
+
+    printf("Selected records: %ld\n", count);
+    printf("Dropped records: %ld\n", logTlmReader_getNumDropped(pReader));
+    if ((count > 0) && (timeFirstNs != 0)) {
+        printf("Time range: %" PRId64 " to %" PRId64 " ns (%.3f s)\n",
+               timeFirstNs, timeLastNs, (timeLastNs - timeFirstNs) * 1e-9);
+    }
+}
+
+// Send the record to the telemetry queue of server. If the queue is full, wait
+// for the server to send the queued messages until the timeout of server and
+// then drop the record, so the replay does not stall.
+static int logTlmTool_sendTlm(void *pUser, const void *pRecord,
+                              size_t sizeRecord) {
+    serverInfo_t *pServerInfo = (serverInfo_t *)pUser;
+    if (pServerInfo->serverStatus == ServerStatus_Exit) {
+        return -1;
+    }
+
+    struct mq_attr attr;
+    int timeWaited = 0;
+    while ((mq_getattr(pServerInfo->msgQueueTlm, &attr) == 0) &&
+           (attr.mq_curmsgs >= attr.mq_maxmsg)) {
+        if (timeWaited >= LOGTLMTOOL_TIMEOUT_SERVER) {
+            numDropped++;
+            return 0;
+        }
+
+        usleep(1000);
+        timeWaited++;
+    }
+
+    if (cmdTlmServer_sendTlmToMsgQueue(pServerInfo, (const char *)pRecord,
+                                       sizeRecord) != 0) {
+        numDropped++;
+    }
+
+    return 0;
+}
+
+// Replay the records to the telemetry server. The replay starts after the
+// client is connected.
+// Return 0 if success. Otherwise, -1.
+static int logTlmTool_replay(logTlmReader_handle_t pReader, int port,
+                             double speed, long periodInNs) {
+
+    cbuf_handle_t cmdMsgBuffer = circular_buf_init(2);
+
+    serverInfo_t serverInfo;
+    if (cmdTlmServer_init(&serverInfo, "Telemetry replay",
+                          LOGTLMTOOL_TIMEOUT_SERVER,
+                          logTlmReader_getSizeElement(pReader), port,
+                          LOGTLMTOOL_MAX_NUM_QUEUE_TLM, cmdMsgBuffer) != 0) {
+        fprintf(stderr, "Fail to initialize the server on port %d.\n", port);
+        circular_buf_free(cmdMsgBuffer);
+        return -1;
+    }
+
+    if (cmdTlmServer_runInNewThread(&serverInfo) != 0) {
+        fprintf(stderr, "Fail to run the server.\n");
+        cmdTlmServer_close(&serverInfo);
+        circular_buf_free(cmdMsgBuffer);
+        return -1;
+    }
+
+    fprintf(stderr, "Waiting for the client on port %d...\n", port);
+    while (serverInfo.serverStatus != ServerStatus_Connected) {
+        usleep(100000);
+    }
+
+    long numReplayed = logTlmReader_replay(pReader, speed, periodInNs,
+                                           logTlmTool_sendTlm, &serverInfo);
+
+    // Wait for the server to send the queued messages
+    struct mq_attr attr;
+    int timeWaited = 0;
+    while ((mq_getattr(serverInfo.msgQueueTlm, &attr) == 0) &&
+           (attr.mq_curmsgs > 0) &&
+           (timeWaited < LOGTLMTOOL_TIMEOUT_SERVER)) {
+        usleep(1000);
+        timeWaited++;
+    }
+
+    // The last message may be still in the sending
+    usleep(LOGTLMTOOL_TIMEOUT_SERVER * 1000);
+
+    fprintf(stderr, "Replayed records: %ld (dropped: %ld)\n", numReplayed,
+            numDropped);
+
+    cmdTlmServer_close(&serverInfo);
+    circular_buf_free(cmdMsgBuffer);
+
+    return (numReplayed >= 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+
+    size_t sizeElement = 0;
+    int64_t timeStartNs = INT64_MIN;
+    int64_t timeEndNs = INT64_MAX;
+    int decimation = 1;
+    char *pTypes = NULL;
+    int port = 0;
+    double speed = 1;
+    long periodInNs = 1000000;
+
+    int option;
+    while ((option = getopt(argc, argv, "s:b:e:d:c:r:x:p:h")) != -1) {
+        switch (option) {
+        case 's':
+            sizeElement = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            timeStartNs = strtoll(optarg, NULL, 10);
+            break;
+        case 'e':
+            timeEndNs = strtoll(optarg, NULL, 10);
+            break;
+        case 'd':
+            decimation = atoi(optarg);
+            break;
+        case 'c':
+            pTypes = optarg;
+            break;
+        case 'r':
+            port = atoi(optarg);
+            break;
+        case 'x':
+            speed = atof(optarg);
+            break;
+        case 'p':
+            periodInNs = atol(optarg) * 1000;
+            break;
+        default:
+            logTlmTool_printUsage(argv[0]);
+            return (option == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1) {
+        logTlmTool_printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    openlog("logTlmTool", LOG_CONS | LOG_PERROR, LOG_USER);
+
+    logTlmReader_handle_t pReader =
+        logTlmReader_open(argv[optind], sizeElement);
+    if (pReader == NULL) {
+        closelog();
+        return EXIT_FAILURE;
+    }
+
+    logTlmReader_setTimeRange(pReader, timeStartNs, timeEndNs);
+    logTlmReader_setDecimation(pReader, decimation);
+
+    int status = 0;
+    if (pTypes != NULL) {
+        if (strcmp(pTypes, "hex") == 0) {
+            pTypes = NULL;
+        }
+
+        status = (logTlmReader_exportCsv(pReader, stdout, pTypes) >= 0) ? 0
+                                                                        : -1;
+    } else if (port > 0) {
+        status = logTlmTool_replay(pReader, port, speed, periodInNs);
+    } else {
+        logTlmTool_printSummary(pReader);
+    }
+
+    logTlmReader_close(pReader);
+    closelog();
+
+    return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}